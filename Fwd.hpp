@@ -13,13 +13,37 @@ namespace cy3d
 
 	class VulkanAllocator;
 
+	class VulkanDeletionQueue;
+
 	class VulkanRenderer;
 
+	class VulkanPipelineCache;
+
+	class VulkanPipelineLibrary;
+
+	class VulkanComputePipeline;
+
 	class VulkanDescriptorPoolManager;
 
+	class VulkanDescriptorSetCache;
+
+	class VulkanFrameDescriptorAllocator;
+
+	class VulkanLayoutCache;
+
+	class VulkanShaderArchive;
+
+	class VulkanShaderOptimizer;
+
+	class VulkanVertexLayoutRegistry;
+
+	class VulkanShader;
+
 	class ShaderManager;
 
 	class SceneRenderer;
+
+	class ThreadPool;
 }
 
 
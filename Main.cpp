@@ -1,13 +1,70 @@
 #include "pch.h"
 
 #include "src/platform/Vulkan/FirstApp.h"
+#include "src/FrustumCuller.h"
 
-int main() {
+constexpr uint32_t CULL_BENCHMARK_DEFAULT_OBJECTS = 100000;
+constexpr uint32_t CULL_BENCHMARK_ITERATIONS = 100;
 
-    cy3d::FirstApp app{};
+/**
+ * --headless               render without a window and write the last frame to the capture path
+ * --frames <n>             frames rendered in headless mode
+ * --capture <path>         where the headless frame is written, as a binary PPM
+ * --width <n>, --height <n>
+ * --cull-benchmark [n]     time the cpu frustum culling paths on n objects, 100000 by default, and exit
+*/
+static bool parseOptions(int argc, char* argv[], cy3d::AppOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--headless") options.headless = true;
+        else if (arg == "--frames" && hasValue)
+        {
+            options.frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+            if (options.frames == 0)
+            {
+                std::cerr << "--frames has to be at least 1, the captured frame has to be rendered\n";
+                return false;
+            }
+        }
+        else if (arg == "--capture" && hasValue) options.capturePath = argv[++i];
+        else if (arg == "--width" && hasValue) options.width = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (arg == "--height" && hasValue) options.height = static_cast<uint32_t>(std::stoul(argv[++i]));
+        else if (arg == "--cull-benchmark")
+        {
+            //the count is optional, the next argument may be another option
+            bool hasCount = hasValue && argv[i + 1][0] != '-';
+            options.cullBenchmarkObjects = hasCount ? static_cast<uint32_t>(std::stoul(argv[++i])) : CULL_BENCHMARK_DEFAULT_OBJECTS;
+        }
+        else
+        {
+            std::cerr << "unknown or incomplete option " << arg << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
 
     try
     {
+        cy3d::AppOptions options{};
+        if (!parseOptions(argc, argv, options))
+        {
+            return EXIT_FAILURE;
+        }
+
+        if (options.cullBenchmarkObjects > 0)
+        {
+            //logs the timings itself
+            cy3d::FrustumCuller::benchmark(options.cullBenchmarkObjects, CULL_BENCHMARK_ITERATIONS);
+            return EXIT_SUCCESS;
+        }
+
+        cy3d::FirstApp app{ options };
         app.run();
     }
     catch (const std::exception& e)
@@ -16,4 +73,4 @@ int main() {
         return EXIT_FAILURE;
     }
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -20,6 +20,15 @@
 #include <functional>
 #include <cassert>
 #include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <queue>
+#include <deque>
+#include <atomic>
+#include <iomanip>
+#include <map>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
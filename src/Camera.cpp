@@ -13,8 +13,11 @@ namespace cy3d
     Camera::~Camera()
     {
         //clean up listeners
-        _context.getWindow()->removeKeyboardListener(keyboardInputListenerId);
-        _context.getWindow()->removeMouseListener(mouseInputListenerId);
+        if (!_context.isHeadless())
+        {
+            _context.getWindow()->removeKeyboardListener(keyboardInputListenerId);
+            _context.getWindow()->removeMouseListener(mouseInputListenerId);
+        }
     }
 
     void Camera::print()
@@ -79,6 +82,12 @@ namespace cy3d
         Camera* camera = new Camera(context);
         camera->projectionMatrix = createPerspectiveMatrix(fov, height / width, zfar, znear);
 
+        //a headless context has no window to take input from
+        if (context.isHeadless())
+        {
+            return camera;
+        }
+
         camera->keyboardInputListenerId = context.getWindow()->registerKeyboardListener
         (
             [cam = camera](KeyBoardInputEvent& e, double deltaTime)
@@ -0,0 +1,196 @@
+#include "pch.h"
+#include "DrawQueue.h"
+#include "platform/Vulkan/VulkanDevice.h"
+
+namespace cy3d
+{
+	DrawQueue::DrawQueue(VulkanContext& context) : _context(context)
+	{
+
+	}
+
+	void DrawQueue::submit(const DrawItem& item, uint32_t pass, float depth, bool transparent)
+	{
+		CY_ASSERT(item.pipeline != VK_NULL_HANDLE);
+		uint32_t pipelineId = idFor(_pipelineIds, item.pipeline);
+		uint32_t setId = idFor(_descriptorSetIds, item.descriptorSet);
+
+		_entries.push_back(SortEntry{ makeKey(pass, pipelineId, setId, item.materialId, depth, transparent), static_cast<uint32_t>(_items.size()) });
+		_items.push_back(item);
+		_sorted = false;
+	}
+
+	void DrawQueue::clear()
+	{
+		_items.clear();
+		_entries.clear();
+		//handles of destroyed pipelines and sets may be reused by the driver, so ids never outlive the frame
+		_pipelineIds.clear();
+		_descriptorSetIds.clear();
+		_sorted = true;
+	}
+
+	uint64_t DrawQueue::makeKey(uint32_t pass, uint32_t pipelineId, uint32_t descriptorSetId, uint32_t materialId, float depth, bool transparent)
+	{
+		constexpr uint64_t idMask = (1ull << ID_BITS) - 1;
+		constexpr uint64_t depthMax = (1ull << DEPTH_BITS) - 1;
+		CY_ASSERT(pass < (1u << PASS_BITS));
+
+		float clampedDepth = std::min(std::max(depth, 0.0f), 1.0f);
+		uint64_t quantizedDepth = static_cast<uint64_t>(clampedDepth * static_cast<float>(depthMax));
+
+		uint64_t key = static_cast<uint64_t>(pass) << (64 - PASS_BITS);
+		uint64_t state = ((pipelineId & idMask) << (2 * ID_BITS)) | ((descriptorSetId & idMask) << ID_BITS) | (materialId & idMask);
+		if (transparent)
+		{
+			//farthest first
+			key |= 1ull << (63 - PASS_BITS);
+			key |= (depthMax - quantizedDepth) << (3 * ID_BITS);
+			key |= state;
+		}
+		else
+		{
+			key |= state << DEPTH_BITS;
+			key |= quantizedDepth;
+		}
+		return key;
+	}
+
+	/**
+	 * @brief LSD radix sort over the keys, one byte per pass. Passes where every key has the same byte are skipped, which
+	 * is common for the high bytes since only a few passes and pipelines are used. Stable, so draws with equal keys keep
+	 * their submission order.
+	*/
+	void DrawQueue::sort()
+	{
+		if (_sorted)
+		{
+			return;
+		}
+
+		_sortScratch.resize(_entries.size());
+		SortEntry* src = _entries.data();
+		SortEntry* dst = _sortScratch.data();
+		std::size_t count = _entries.size();
+
+		for (uint32_t shift = 0; shift < 64; shift += 8)
+		{
+			std::array<std::size_t, 256> histogram{};
+			for (std::size_t i = 0; i < count; i++)
+			{
+				histogram[(src[i].key >> shift) & 0xFF]++;
+			}
+
+			//every key has the same byte so this pass would not change the order
+			if (histogram[(src[0].key >> shift) & 0xFF] == count)
+			{
+				continue;
+			}
+
+			std::size_t offset = 0;
+			for (auto& bucket : histogram)
+			{
+				std::size_t bucketCount = bucket;
+				bucket = offset;
+				offset += bucketCount;
+			}
+
+			for (std::size_t i = 0; i < count; i++)
+			{
+				dst[histogram[(src[i].key >> shift) & 0xFF]++] = src[i];
+			}
+			std::swap(src, dst);
+		}
+
+		if (src != _entries.data())
+		{
+			std::copy(src, src + count, _entries.data());
+		}
+		_sorted = true;
+	}
+
+	void DrawQueue::record(VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end) const
+	{
+		CY_ASSERT(_sorted == true);
+		CY_ASSERT(begin <= end && end <= _entries.size());
+
+		VkPipeline boundPipeline = VK_NULL_HANDLE;
+		VkDescriptorSet boundSet = VK_NULL_HANDLE;
+		VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+		std::array<VkBuffer, MAX_VERTEX_BINDINGS> boundVertexBuffers{};
+		std::array<VkDeviceSize, MAX_VERTEX_BINDINGS> boundVertexOffsets{};
+		VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+		VkDeviceSize boundIndexOffset = 0;
+		VkIndexType boundIndexType = VK_INDEX_TYPE_UINT16;
+
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const DrawItem& item = _items[_entries[i].index];
+
+			if (item.pipeline != boundPipeline)
+			{
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, item.pipeline);
+				boundPipeline = item.pipeline;
+			}
+
+			//a set stays bound across pipelines only while their layouts are compatible, the same layout is the simple safe case
+			if (item.descriptorSet != VK_NULL_HANDLE && (item.descriptorSet != boundSet || item.pipelineLayout != boundLayout))
+			{
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, item.pipelineLayout, 0, 1, &item.descriptorSet, 0, nullptr);
+				boundSet = item.descriptorSet;
+				boundLayout = item.pipelineLayout;
+			}
+
+			uint32_t bindingCount = 0;
+			for (uint32_t binding = 0; binding < MAX_VERTEX_BINDINGS; binding++)
+			{
+				if (item.vertexBuffers[binding] != VK_NULL_HANDLE) bindingCount = binding + 1;
+			}
+			if (bindingCount != 0 && (item.vertexBuffers != boundVertexBuffers || item.vertexBufferOffsets != boundVertexOffsets))
+			{
+				CY_ASSERT(std::find(item.vertexBuffers.begin(), item.vertexBuffers.begin() + bindingCount, VK_NULL_HANDLE) == item.vertexBuffers.begin() + bindingCount);
+				vkCmdBindVertexBuffers(commandBuffer, 0, bindingCount, item.vertexBuffers.data(), item.vertexBufferOffsets.data());
+				boundVertexBuffers = item.vertexBuffers;
+				boundVertexOffsets = item.vertexBufferOffsets;
+			}
+
+			if (item.indexBuffer != VK_NULL_HANDLE && (item.indexBuffer != boundIndexBuffer || item.indexBufferOffset != boundIndexOffset || item.indexType != boundIndexType))
+			{
+				vkCmdBindIndexBuffer(commandBuffer, item.indexBuffer, item.indexBufferOffset, item.indexType);
+				boundIndexBuffer = item.indexBuffer;
+				boundIndexOffset = item.indexBufferOffset;
+				boundIndexType = item.indexType;
+			}
+
+			recordDraw(_context, commandBuffer, item);
+		}
+	}
+
+	/**
+	 * @brief Records only the draw call of item, every bind has to already be done.
+	*/
+	void DrawQueue::recordDraw(VulkanContext& context, VkCommandBuffer commandBuffer, const DrawItem& item)
+	{
+		if (item.indirectBuffer == VK_NULL_HANDLE)
+		{
+			vkCmdDrawIndexed(commandBuffer, item.indexCount, item.instanceCount, item.firstIndex, item.vertexOffset, item.firstInstance);
+		}
+		else if (item.countBuffer != VK_NULL_HANDLE)
+		{
+			CY_ASSERT(context.getDevice()->supportsDrawIndirectCount());
+			vkCmdDrawIndexedIndirectCount(commandBuffer, item.indirectBuffer, item.indirectOffset, item.countBuffer, item.countOffset, item.drawCount, item.stride);
+		}
+		else if (item.drawCount <= 1 || context.getDevice()->supportsMultiDrawIndirect())
+		{
+			vkCmdDrawIndexedIndirect(commandBuffer, item.indirectBuffer, item.indirectOffset, item.drawCount, item.stride);
+		}
+		else
+		{
+			//without multiDrawIndirect the draw count has to be 0 or 1
+			for (uint32_t i = 0; i < item.drawCount; i++)
+			{
+				vkCmdDrawIndexedIndirect(commandBuffer, item.indirectBuffer, item.indirectOffset + static_cast<VkDeviceSize>(i) * item.stride, 1, item.stride);
+			}
+		}
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include "pch.h"
+
+#include "platform/Vulkan/VulkanContext.h"
+#include "platform/Vulkan/VulkanVertexLayout.h"
+#include "core/core.h"
+
+namespace cy3d
+{
+	/**
+	 * @brief Everything needed to record one draw. Draws with an indirectBuffer are recorded as indexed indirect draws,
+	 * if countBuffer is also set the draw count is read from it on the gpu and drawCount is the upper bound.
+	*/
+	struct DrawItem
+	{
+		VkPipeline pipeline{ VK_NULL_HANDLE };
+		VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
+		//bound at set 0
+		VkDescriptorSet descriptorSet{ VK_NULL_HANDLE };
+		//user defined id that groups draws using the same textures and constants
+		uint32_t materialId{ 0 };
+
+		//indexed by binding. The bindings up to the last buffer that is set are bound, so there must be no gaps
+		std::array<VkBuffer, MAX_VERTEX_BINDINGS> vertexBuffers{};
+		std::array<VkDeviceSize, MAX_VERTEX_BINDINGS> vertexBufferOffsets{};
+		VkBuffer indexBuffer{ VK_NULL_HANDLE };
+		VkDeviceSize indexBufferOffset{ 0 };
+		VkIndexType indexType{ VK_INDEX_TYPE_UINT16 };
+
+		uint32_t indexCount{ 0 };
+		uint32_t instanceCount{ 1 };
+		uint32_t firstIndex{ 0 };
+		int32_t vertexOffset{ 0 };
+		uint32_t firstInstance{ 0 };
+
+		VkBuffer indirectBuffer{ VK_NULL_HANDLE };
+		VkDeviceSize indirectOffset{ 0 };
+		VkBuffer countBuffer{ VK_NULL_HANDLE };
+		VkDeviceSize countOffset{ 0 };
+		uint32_t drawCount{ 0 };
+		uint32_t stride{ sizeof(VkDrawIndexedIndirectCommand) };
+	};
+
+	/**
+	 * @brief Collects the draws of a frame, sorts them by a 64 bit key and records them with as few state changes as possible.
+	 *
+	 * Opaque key:      pass (4) | 0 | pipeline (12) | descriptor set (12) | material (12) | depth front to back (23)
+	 * Transparent key: pass (4) | 1 | depth back to front (23) | pipeline (12) | descriptor set (12) | material (12)
+	 *
+	 * Opaque draws are grouped by state first and only ordered by depth within identical state. Transparent draws have to be
+	 * blended in order so depth wins over state. Pipelines and descriptor sets are mapped to small ids the first time they
+	 * are seen in a frame and the mapping is dropped by clear. The ids wrap once a frame uses more than 4096 of them which
+	 * only costs sort quality, never correctness, because the recorder compares the real handles.
+	*/
+	class DrawQueue
+	{
+	public:
+		static constexpr uint32_t PASS_BITS = 4;
+		static constexpr uint32_t ID_BITS = 12;
+		static constexpr uint32_t DEPTH_BITS = 23;
+
+	private:
+		struct SortEntry
+		{
+			uint64_t key;
+			uint32_t index;
+		};
+
+		VulkanContext& _context;
+		std::vector<DrawItem> _items;
+		std::vector<SortEntry> _entries;
+		//scratch buffer for the radix sort
+		std::vector<SortEntry> _sortScratch;
+		bool _sorted{ true };
+
+		//rebuilt every frame
+		std::unordered_map<VkPipeline, uint32_t> _pipelineIds;
+		std::unordered_map<VkDescriptorSet, uint32_t> _descriptorSetIds;
+
+	public:
+		DrawQueue(VulkanContext& context);
+
+		CY_NOCOPY(DrawQueue);
+
+		/**
+		 * @param pass Draws of a lower pass are always recorded first.
+		 * @param depth Normalized [0, 1] view depth used to order draws with the same state.
+		*/
+		void submit(const DrawItem& item, uint32_t pass, float depth, bool transparent = false);
+		void sort();
+		void clear();
+
+		/**
+		 * @brief Records the sorted draws [begin, end). Binds are only emitted when the state differs from the previous draw
+		 * in the range, so each range can be recorded on its own thread into its own command buffer.
+		*/
+		void record(VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end) const;
+
+		uint32_t size() const { return static_cast<uint32_t>(_entries.size()); }
+		bool empty() const { return _entries.empty(); }
+
+		static uint64_t makeKey(uint32_t pass, uint32_t pipelineId, uint32_t descriptorSetId, uint32_t materialId, float depth, bool transparent);
+		static void recordDraw(VulkanContext& context, VkCommandBuffer commandBuffer, const DrawItem& item);
+
+	private:
+		template<typename Handle>
+		static uint32_t idFor(std::unordered_map<Handle, uint32_t>& ids, Handle handle)
+		{
+			auto found = ids.find(handle);
+			if (found != ids.end())
+			{
+				return found->second;
+			}
+			uint32_t id = static_cast<uint32_t>(ids.size()) & ((1u << ID_BITS) - 1);
+			ids.emplace(handle, id);
+			return id;
+		}
+	};
+}
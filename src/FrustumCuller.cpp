@@ -0,0 +1,386 @@
+#include "pch.h"
+#include "FrustumCuller.h"
+#include "GPUCuller.h"
+#include "core/Profiler.h"
+
+#include <bitset>
+#include <random>
+
+/**
+ * Every x86-64 build compiles all three SIMD kernels, whatever the target of the rest of the build is. The AVX and
+ * AVX-512 kernels are compiled for their instruction set through a target attribute on GCC and Clang. MSVC accepts the
+ * intrinsics without /arch. Which kernel runs is decided from CPUID on first use.
+*/
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CY_FRUSTUM_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define CY_FRUSTUM_TARGET_AVX
+#define CY_FRUSTUM_TARGET_AVX512
+#else
+#define CY_FRUSTUM_TARGET_AVX __attribute__((target("avx")))
+#define CY_FRUSTUM_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+
+namespace cy3d
+{
+	namespace
+	{
+		//fails every plane, so the padding past the last object is never visible
+		constexpr float PADDING_RADIUS = -std::numeric_limits<float>::max();
+
+		/**
+		 * @brief The widest path the cpu and the os support. AVX and AVX-512 also need the os to save their registers,
+		 * which XGETBV reports.
+		*/
+		FrustumCullPath detectBestPath()
+		{
+#if !defined(CY_FRUSTUM_X86)
+			return FrustumCullPath::Scalar;
+#elif defined(_MSC_VER) && !defined(__clang__)
+			int info[4];
+			__cpuid(info, 0);
+			int maxLeaf = info[0];
+			__cpuid(info, 1);
+			bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+			bool avx = osSavesYmm && (info[2] & (1 << 28)) != 0;
+			//opmask, upper zmm and zmm16-31 state
+			bool osSavesZmm = osSavesYmm && (_xgetbv(0) & 0xe0) == 0xe0;
+			bool avx512 = false;
+			if (maxLeaf >= 7)
+			{
+				__cpuidex(info, 7, 0);
+				avx512 = osSavesZmm && (info[1] & (1 << 16)) != 0;
+			}
+			return avx512 ? FrustumCullPath::AVX512 : avx ? FrustumCullPath::AVX : FrustumCullPath::SSE;
+#else
+			//also checks the os support
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx512f")) return FrustumCullPath::AVX512;
+			if (__builtin_cpu_supports("avx")) return FrustumCullPath::AVX;
+			return FrustumCullPath::SSE;
+#endif
+		}
+	}
+
+	void FrustumCuller::reserve(uint32_t objectCount)
+	{
+		uint32_t padded = (objectCount + MAX_WIDTH - 1) / MAX_WIDTH * MAX_WIDTH;
+		_centerX.reserve(padded);
+		_centerY.reserve(padded);
+		_centerZ.reserve(padded);
+		_radius.reserve(padded);
+	}
+
+	uint32_t FrustumCuller::addObject(m3d::vec3f center, float radius)
+	{
+		if (_objectCount == paddedCount())
+		{
+			_centerX.resize(_objectCount + MAX_WIDTH, 0.0f);
+			_centerY.resize(_objectCount + MAX_WIDTH, 0.0f);
+			_centerZ.resize(_objectCount + MAX_WIDTH, 0.0f);
+			_radius.resize(_objectCount + MAX_WIDTH, PADDING_RADIUS);
+		}
+		uint32_t id = _objectCount++;
+		updateObject(id, center, radius);
+		return id;
+	}
+
+	void FrustumCuller::updateObject(uint32_t id, m3d::vec3f center, float radius)
+	{
+		CY_ASSERT(id < _objectCount);
+		CY_ASSERT(radius >= 0.0f);
+		_centerX[id] = center.x();
+		_centerY[id] = center.y();
+		_centerZ[id] = center.z();
+		_radius[id] = radius;
+	}
+
+	void FrustumCuller::clearObjects()
+	{
+		_centerX.clear();
+		_centerY.clear();
+		_centerZ.clear();
+		_radius.clear();
+		_objectCount = 0;
+	}
+
+	void FrustumCuller::cull(const m3d::mat4f& viewProj, std::vector<uint32_t>& outVisible, FrustumCullPath path) const
+	{
+		//column major so element [col][row] is stored at col * 4 + row
+		float matrix[16];
+		for (int col = 0; col < 4; col++)
+		{
+			for (int row = 0; row < 4; row++)
+			{
+				matrix[col * 4 + row] = viewProj[col][row];
+			}
+		}
+		float planes[6][4];
+		GPUCuller::extractFrustumPlanes(matrix, planes);
+		cullPlanes(planes, outVisible, path);
+	}
+
+	void FrustumCuller::cull(const m3d::mat4f& view, const m3d::mat4f& proj, std::vector<uint32_t>& outVisible, FrustumCullPath path) const
+	{
+		float matrix[16];
+		for (int col = 0; col < 4; col++)
+		{
+			for (int row = 0; row < 4; row++)
+			{
+				float sum = 0.0f;
+				for (int k = 0; k < 4; k++)
+				{
+					sum += proj[k][row] * view[col][k];
+				}
+				matrix[col * 4 + row] = sum;
+			}
+		}
+		float planes[6][4];
+		GPUCuller::extractFrustumPlanes(matrix, planes);
+		cullPlanes(planes, outVisible, path);
+	}
+
+	void FrustumCuller::cullPlanes(const float planes[6][4], std::vector<uint32_t>& outVisible, FrustumCullPath path) const
+	{
+		CY_PROFILE_FUNCTION();
+		//every lane of the last block writes its index before the cursor is known, so the list needs room for all of them
+		outVisible.resize(paddedCount());
+		if (_objectCount == 0)
+		{
+			return;
+		}
+
+		//the paths are listed from narrowest to widest, one the cpu does not support falls back to the widest one it does
+		if (path == FrustumCullPath::Best || path > bestPath())
+		{
+			path = bestPath();
+		}
+
+		uint32_t visibleCount = 0;
+		switch (path)
+		{
+#ifdef CY_FRUSTUM_X86
+			case FrustumCullPath::AVX512:   visibleCount = cullAVX512(planes, outVisible.data()); break;
+			case FrustumCullPath::AVX:      visibleCount = cullAVX(planes, outVisible.data()); break;
+			case FrustumCullPath::SSE:      visibleCount = cullSSE(planes, outVisible.data()); break;
+#endif
+			default:                        visibleCount = cullScalar(planes, outVisible.data()); break;
+		}
+		outVisible.resize(visibleCount);
+	}
+
+	/**
+	 * @brief The reference every other path has to match. A sphere is visible unless it is entirely behind one plane.
+	*/
+	uint32_t FrustumCuller::cullScalar(const float planes[6][4], uint32_t* outVisible) const
+	{
+		uint32_t visibleCount = 0;
+		for (uint32_t i = 0; i < _objectCount; i++)
+		{
+			bool visible = true;
+			for (int p = 0; p < 6; p++)
+			{
+				//grouped like the SIMD paths so all of them round the same way
+				float distance = (planes[p][0] * _centerX[i] + planes[p][1] * _centerY[i]) + (planes[p][2] * _centerZ[i] + planes[p][3]);
+				if (distance < -_radius[i])
+				{
+					visible = false;
+					break;
+				}
+			}
+			if (visible)
+			{
+				outVisible[visibleCount++] = i;
+			}
+		}
+		return visibleCount;
+	}
+
+#ifdef CY_FRUSTUM_X86
+	uint32_t FrustumCuller::cullSSE(const float planes[6][4], uint32_t* outVisible) const
+	{
+		__m128 a[6], b[6], c[6], d[6];
+		for (int p = 0; p < 6; p++)
+		{
+			a[p] = _mm_set1_ps(planes[p][0]);
+			b[p] = _mm_set1_ps(planes[p][1]);
+			c[p] = _mm_set1_ps(planes[p][2]);
+			d[p] = _mm_set1_ps(planes[p][3]);
+		}
+		const __m128 zero = _mm_setzero_ps();
+
+		uint32_t visibleCount = 0;
+		uint32_t count = paddedCount();
+		for (uint32_t i = 0; i < count; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(&_centerX[i]);
+			__m128 y = _mm_loadu_ps(&_centerY[i]);
+			__m128 z = _mm_loadu_ps(&_centerZ[i]);
+			__m128 r = _mm_loadu_ps(&_radius[i]);
+
+			//distance + radius >= 0 for every plane
+			__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[p], x), _mm_mul_ps(b[p], y)), _mm_add_ps(_mm_mul_ps(c[p], z), d[p]));
+				visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_add_ps(distance, r), zero));
+			}
+
+			uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(visible));
+			for (uint32_t lane = 0; lane < 4; lane++)
+			{
+				outVisible[visibleCount] = i + lane;
+				visibleCount += (mask >> lane) & 1;
+			}
+		}
+		return visibleCount;
+	}
+
+	CY_FRUSTUM_TARGET_AVX uint32_t FrustumCuller::cullAVX(const float planes[6][4], uint32_t* outVisible) const
+	{
+		__m256 a[6], b[6], c[6], d[6];
+		for (int p = 0; p < 6; p++)
+		{
+			a[p] = _mm256_set1_ps(planes[p][0]);
+			b[p] = _mm256_set1_ps(planes[p][1]);
+			c[p] = _mm256_set1_ps(planes[p][2]);
+			d[p] = _mm256_set1_ps(planes[p][3]);
+		}
+		const __m256 zero = _mm256_setzero_ps();
+
+		uint32_t visibleCount = 0;
+		uint32_t count = paddedCount();
+		for (uint32_t i = 0; i < count; i += 8)
+		{
+			__m256 x = _mm256_loadu_ps(&_centerX[i]);
+			__m256 y = _mm256_loadu_ps(&_centerY[i]);
+			__m256 z = _mm256_loadu_ps(&_centerZ[i]);
+			__m256 r = _mm256_loadu_ps(&_radius[i]);
+
+			__m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[p], x), _mm256_mul_ps(b[p], y)), _mm256_add_ps(_mm256_mul_ps(c[p], z), d[p]));
+				visible = _mm256_and_ps(visible, _mm256_cmp_ps(_mm256_add_ps(distance, r), zero, _CMP_GE_OQ));
+			}
+
+			uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(visible));
+			for (uint32_t lane = 0; lane < 8; lane++)
+			{
+				outVisible[visibleCount] = i + lane;
+				visibleCount += (mask >> lane) & 1;
+			}
+		}
+		return visibleCount;
+	}
+
+	CY_FRUSTUM_TARGET_AVX512 uint32_t FrustumCuller::cullAVX512(const float planes[6][4], uint32_t* outVisible) const
+	{
+		__m512 a[6], b[6], c[6], d[6];
+		for (int p = 0; p < 6; p++)
+		{
+			a[p] = _mm512_set1_ps(planes[p][0]);
+			b[p] = _mm512_set1_ps(planes[p][1]);
+			c[p] = _mm512_set1_ps(planes[p][2]);
+			d[p] = _mm512_set1_ps(planes[p][3]);
+		}
+		const __m512 zero = _mm512_setzero_ps();
+		const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+		uint32_t visibleCount = 0;
+		uint32_t count = paddedCount();
+		for (uint32_t i = 0; i < count; i += 16)
+		{
+			__m512 x = _mm512_loadu_ps(&_centerX[i]);
+			__m512 y = _mm512_loadu_ps(&_centerY[i]);
+			__m512 z = _mm512_loadu_ps(&_centerZ[i]);
+			__m512 r = _mm512_loadu_ps(&_radius[i]);
+
+			__mmask16 visible = 0xFFFF;
+			for (int p = 0; p < 6; p++)
+			{
+				__m512 distance = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(a[p], x), _mm512_mul_ps(b[p], y)), _mm512_add_ps(_mm512_mul_ps(c[p], z), d[p]));
+				visible = _mm512_mask_cmp_ps_mask(visible, _mm512_add_ps(distance, r), zero, _CMP_GE_OQ);
+			}
+
+			//the masked store packs the visible lanes, so no lane has to be written speculatively
+			_mm512_mask_compressstoreu_epi32(outVisible + visibleCount, visible, _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(i)), lanes));
+			//popcnt is not part of avx512f
+			visibleCount += static_cast<uint32_t>(std::bitset<16>(visible).count());
+		}
+		return visibleCount;
+	}
+#endif
+
+	FrustumCullPath FrustumCuller::bestPath()
+	{
+		static const FrustumCullPath path = detectBestPath();
+		return path;
+	}
+
+	const char* FrustumCuller::pathName(FrustumCullPath path)
+	{
+		switch (path)
+		{
+			case FrustumCullPath::Best:     return pathName(bestPath());
+			case FrustumCullPath::Scalar:   return "Scalar";
+			case FrustumCullPath::SSE:      return "SSE";
+			case FrustumCullPath::AVX:      return "AVX";
+			case FrustumCullPath::AVX512:   return "AVX512";
+			default:                        return "Unknown";
+		}
+	}
+
+	FrustumCullBenchmark FrustumCuller::benchmark(uint32_t objectCount, uint32_t iterations)
+	{
+		CY_ASSERT(iterations > 0);
+
+		//a fixed seed so runs on different machines cull the same scene
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> size(0.5f, 4.0f);
+
+		FrustumCuller culler;
+		culler.reserve(objectCount);
+		for (uint32_t i = 0; i < objectCount; i++)
+		{
+			culler.addObject(m3d::vec3f{ position(random), position(random), position(random) }, size(random));
+		}
+
+		m3d::mat4f view = m3d::lookAt(m3d::vec3f{ 0.0f, 0.0f, 0.0f }, m3d::vec3f{ 0.0f, 0.0f, -1.0f }, m3d::vec3f{ 0.0f, 1.0f, 0.0f });
+		m3d::mat4f proj = m3d::perspective(m3d::toRadians(90.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+		proj[1][1] *= -1;
+
+		FrustumCullBenchmark result{};
+		result.objectCount = objectCount;
+		result.simdPath = bestPath();
+
+		std::vector<uint32_t> scalarVisible;
+		std::vector<uint32_t> simdVisible;
+		auto time = [&](FrustumCullPath path, std::vector<uint32_t>& visible)
+		{
+			//the first run allocates the output list
+			culler.cull(view, proj, visible, path);
+			uint64_t begin = Profiler::now();
+			for (uint32_t i = 0; i < iterations; i++)
+			{
+				culler.cull(view, proj, visible, path);
+			}
+			return static_cast<double>(Profiler::now() - begin) / 1.0e6 / iterations;
+		};
+		result.scalarMs = time(FrustumCullPath::Scalar, scalarVisible);
+		result.simdMs = time(result.simdPath, simdVisible);
+		result.visibleCount = static_cast<uint32_t>(scalarVisible.size());
+
+		if (scalarVisible != simdVisible)
+		{
+			CY_BASE_LOG_ERROR("Frustum culling: the {0} path kept {1} objects but the scalar path kept {2}.", pathName(result.simdPath), simdVisible.size(), scalarVisible.size());
+		}
+		CY_BASE_LOG_INFO("Frustum culling {0} objects, {1} visible: scalar {2:.3f} ms, {3} {4:.3f} ms.", objectCount, result.visibleCount,
+			result.scalarMs, pathName(result.simdPath), result.simdMs);
+		return result;
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "pch.h"
+
+#include "core/core.h"
+
+namespace cy3d
+{
+	/**
+	 * @brief Every x86-64 build has the SSE, AVX and AVX-512 paths, the widest one the cpu supports is picked at runtime.
+	 * Other targets only have the scalar path, the reference the others are checked against. Listed from narrowest
+	 * to widest after Best.
+	*/
+	enum class FrustumCullPath
+	{
+		Best,
+		Scalar,
+		SSE,
+		AVX,
+		AVX512
+	};
+
+	struct FrustumCullBenchmark
+	{
+		uint32_t objectCount{ 0 };
+		uint32_t visibleCount{ 0 };
+		FrustumCullPath simdPath{ FrustumCullPath::Scalar };
+		//average over all iterations
+		double scalarMs{ 0.0 };
+		double simdMs{ 0.0 };
+	};
+
+	/**
+	 * @brief Culls bounding spheres against the view frustum on the cpu and writes the indices of the visible ones into
+	 * a compacted list.
+	 *
+	 * The spheres are stored as structure of arrays, one array each for the center x, y, z and the radius, so the
+	 * SIMD paths test 4, 8 or 16 spheres against a plane with one load per component. The arrays are padded to a
+	 * multiple of MAX_WIDTH with spheres that fail every plane, which lets every path run over whole blocks without a
+	 * scalar tail. Visible indices are written without branches: every lane writes its index and the output cursor
+	 * only moves past the lanes that passed.
+	 *
+	 * Ids are the indices returned by addObject and stay valid until clearObjects. Not thread safe.
+	*/
+	class FrustumCuller
+	{
+	public:
+		static constexpr uint32_t MAX_WIDTH = 16;
+
+	private:
+		std::vector<float> _centerX;
+		std::vector<float> _centerY;
+		std::vector<float> _centerZ;
+		std::vector<float> _radius;
+		uint32_t _objectCount{ 0 };
+
+	public:
+		FrustumCuller() = default;
+
+		CY_NOCOPY(FrustumCuller);
+
+		void reserve(uint32_t objectCount);
+		uint32_t addObject(m3d::vec3f center, float radius);
+		void updateObject(uint32_t id, m3d::vec3f center, float radius);
+		void clearObjects();
+		uint32_t objectCount() const { return _objectCount; }
+
+		/**
+		 * @brief Replaces outVisible with the ids of every sphere that is at least partially inside the frustum of
+		 * viewProj, in ascending order.
+		*/
+		void cull(const m3d::mat4f& viewProj, std::vector<uint32_t>& outVisible, FrustumCullPath path = FrustumCullPath::Best) const;
+		void cull(const m3d::mat4f& view, const m3d::mat4f& proj, std::vector<uint32_t>& outVisible, FrustumCullPath path = FrustumCullPath::Best) const;
+
+		/**
+		 * @brief The path FrustumCullPath::Best resolves to on this cpu. A requested path the cpu does not support falls
+		 * back to it.
+		*/
+		static FrustumCullPath bestPath();
+		static const char* pathName(FrustumCullPath path);
+
+		/**
+		 * @brief Times the scalar path against the best SIMD path on objectCount random spheres and logs the result.
+		 * Also checks both paths return the same list.
+		*/
+		static FrustumCullBenchmark benchmark(uint32_t objectCount, uint32_t iterations);
+
+	private:
+		void cullPlanes(const float planes[6][4], std::vector<uint32_t>& outVisible, FrustumCullPath path) const;
+		uint32_t cullScalar(const float planes[6][4], uint32_t* outVisible) const;
+		uint32_t cullSSE(const float planes[6][4], uint32_t* outVisible) const;
+		uint32_t cullAVX(const float planes[6][4], uint32_t* outVisible) const;
+		uint32_t cullAVX512(const float planes[6][4], uint32_t* outVisible) const;
+		uint32_t paddedCount() const { return static_cast<uint32_t>(_radius.size()); }
+	};
+}
@@ -0,0 +1,328 @@
+#include "pch.h"
+#include "GPUCuller.h"
+#include "platform/Vulkan/VulkanSwapChain.h"
+#include "platform/Vulkan/VulkanDevice.h"
+#include "platform/Vulkan/VulkanRenderer.h"
+#include "platform/Vulkan/VulkanDeletionQueue.h"
+
+namespace cy3d
+{
+	GPUCuller::GPUCuller(VulkanContext& context, uint32_t maxObjects) : _context(context), _maxObjects(maxObjects)
+	{
+		init();
+	}
+
+	GPUCuller::~GPUCuller()
+	{
+
+	}
+
+	void GPUCuller::init()
+	{
+		CY_ASSERT(_maxObjects > 0);
+		_objects.resize(_maxObjects);
+
+		if (_context.getDevice()->supportsDrawIndirectCount())
+		{
+			_flags |= CULL_FLAG_COMPACT;
+		}
+
+		if (!_context.getShaderManager()->has("Culling"))
+		{
+			_context.getShaderManager()->add("resources/shaders/culling", "Culling");
+		}
+		_shader = _context.getShaderManager()->get("Culling");
+
+		createPipeline();
+		createBuffers();
+		createPlaceholderHiZ();
+	}
+
+	void GPUCuller::createPipeline()
+	{
+		_pipeline.reset(new VulkanComputePipeline(_context, _shader));
+		CY_ASSERT(_pipeline->getWorkgroupSize()[0] == WORKGROUP_SIZE);
+	}
+
+	/**
+	 * @brief Picks up a hot reloaded Culling shader. The buffers were sized from the old shader's reflection,
+	 * so a reload that changes its layout is ignored until the culler is recreated.
+	*/
+	void GPUCuller::reloadPipeline()
+	{
+		Ref<VulkanShader> previous = _pipeline->getShader();
+		Ref<VulkanShader> current = _context.getShaderManager()->getCurrent(previous);
+		if (current == previous || current == _rejectedShader)
+		{
+			return;
+		}
+
+		if (current->getPipelineLayout() != previous->getPipelineLayout() || current->getWorkgroupSize() != previous->getWorkgroupSize())
+		{
+			_rejectedShader = current;
+			CY_BASE_LOG_ERROR("The reloaded {0} shader changed its layout or workgroup size, the culler keeps the previous pipeline.", current->getName());
+			return;
+		}
+
+		//the previous pipeline may still be used by frames in flight
+		std::shared_ptr<VulkanComputePipeline> retired(std::move(_pipeline));
+		_context.getDeletionQueue()->push([retired]() {});
+		_pipeline.reset(new VulkanComputePipeline(_context, current));
+		_shader = current;
+	}
+
+	void GPUCuller::createBuffers()
+	{
+		std::size_t frames = VulkanSwapChain::MAX_FRAMES_IN_FLIGHT;
+		VkDeviceSize objectsSize = sizeof(CullObject) * _maxObjects;
+		VkDeviceSize drawsSize = sizeof(VkDrawIndexedIndirectCommand) * _maxObjects;
+
+		BufferCreateInfo uboInfo = _shader->getDescriptorSetUBOInfo(0, "CullData").createInfo;
+		//the reflected size does not include the trailing padding of CullUboData
+		CY_ASSERT(uboInfo.bufferInfo.size <= sizeof(CullUboData));
+
+		_cullUbos.resize(frames);
+		_objectBuffers.resize(frames);
+		_drawBuffers.resize(frames);
+		_countBuffers.resize(frames);
+		_dirtyRanges.resize(frames, { 0, 0 });
+		for (std::size_t i = 0; i < frames; i++)
+		{
+			_cullUbos[i].reset(new VulkanBuffer(_context, uboInfo));
+			_objectBuffers[i].reset(new VulkanBuffer(_context, BufferCreateInfo::createGPUCPUCoherentBufferInfo(objectsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)));
+			_drawBuffers[i].reset(new VulkanBuffer(_context, BufferCreateInfo::createGPUOnlyBufferInfo(drawsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT)));
+			_countBuffers[i].reset(new VulkanBuffer(_context, BufferCreateInfo::createGPUOnlyBufferInfo(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT)));
+		}
+	}
+
+	/**
+	 * @brief A 1x1 pyramid at the far plane. Nothing is ever behind it so it never occludes anything,
+	 * it only exists so binding 4 is valid before a real pyramid is set.
+	*/
+	void GPUCuller::createPlaceholderHiZ()
+	{
+		ImageInfo info{};
+		info.format = VK_FORMAT_R32_SFLOAT;
+		info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		info.aspectFlags = VK_IMAGE_ASPECT_COLOR_BIT;
+		info.width = 1;
+		info.height = 1;
+		info.imageSize = sizeof(float);
+
+		float farDepth = 1.0f;
+		_placeholderHiZ.reset(new VulkanImage(_context, ImageCreateInfo::createDefaultImageInfo(info), &farDepth));
+		_placeholderSampler.reset(new VulkanSampler(_context));
+
+		_hizInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		_hizInfo.imageView = _placeholderHiZ->getImageView();
+		_hizInfo.sampler = _placeholderSampler->getSampler();
+		_hizParams[0] = 1.0f;
+		_hizParams[1] = 1.0f;
+		_hizParams[2] = 1.0f;
+	}
+
+	/**
+	 * @brief A transient set for this frame's pass, only valid until the frame index comes around again.
+	*/
+	VkDescriptorSet GPUCuller::allocateDescriptorSet(std::size_t frame)
+	{
+		const Ref<VulkanDescriptorSetLayout>& layout = _pipeline->getShader()->getSharedSetLayouts()[0];
+		VkDescriptorSet set = _context.getFrameDescriptorAllocator()->allocate(layout->getLayout());
+
+		std::vector<DescriptorInfo> infos(layout->getSlotCount());
+		infos[layout->getSlot(0)].buffer = _cullUbos[frame]->descriptorInfo();
+		infos[layout->getSlot(1)].buffer = _objectBuffers[frame]->descriptorInfo();
+		infos[layout->getSlot(2)].buffer = _drawBuffers[frame]->descriptorInfo();
+		infos[layout->getSlot(3)].buffer = _countBuffers[frame]->descriptorInfo();
+		infos[layout->getSlot(4)].image = _hizInfo;
+		layout->update(set, infos.data());
+		return set;
+	}
+
+	uint32_t GPUCuller::addObject(const CullObject& object)
+	{
+		CY_ASSERT(_objectCount < _maxObjects);
+		_objects[_objectCount] = object;
+		markDirty(_objectCount, _objectCount + 1);
+		return _objectCount++;
+	}
+
+	void GPUCuller::updateObject(uint32_t id, const CullObject& object)
+	{
+		CY_ASSERT(id < _objectCount);
+		_objects[id] = object;
+		markDirty(id, id + 1);
+	}
+
+	void GPUCuller::markDirty(uint32_t first, uint32_t last)
+	{
+		//every frame's buffer is written separately so each one tracks its own range
+		for (auto& range : _dirtyRanges)
+		{
+			if (range.first == range.second)
+			{
+				range = { first, last };
+			}
+			else
+			{
+				range = { std::min(range.first, first), std::max(range.second, last) };
+			}
+		}
+	}
+
+	/**
+	 * @brief The pyramid has to hold the max depth of each texel footprint, be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	 * when the culling pass runs and be sampled with a nearest, clamp to edge sampler. It is bound from the next cull() on.
+	*/
+	void GPUCuller::setHiZPyramid(const VkDescriptorImageInfo& pyramid, uint32_t width, uint32_t height, uint32_t mipCount)
+	{
+		_hizInfo = pyramid;
+		_hizParams[0] = static_cast<float>(width);
+		_hizParams[1] = static_cast<float>(height);
+		_hizParams[2] = static_cast<float>(mipCount);
+	}
+
+	/**
+	 * @brief Records the culling dispatch. Has to be called outside of a render pass and before draw() in the same frame.
+	*/
+	void GPUCuller::cull(VkCommandBuffer commandBuffer, const m3d::mat4f& view, const m3d::mat4f& proj)
+	{
+		std::size_t frame = _context.getCurrentFrameIndex();
+		reloadPipeline();
+
+		CullUboData cullData{};
+		//column major so element [col][row] is stored at col * 4 + row
+		for (int col = 0; col < 4; col++)
+		{
+			for (int row = 0; row < 4; row++)
+			{
+				float sum = 0.0f;
+				for (int k = 0; k < 4; k++)
+				{
+					sum += proj[k][row] * view[col][k];
+				}
+				cullData.viewProj[col * 4 + row] = sum;
+			}
+		}
+		extractFrustumPlanes(cullData.viewProj, cullData.planes);
+		std::copy(std::begin(_hizParams), std::end(_hizParams), std::begin(cullData.hizParams));
+		cullData.objectCount = _objectCount;
+		cullData.flags = _flags;
+
+		_cullUbos[frame]->setData(&cullData);
+		//only the objects changed since this frame's buffer was last written are uploaded, the shader never reads past objectCount
+		auto& dirty = _dirtyRanges[frame];
+		if (dirty.first < dirty.second)
+		{
+			_objectBuffers[frame]->setData(_objects.data() + dirty.first, sizeof(CullObject) * (dirty.second - dirty.first), static_cast<uint32_t>(sizeof(CullObject) * dirty.first));
+			dirty = { 0, 0 };
+		}
+
+		if (_objectCount == 0)
+		{
+			return;
+		}
+
+		VkBuffer countBuffer = _countBuffers[frame]->getBuffer();
+		VkBuffer drawBuffer = _drawBuffers[frame]->getBuffer();
+
+		if (usesDrawIndirectCount())
+		{
+			vkCmdFillBuffer(commandBuffer, countBuffer, 0, sizeof(uint32_t), 0);
+
+			//the atomic add in the shader has to see the cleared count
+			VkBufferMemoryBarrier clearBarrier{};
+			clearBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			clearBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			clearBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			clearBarrier.buffer = countBuffer;
+			clearBarrier.offset = 0;
+			clearBarrier.size = VK_WHOLE_SIZE;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &clearBarrier, 0, nullptr);
+		}
+
+		_context.getRenderer()->dispatch(*_pipeline, { allocateDescriptorSet(frame) }, _pipeline->groupCount(_objectCount), 1, 1, commandBuffer);
+
+		//the generated commands and count are consumed by the indirect draw
+		std::array<VkBufferMemoryBarrier, 2> drawBarriers{};
+		for (auto& barrier : drawBarriers)
+		{
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+		}
+		drawBarriers[0].buffer = drawBuffer;
+		drawBarriers[1].buffer = countBuffer;
+		uint32_t barrierCount = usesDrawIndirectCount() ? 2 : 1;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, nullptr, barrierCount, drawBarriers.data(), 0, nullptr);
+	}
+
+	/**
+	 * @brief Points item at the draws generated by cull() for the current frame. Only the indirect members are written,
+	 * the pipeline and buffers the draws use are left to the caller.
+	*/
+	void GPUCuller::setIndirectDraw(DrawItem& item)
+	{
+		std::size_t frame = _context.getCurrentFrameIndex();
+		item.indirectBuffer = _drawBuffers[frame]->getBuffer();
+		item.indirectOffset = 0;
+		item.countBuffer = usesDrawIndirectCount() ? _countBuffers[frame]->getBuffer() : VK_NULL_HANDLE;
+		item.countOffset = 0;
+		item.drawCount = _objectCount;
+		item.stride = sizeof(VkDrawIndexedIndirectCommand);
+	}
+
+	/**
+	 * @brief Records the draws generated by cull(). The graphics pipeline, descriptor sets, vertex and index buffers
+	 * have to be bound by the caller.
+	*/
+	void GPUCuller::draw(VkCommandBuffer commandBuffer)
+	{
+		if (_objectCount == 0)
+		{
+			return;
+		}
+
+		DrawItem item{};
+		setIndirectDraw(item);
+		DrawQueue::recordDraw(_context, commandBuffer, item);
+	}
+
+	/**
+	 * @brief Gribb/Hartmann plane extraction for a column major view projection matrix with a [0, 1] depth range.
+	 * The planes point inwards and are normalized so the distance to a sphere center can be compared with its radius.
+	*/
+	void GPUCuller::extractFrustumPlanes(const float viewProj[16], float outPlanes[6][4])
+	{
+		auto row = [&](int r, int c) { return viewProj[c * 4 + r]; };
+
+		for (int c = 0; c < 4; c++)
+		{
+			outPlanes[0][c] = row(3, c) + row(0, c); //left
+			outPlanes[1][c] = row(3, c) - row(0, c); //right
+			outPlanes[2][c] = row(3, c) + row(1, c); //bottom
+			outPlanes[3][c] = row(3, c) - row(1, c); //top
+			outPlanes[4][c] = row(2, c);             //near
+			outPlanes[5][c] = row(3, c) - row(2, c); //far
+		}
+
+		for (int i = 0; i < 6; i++)
+		{
+			float length = std::sqrt(outPlanes[i][0] * outPlanes[i][0] + outPlanes[i][1] * outPlanes[i][1] + outPlanes[i][2] * outPlanes[i][2]);
+			if (length > 0.0f)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					outPlanes[i][c] /= length;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include "pch.h"
+
+#include "platform/Vulkan/VulkanContext.h"
+#include "platform/Vulkan/VulkanDescriptors.h"
+#include "platform/Vulkan/VulkanBuffer.h"
+#include "platform/Vulkan/VulkanTexture.h"
+#include "platform/Vulkan/VulkanComputePipeline.h"
+
+#include "core/core.h"
+#include "ShaderManager.h"
+#include "DrawQueue.h"
+
+namespace cy3d
+{
+	//Must match the flags in resources/shaders/culling/Culling.comp
+	constexpr uint32_t CULL_FLAG_FRUSTUM = 1;
+	constexpr uint32_t CULL_FLAG_OCCLUSION = 2;
+	constexpr uint32_t CULL_FLAG_COMPACT = 4;
+
+	/**
+	 * @brief One indexed draw that is culled as a whole against its world space bounding sphere.
+	 * Laid out to match the std430 CullObject struct in Culling.comp.
+	*/
+	struct CullObject
+	{
+		float sphere[4]{}; //xyz center, w radius
+		uint32_t indexCount{ 0 };
+		uint32_t firstIndex{ 0 };
+		int32_t vertexOffset{ 0 };
+		uint32_t firstInstance{ 0 };
+	};
+
+	/**
+	 * @brief Laid out to match the std140 CullData block in Culling.comp.
+	*/
+	struct CullUboData
+	{
+		alignas(16) float planes[6][4]{};
+		alignas(16) float viewProj[16]{};
+		alignas(16) float hizParams[4]{};
+		uint32_t objectCount{ 0 };
+		uint32_t flags{ 0 };
+		uint32_t padding[2]{};
+	};
+
+	/**
+	 * @brief Culls a list of objects on the gpu and writes the surviving ones out as indexed indirect draw commands,
+	 * so neither the visibility test nor the draw list ever goes through the cpu.
+	 *
+	 * cull() records the compute pass into the frame's primary command buffer and must be called outside of a render pass.
+	 * draw() then records the indirect draw inside the render pass. When drawIndirectCount is supported the visible
+	 * commands are compacted and the draw count is read from a gpu buffer. Otherwise every object keeps its slot and
+	 * culled objects are drawn with an instance count of zero.
+	 *
+	 * Occlusion culling is only done once a max depth pyramid has been handed over with setHiZPyramid.
+	*/
+	class GPUCuller
+	{
+	public:
+		//Must match local_size_x in Culling.comp
+		static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+	private:
+		VulkanContext& _context;
+		uint32_t _maxObjects;
+
+		Scope<VulkanComputePipeline> _pipeline{ nullptr };
+		Ref<VulkanShader> _shader{ nullptr };
+		//the last reloaded shader that could not replace the pipeline, so it is only reported once
+		Ref<VulkanShader> _rejectedShader{ nullptr };
+
+		//one of each per frame in flight
+		std::vector<Scope<VulkanBuffer>> _cullUbos;
+		std::vector<Scope<VulkanBuffer>> _objectBuffers;
+		std::vector<Scope<VulkanBuffer>> _drawBuffers;
+		std::vector<Scope<VulkanBuffer>> _countBuffers;
+
+		//bound until a real depth pyramid is set
+		Scope<VulkanImage> _placeholderHiZ{ nullptr };
+		Scope<VulkanSampler> _placeholderSampler{ nullptr };
+		VkDescriptorImageInfo _hizInfo{};
+		float _hizParams[4]{};
+
+		std::vector<CullObject> _objects;
+		//per frame in flight, the [first, last) objects that changed since that frame's buffer was last written
+		std::vector<std::pair<uint32_t, uint32_t>> _dirtyRanges;
+		uint32_t _objectCount{ 0 };
+		uint32_t _flags{ CULL_FLAG_FRUSTUM };
+
+	public:
+		GPUCuller(VulkanContext& context, uint32_t maxObjects);
+		~GPUCuller();
+
+		CY_NOCOPY(GPUCuller);
+
+		uint32_t addObject(const CullObject& object);
+		void updateObject(uint32_t id, const CullObject& object);
+		void clearObjects() { _objectCount = 0; }
+		uint32_t objectCount() { return _objectCount; }
+
+		void setHiZPyramid(const VkDescriptorImageInfo& pyramid, uint32_t width, uint32_t height, uint32_t mipCount);
+		void setFrustumCulling(bool enabled) { setFlag(CULL_FLAG_FRUSTUM, enabled); }
+		void setOcclusionCulling(bool enabled) { setFlag(CULL_FLAG_OCCLUSION, enabled); }
+		bool usesDrawIndirectCount() { return (_flags & CULL_FLAG_COMPACT) != 0; }
+
+		void cull(VkCommandBuffer commandBuffer, const m3d::mat4f& view, const m3d::mat4f& proj);
+		void draw(VkCommandBuffer commandBuffer);
+		void setIndirectDraw(DrawItem& item);
+
+		static void extractFrustumPlanes(const float viewProj[16], float outPlanes[6][4]);
+
+	private:
+		void init();
+		void createPipeline();
+		void reloadPipeline();
+		void createBuffers();
+		void createPlaceholderHiZ();
+		VkDescriptorSet allocateDescriptorSet(std::size_t frame);
+		void markDirty(uint32_t first, uint32_t last);
+		void setFlag(uint32_t flag, bool enabled) { _flags = enabled ? (_flags | flag) : (_flags & ~flag); }
+	};
+}
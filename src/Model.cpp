@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "Model.h"
+#include "core/Profiler.h"
 
 namespace cy3d
 {
@@ -11,6 +12,7 @@ namespace cy3d
 
     void Model::loadModel(const std::string& path)
 	{
+		CY_PROFILE_SCOPE("Model::loadModel");
 
 		MD_ASSERT(std::filesystem::exists(path));
 
@@ -0,0 +1,289 @@
+#include "pch.h"
+#include "Scene.h"
+#include "core/Profiler.h"
+
+namespace cy3d
+{
+	namespace
+	{
+		/**
+		 * @brief translation * rotation * scale, column major so element [col][row].
+		*/
+		m3d::mat4f composeTransform(m3d::vec3f t, m3d::vec4f q, m3d::vec3f s)
+		{
+			float x = q.x(), y = q.y(), z = q.z(), w = q.w();
+			m3d::mat4f m{};
+			m[0][0] = (1.0f - 2.0f * (y * y + z * z)) * s.x();
+			m[0][1] = (2.0f * (x * y + w * z)) * s.x();
+			m[0][2] = (2.0f * (x * z - w * y)) * s.x();
+			m[0][3] = 0.0f;
+			m[1][0] = (2.0f * (x * y - w * z)) * s.y();
+			m[1][1] = (1.0f - 2.0f * (x * x + z * z)) * s.y();
+			m[1][2] = (2.0f * (y * z + w * x)) * s.y();
+			m[1][3] = 0.0f;
+			m[2][0] = (2.0f * (x * z + w * y)) * s.z();
+			m[2][1] = (2.0f * (y * z - w * x)) * s.z();
+			m[2][2] = (1.0f - 2.0f * (x * x + y * y)) * s.z();
+			m[2][3] = 0.0f;
+			m[3][0] = t.x();
+			m[3][1] = t.y();
+			m[3][2] = t.z();
+			m[3][3] = 1.0f;
+			return m;
+		}
+
+		m3d::mat4f multiply(const m3d::mat4f& a, const m3d::mat4f& b)
+		{
+			m3d::mat4f result{};
+			for (int col = 0; col < 4; col++)
+			{
+				for (int row = 0; row < 4; row++)
+				{
+					result[col][row] = a[0][row] * b[col][0] + a[1][row] * b[col][1] + a[2][row] * b[col][2] + a[3][row] * b[col][3];
+				}
+			}
+			return result;
+		}
+	}
+
+	NodeId Scene::createNode(NodeId parent)
+	{
+		CY_ASSERT(parent == INVALID_NODE || isValid(parent));
+
+		NodeId node = static_cast<NodeId>(_slotOfNode.size());
+		if (!_freeIds.empty())
+		{
+			node = _freeIds.back();
+			_freeIds.pop_back();
+		}
+		else
+		{
+			_slotOfNode.push_back(INVALID_NODE);
+		}
+
+		//appended after every existing slot, so after its parent as well
+		uint32_t newSlot = static_cast<uint32_t>(_nodeOfSlot.size());
+		_translations.push_back(m3d::vec3f{ 0.0f, 0.0f, 0.0f });
+		_rotations.push_back(m3d::vec4f{ 0.0f, 0.0f, 0.0f, 1.0f });
+		_scales.push_back(m3d::vec3f{ 1.0f, 1.0f, 1.0f });
+		_worldTransforms.push_back(m3d::mat4f{});
+		_parents.push_back(parent == INVALID_NODE ? INVALID_NODE : slot(parent));
+		_dirty.push_back(0);
+		_nodeOfSlot.push_back(node);
+		_slotOfNode[node] = newSlot;
+
+		markDirty(newSlot);
+		return node;
+	}
+
+	/**
+	 * @brief Only the node's own slot is unlinked here. Its descendants are dropped by the next sort, which every
+	 * destroyed node shares, so destroying k nodes costs one pass over the slots instead of k.
+	*/
+	void Scene::destroyNode(NodeId node)
+	{
+		_nodeOfSlot[slot(node)] = INVALID_NODE;
+		_slotOfNode[node] = INVALID_NODE;
+		_freeIds.push_back(node);
+		_needsSort = true;
+	}
+
+	void Scene::setParent(NodeId node, NodeId parent)
+	{
+		uint32_t nodeSlot = slot(node);
+		uint32_t parentSlot = INVALID_NODE;
+		if (parent != INVALID_NODE)
+		{
+			parentSlot = slot(parent);
+			for (uint32_t ancestor = parentSlot; ancestor != INVALID_NODE; ancestor = _parents[ancestor])
+			{
+				CY_ASSERT(ancestor != nodeSlot); //a node can not be parented to itself or one of its descendants
+			}
+		}
+
+		_parents[nodeSlot] = parentSlot;
+		if (parentSlot != INVALID_NODE && parentSlot > nodeSlot)
+		{
+			_needsSort = true;
+		}
+		markDirty(nodeSlot);
+	}
+
+	NodeId Scene::getParent(NodeId node) const
+	{
+		uint32_t parent = _parents[slot(node)];
+		return parent == INVALID_NODE ? INVALID_NODE : _nodeOfSlot[parent];
+	}
+
+	void Scene::setTranslation(NodeId node, const m3d::vec3f& translation)
+	{
+		uint32_t s = slot(node);
+		_translations[s] = translation;
+		markDirty(s);
+	}
+
+	void Scene::setRotation(NodeId node, const m3d::vec4f& rotation)
+	{
+		uint32_t s = slot(node);
+		_rotations[s] = rotation;
+		markDirty(s);
+	}
+
+	void Scene::setScale(NodeId node, const m3d::vec3f& scale)
+	{
+		uint32_t s = slot(node);
+		_scales[s] = scale;
+		markDirty(s);
+	}
+
+	void Scene::setLocalTransform(NodeId node, const m3d::vec3f& translation, const m3d::vec4f& rotation, const m3d::vec3f& scale)
+	{
+		uint32_t s = slot(node);
+		_translations[s] = translation;
+		_rotations[s] = rotation;
+		_scales[s] = scale;
+		markDirty(s);
+	}
+
+	void Scene::markDirty(uint32_t slot)
+	{
+		_dirty[slot] = 1;
+		_firstDirty = std::min(_firstDirty, slot);
+	}
+
+	void Scene::updateWorldTransforms()
+	{
+		CY_PROFILE_FUNCTION();
+		if (_needsSort)
+		{
+			sort();
+		}
+
+		uint32_t count = static_cast<uint32_t>(_nodeOfSlot.size());
+		for (uint32_t s = _firstDirty; s < count; s++)
+		{
+			uint32_t parent = _parents[s];
+			//the parent's flag is final because it comes first, a dirty parent dirties the whole subtree below it
+			bool parentDirty = parent != INVALID_NODE && _dirty[parent] != 0;
+			if (_dirty[s] == 0 && !parentDirty)
+			{
+				continue;
+			}
+
+			_dirty[s] = 1;
+			m3d::mat4f local = composeTransform(_translations[s], _rotations[s], _scales[s]);
+			_worldTransforms[s] = parent == INVALID_NODE ? local : multiply(_worldTransforms[parent], local);
+		}
+
+		if (_firstDirty < count)
+		{
+			std::fill(_dirty.begin() + _firstDirty, _dirty.end(), 0);
+		}
+		_firstDirty = count;
+	}
+
+	/**
+	 * @brief Drops destroyed slots and reorders the rest depth first, so every parent comes before its children and
+	 * each subtree is contiguous. The walk starts at the live roots and never enters a destroyed slot, so the nodes
+	 * below a destroyed node are dropped as well and their handles freed. Dirty flags move with their slots.
+	*/
+	void Scene::sort()
+	{
+		CY_PROFILE_FUNCTION();
+		uint32_t count = static_cast<uint32_t>(_nodeOfSlot.size());
+
+		//children of every live slot in slot order, as offsets into one array
+		std::vector<uint32_t> childStart(count + 1, 0);
+		for (uint32_t s = 0; s < count; s++)
+		{
+			if (_nodeOfSlot[s] != INVALID_NODE && _parents[s] != INVALID_NODE)
+			{
+				childStart[_parents[s] + 1]++;
+			}
+		}
+		for (uint32_t s = 0; s < count; s++)
+		{
+			childStart[s + 1] += childStart[s];
+		}
+		std::vector<uint32_t> children(childStart[count]);
+		std::vector<uint32_t> fill(childStart.begin(), childStart.end() - 1);
+		for (uint32_t s = 0; s < count; s++)
+		{
+			if (_nodeOfSlot[s] != INVALID_NODE && _parents[s] != INVALID_NODE)
+			{
+				children[fill[_parents[s]]++] = s;
+			}
+		}
+
+		std::vector<uint32_t> order;
+		order.reserve(count);
+		std::vector<uint32_t> stack;
+		for (uint32_t root = 0; root < count; root++)
+		{
+			if (_nodeOfSlot[root] == INVALID_NODE || _parents[root] != INVALID_NODE)
+			{
+				continue;
+			}
+			stack.push_back(root);
+			while (!stack.empty())
+			{
+				uint32_t s = stack.back();
+				stack.pop_back();
+				order.push_back(s);
+				//pushed in reverse so children keep their relative order
+				for (uint32_t c = childStart[s + 1]; c > childStart[s]; c--)
+				{
+					stack.push_back(children[c - 1]);
+				}
+			}
+		}
+
+		std::vector<uint32_t> newSlot(count, INVALID_NODE);
+		for (uint32_t i = 0; i < order.size(); i++)
+		{
+			newSlot[order[i]] = i;
+		}
+		for (uint32_t s = 0; s < count; s++)
+		{
+			//still linked but below a destroyed node
+			if (newSlot[s] == INVALID_NODE && _nodeOfSlot[s] != INVALID_NODE)
+			{
+				_slotOfNode[_nodeOfSlot[s]] = INVALID_NODE;
+				_freeIds.push_back(_nodeOfSlot[s]);
+			}
+		}
+
+		auto permute = [&order](auto& values)
+		{
+			std::remove_reference_t<decltype(values)> sorted;
+			sorted.reserve(order.size());
+			for (uint32_t s : order)
+			{
+				sorted.push_back(values[s]);
+			}
+			values = std::move(sorted);
+		};
+		permute(_translations);
+		permute(_rotations);
+		permute(_scales);
+		permute(_worldTransforms);
+		permute(_dirty);
+		permute(_nodeOfSlot);
+		permute(_parents);
+
+		_firstDirty = static_cast<uint32_t>(order.size());
+		for (uint32_t s = 0; s < order.size(); s++)
+		{
+			if (_parents[s] != INVALID_NODE)
+			{
+				_parents[s] = newSlot[_parents[s]];
+			}
+			_slotOfNode[_nodeOfSlot[s]] = s;
+			if (_dirty[s] != 0)
+			{
+				_firstDirty = std::min(_firstDirty, s);
+			}
+		}
+		_needsSort = false;
+	}
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "pch.h"
+
+#include "core/core.h"
+
+namespace cy3d
+{
+	using NodeId = uint32_t;
+	constexpr NodeId INVALID_NODE = std::numeric_limits<NodeId>::max();
+
+	/**
+	 * @brief A retained scene graph stored as structure of arrays. Every node has a translation, a rotation quaternion
+	 * (x, y, z, w), a scale and a world matrix, each kept in its own array indexed by the node's slot.
+	 *
+	 * Slots are ordered so a parent always comes before its children. updateWorldTransforms can then recompute the world
+	 * matrices in one linear pass: a slot is dirty if it was changed or its parent's slot was, and the parent's world
+	 * matrix is always final by the time the child is reached. The pass starts at the first dirty slot and only
+	 * composes the dirty ones, so a frame in which a few nodes moved costs a scan of flags rather than a rebuild of
+	 * every matrix.
+	 *
+	 * NodeIds are stable handles. Reparenting a node under a later slot or destroying nodes reorders the slots, which
+	 * is deferred to the next updateWorldTransforms. Not thread safe.
+	*/
+	class Scene
+	{
+	private:
+		//indexed by slot
+		std::vector<m3d::vec3f> _translations;
+		std::vector<m3d::vec4f> _rotations;
+		std::vector<m3d::vec3f> _scales;
+		std::vector<m3d::mat4f> _worldTransforms;
+		//the slot of the parent, INVALID_NODE for roots. Always smaller than the slot itself once sorted
+		std::vector<uint32_t> _parents;
+		std::vector<uint8_t> _dirty;
+		std::vector<NodeId> _nodeOfSlot;
+
+		//indexed by NodeId, INVALID_NODE for destroyed nodes
+		std::vector<uint32_t> _slotOfNode;
+		std::vector<NodeId> _freeIds;
+
+		//updateWorldTransforms skips every slot before it
+		uint32_t _firstDirty{ 0 };
+		//a parent was moved behind one of its children or nodes were destroyed
+		bool _needsSort{ false };
+
+	public:
+		Scene() = default;
+
+		CY_NOCOPY(Scene);
+
+		/**
+		 * @brief Adds a node with an identity transform. The node is a root if parent is INVALID_NODE.
+		*/
+		NodeId createNode(NodeId parent = INVALID_NODE);
+		/**
+		 * @brief Destroys node and every node below it. node's handle is released right away, the handles of the nodes
+		 * below it stay valid until the next updateWorldTransforms drops them.
+		*/
+		void destroyNode(NodeId node);
+		void setParent(NodeId node, NodeId parent);
+
+		void setTranslation(NodeId node, const m3d::vec3f& translation);
+		void setRotation(NodeId node, const m3d::vec4f& rotation);
+		void setScale(NodeId node, const m3d::vec3f& scale);
+		void setLocalTransform(NodeId node, const m3d::vec3f& translation, const m3d::vec4f& rotation, const m3d::vec3f& scale);
+
+		const m3d::vec3f& getTranslation(NodeId node) const { return _translations[slot(node)]; }
+		const m3d::vec4f& getRotation(NodeId node) const { return _rotations[slot(node)]; }
+		const m3d::vec3f& getScale(NodeId node) const { return _scales[slot(node)]; }
+		NodeId getParent(NodeId node) const;
+		/**
+		 * @brief The world matrix as of the last updateWorldTransforms.
+		*/
+		const m3d::mat4f& getWorldTransform(NodeId node) const { return _worldTransforms[slot(node)]; }
+
+		/**
+		 * @brief Recomputes the world matrices of every node that changed since the last call and of everything below
+		 * them.
+		*/
+		void updateWorldTransforms();
+
+		bool isValid(NodeId node) const { return node < _slotOfNode.size() && _slotOfNode[node] != INVALID_NODE; }
+		/**
+		 * @brief The number of slots. Only equal to the number of live nodes after updateWorldTransforms, until then it
+		 * still counts the nodes destroyed since and the nodes below them.
+		*/
+		std::size_t nodeCount() const { return _nodeOfSlot.size(); }
+
+		/**
+		 * @brief The world matrices in slot order. Together with getSlotNodes this lets callers walk every node without
+		 * going through the handles. Only meant to be walked right after updateWorldTransforms: before it the slots of
+		 * destroyed nodes are still there with INVALID_NODE as their node, and so are the nodes below them.
+		*/
+		const std::vector<m3d::mat4f>& getWorldTransforms() const { return _worldTransforms; }
+		const std::vector<NodeId>& getSlotNodes() const { return _nodeOfSlot; }
+
+	private:
+		uint32_t slot(NodeId node) const
+		{
+			CY_ASSERT(isValid(node));
+			return _slotOfNode[node];
+		}
+		void markDirty(uint32_t slot);
+		void sort();
+	};
+}
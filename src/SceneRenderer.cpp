@@ -2,7 +2,11 @@
 #include "SceneRenderer.h"
 #include "platform/Vulkan/VulkanSwapChain.h"
 #include "platform/Vulkan/VulkanRenderer.h"
+#include "platform/Vulkan/VulkanPipelineLibrary.h"
+#include "platform/Vulkan/VulkanDescriptorSetCache.h"
+#include "platform/Vulkan/VulkanVertexLayout.h"
 #include "core/core.h"
+#include "core/Profiler.h"
 
 namespace cy3d
 {
@@ -18,6 +22,8 @@ namespace cy3d
 	void SceneRenderer::beginScene(std::shared_ptr<Camera> camera)
 	{
 
+		Profiler::nextFrame();
+		CY_PROFILE_SCOPE("SceneRenderer::beginScene");
 		CY_ASSERT(isSceneStart() == false);
 		_context.getRenderer()->beginFrame();
 		if (_context.getRenderer()->needsResize())
@@ -26,14 +32,42 @@ namespace cy3d
 			return;
 		}
 		_isSceneStart = true;
+		//reloaded shaders are swapped in before the library collects, so their pipelines start compiling this frame
+		_context.getShaderManager()->update();
+		const PipelineState& requested = _pendingState ? *_pendingState : _pipelineState;
+		Ref<VulkanShader> shader = _context.getShaderManager()->getCurrent(requested.shader);
+		if (shader != requested.shader && shader != _rejectedShader)
+		{
+			//the reloaded shader may read different vertex inputs, if the layout cannot feed them the previous shader stays
+			PipelineState reloaded = requested;
+			reloaded.shader = shader;
+			if (reloaded.setVertexLayout(_context.getVertexLayouts()->get("Vertex")))
+			{
+				//drawn with once its pipeline is ready, until then the current state keeps being used without waiting
+				_pendingState = std::move(reloaded);
+				_context.getPipelineLibrary()->prepare(*_pendingState);
+			}
+			else
+			{
+				CY_BASE_LOG_ERROR("The reloaded {0} shader reads vertex inputs the Vertex layout does not have, the previous version stays in use.", shader->getName());
+				_rejectedShader = shader;
+			}
+		}
+		_context.getPipelineLibrary()->collect();
+		if (_pendingState && _context.getPipelineLibrary()->isReady(*_pendingState))
+		{
+			_pipelineState = std::move(*_pendingState);
+			_pendingState.reset();
+		}
 
 
-		CameraUboData cd{};
 		/*cd.translation = m3d::Mat4f::getTranslation(m3d::Vec4f(camera->pos, 1.0f));
 		cd.view = m3d::Mat4f::getLookAt(camera->pos, { 0.0f, 0.0f, 0.0f }, camera->cUp);
 		cd.proj = camera->projectionMatrix;*/
-		cd.update(camera.get(), _context.getWindowWidth(), _context.getWindowHeight());
-		_cameraUbos[_context.getRenderer()->getCurrentImageIndex()]->setData(&cd, 0);
+		_scene->updateWorldTransforms();
+		_cameraData.update(camera.get(), _context.getWindowWidth(), _context.getWindowHeight());
+		_cameraData.model = _scene->getWorldTransform(_testNode);
+		_cameraUbos[_context.getRenderer()->getCurrentImageIndex()]->setData(&_cameraData, 0);
 		//TESTING ONLY
 		//testUpdateUbos();
 		//END
@@ -41,6 +75,7 @@ namespace cy3d
 
 	void SceneRenderer::endScene()
 	{
+		CY_PROFILE_SCOPE("SceneRenderer::endScene");
 		CY_ASSERT(isSceneStart() == true);
 
 		flush();
@@ -55,7 +90,14 @@ namespace cy3d
 	{
 		uint32_t numImages = static_cast<uint32_t>(_context.getSwapChain()->imageCount());
 
-		_context.getShaderManager()->add("resources/shaders/simpleshaders", "SimpleShader");
+		//every shader the scene needs is compiled up front in one batch, the culler then finds its shader already added
+		_context.getShaderManager()->addBatch({
+			ShaderDirectory{ "resources/shaders/simpleshaders", "SimpleShader" },
+			ShaderDirectory{ "resources/shaders/culling", "Culling" }
+		});
+#ifndef NDEBUG
+		_context.getShaderManager()->enableHotReload();
+#endif
 		const auto& shader = _context.getShaderManager()->get("SimpleShader");
 
 		BufferCreateInfo cameraInfo = shader->getDescriptorSetUBOInfo(0, "CameraUboData").createInfo;
@@ -66,21 +108,13 @@ namespace cy3d
 			_cameraUbos[i].reset(new VulkanBuffer(_context, cameraInfo));
 		}
 		_texture.reset(new VulkanTexture(_context, "resources/textures/viking_room.png"));
-		_descriptorSets.reset(new VulkanDescriptorSets(_context, shader, numImages));
 
+		//the default state is also the fallback for every variant of the shader so it is compiled up front
+		_pipelineState = PipelineState::createDefault(shader, _context.getSwapChain()->getRenderPass(), _context.getVertexLayouts()->get("Vertex"));
+		_context.getPipelineLibrary()->getBlocking(_pipelineState);
 
-		for (std::size_t i = 0; i < numImages; i++)
-		{
-			_descriptorSets->writeBufferToSet(_cameraUbos[i]->descriptorInfo(), i, 0, 0);
-			_descriptorSets->writeImageToSet(_texture->descriptorInfo(), i, 0, 1);
-		}
-		_descriptorSets->updateSets();
-
-		PipelineSpec spec{};
-		spec.width = _context.getWindowWidth();
-		spec.height = _context.getWindowHeight();
-		spec.renderpass = _context.getSwapChain()->getRenderPass();
-		_pipeline.reset(new VulkanPipeline(_context, shader, spec));
+		_drawQueue.reset(new DrawQueue(_context));
+		_scene.reset(new Scene());
 
 		//TESTING ONLY
 		createTestVertices();
@@ -93,11 +127,19 @@ namespace cy3d
 
 	void SceneRenderer::recreate()
 	{
-		PipelineSpec spec{};
-		spec.width = _context.getWindowWidth();
-		spec.height = _context.getWindowHeight();
-		spec.renderpass = _context.getSwapChain()->getRenderPass();
-		_pipeline->recreate(spec);
+		//viewport and scissor are dynamic so the pipelines only have to be rebuilt if the render pass was replaced
+		VkRenderPass renderPass = _context.getSwapChain()->getRenderPass();
+		if (_pipelineState.renderPass != renderPass)
+		{
+			_context.getPipelineLibrary()->retire(_pipelineState.renderPass);
+			_pipelineState.renderPass = renderPass;
+			_context.getPipelineLibrary()->getBlocking(_pipelineState);
+			if (_pendingState)
+			{
+				_pendingState->renderPass = renderPass;
+				_context.getPipelineLibrary()->prepare(*_pendingState);
+			}
+		}
 
 		_context.getRenderer()->resetNeedsResize();
 	}
@@ -105,22 +147,34 @@ namespace cy3d
 	void SceneRenderer::flush()
 	{
 		CY_ASSERT(isSceneStart() == true);
+		//TESTING ONLY
+		testSubmitDraws();
+
+		_drawQueue->sort();
 		basicRenderPass();
-		_meshes.clear();
+		_drawQueue->clear();
 	}
 
 	void SceneRenderer::basicRenderPass()
 	{
 		CY_ASSERT(isSceneStart() == true);
-		_context.getRenderer()->beginRenderPass(_context.getSwapChain()->getRenderPass());
+		VulkanGPUProfiler& profiler = *_context.getRenderer()->getGPUProfiler();
+		VkCommandBuffer primary = _context.getRenderer()->getCurrentCommandBuffer();
 
-		//TESTING ONLY
-		testDraw();
+		{
+			//the culling dispatch has to be recorded outside of the render pass
+			VulkanGPUScope scope(profiler, primary, "Culling");
+			_culler->cull(primary, _cameraData.view, _cameraData.proj);
+		}
 
-		//for (auto& mesh : _meshes)
-		//{
-		//	//TODO draw meshs here.
-		//}
+		//the draws themselves are timed per secondary command buffer by recordParallel
+		VulkanGPUScope scope(profiler, primary, "BasicRenderPass");
+		_context.getRenderer()->beginRenderPass(_context.getSwapChain()->getRenderPass(), VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+		_context.getRenderer()->recordParallel(_drawQueue->size(), [this](VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end)
+		{
+			_drawQueue->record(commandBuffer, begin, end);
+		}, "DrawQueue");
 
 		_context.getRenderer()->endRenderPass();
 	}
@@ -156,6 +210,18 @@ namespace cy3d
 	    BufferCreateInfo indexInfo = BufferCreateInfo::createGPUOnlyBufferInfo(iSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
 		_indexBuffer.reset(new VulkanBuffer(_context, indexInfo, indices.data()));
 
+		//both quads as one object. Their node moves them up by 1 so the sphere center is (0, 1, -0.25).
+		_testNode = _scene->createNode();
+		_scene->setTranslation(_testNode, m3d::vec3f{ 0.0f, 1.0f, 0.0f });
+		_culler.reset(new GPUCuller(_context, 1024));
+		CullObject quads{};
+		quads.sphere[0] = 0.0f;
+		quads.sphere[1] = 1.0f;
+		quads.sphere[2] = -0.25f;
+		quads.sphere[3] = 0.75f;
+		quads.indexCount = static_cast<uint32_t>(indices.size());
+		_culler->addObject(quads);
+
 	}
 
 	void SceneRenderer::testUpdateUbos()
@@ -168,60 +234,28 @@ namespace cy3d
 	}
 
 
-	void SceneRenderer::testDraw()
+	void SceneRenderer::testSubmitDraws()
 	{
 		//FOR Testing only
-
-		VkBuffer vertexBuffers[] = { _vertexBuffer->getBuffer() };
-		VkDeviceSize offsets[] = { 0 };
-
-
-
-		/**
-			* The second parameter specifies if the pipeline object is a graphics or compute pipeline.
-			* We've now told Vulkan which operations to execute in the graphics pipeline and which attachment to use in the fragment shader,
-		*/
-		_pipeline->bind(_context.getRenderer()->getCurrentCommandBuffer());
-		vkCmdBindDescriptorSets(_context.getRenderer()->getCurrentCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, _pipeline->getPipelineLayout(), 0, 1, _descriptorSets->at(_context.getCurrentFrameIndex()).data(), 0, nullptr);
-
-		/**
-			* The vkCmdBindVertexBuffers function is used to bind vertex buffers to bindings, like the
-			* one we set up in the previous chapter. The first two parameters, besides the command buffer,
-			* specify the offset and number of bindings we're going to specify vertex buffers for. The last
-			* two parameters specify the array of vertex buffers to bind and the byte offsets to start reading
-			* vertex data from.
-		*/
-		vkCmdBindVertexBuffers(_context.getRenderer()->getCurrentCommandBuffer(), 0, 1, vertexBuffers, offsets);
-
-
-		/**
-			* Parameters other than the command buffer are the index buffer, a byte offset into it, and the type of index data.
-			* The possible types are VK_INDEX_TYPE_UINT16 and VK_INDEX_TYPE_UINT32.
-		*/
-		//vkCmdBindIndexBuffer(commandBuffers[i], indexBuffer.get()->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT16);
-
-		//Binding with the vertex and index buffers being combined.
-		//vkCmdBindIndexBuffer(_context.getRenderer()->getCurrentCommandBuffer(), _omniBuffer->getBuffer(), _omniBuffer->offset(), VK_INDEX_TYPE_UINT16);
-
-		vkCmdBindIndexBuffer(_context.getRenderer()->getCurrentCommandBuffer(), _indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT16);
-
-		/**
-			* vkCmdDraw has the following parameters, aside from the command buffer:
-			*
-			* vertexCount: Even though we don't have a vertex buffer, we technically still have 3 vertices to draw.
-			* instanceCount: Used for instanced rendering, use 1 if you're not doing that.
-			* firstVertex: Used as an offset into the vertex buffer, defines the lowest value of gl_VertexIndex.
-			* firstInstance: Used as an offset for instanced rendering, defines the lowest value of gl_InstanceIndex.
-		*/
-		//vkCmdDraw(commandBuffers[i], static_cast<uint32_t>(vertexBuffer.get()->size()), 1, 0, 0); 
-
-		vkCmdDrawIndexed(_context.getRenderer()->getCurrentCommandBuffer(), static_cast<uint32_t>(_indexBuffer->count()), 1, 0, 0, 0);
-
-		//vkCmdEndRenderPass(commandBuffers[i]);
-
-		//ASSERT_ERROR(DEFAULT_LOGGABLE, vkEndCommandBuffer(commandBuffers[i]) == VK_SUCCESS, "Failed to record command buffer.");
-
-
+		DrawItem item{};
+		//the fallback is always ready, so a state that is still compiling never makes the render thread wait
+		const PipelineState& requested = _pendingState ? *_pendingState : _pipelineState;
+		VulkanPipeline* pipeline = _context.getPipelineLibrary()->get(requested, _pipelineState);
+		item.pipeline = pipeline->getGraphicsPipeline();
+		item.pipelineLayout = pipeline->getPipelineLayout();
+		//the camera ubo is indexed by the swap chain image it was written for so the set has to be as well.
+		//the layout comes from the pipeline that is bound, until a reloaded shader's pipeline is ready that is the old one
+		item.descriptorSet = _context.getDescriptorSetCache()->get(pipeline->getState().shader->getSharedSetLayouts()[0], {
+			DescriptorBinding::buffer(0, _cameraUbos[_context.getRenderer()->getCurrentImageIndex()]->descriptorInfo()),
+			DescriptorBinding::image(1, _texture->descriptorInfo())
+		});
+		item.vertexBuffers[0] = _vertexBuffer->getBuffer();
+		item.indexBuffer = _indexBuffer->getBuffer();
+		item.indexType = VK_INDEX_TYPE_UINT16;
+
+		//the draw commands are generated by the culling pass
+		_culler->setIndirectDraw(item);
+		_drawQueue->submit(item, 0, 0.0f);
 		//END
 	}
 }
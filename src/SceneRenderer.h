@@ -10,11 +10,12 @@
 #include "core/core.h"
 #include "ShaderManager.h"
 #include "Camera.h"
+#include "GPUCuller.h"
+#include "DrawQueue.h"
+#include "Scene.h"
 
 namespace cy3d
 {
-	struct Mesh {};
-
 	struct CameraUboData
 	{
 		alignas(16) m3d::mat4f model{};
@@ -27,7 +28,6 @@ namespace cy3d
 			static auto startTime = std::chrono::high_resolution_clock::now();
 			auto currentTime = std::chrono::high_resolution_clock::now();
 			float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-			model = m3d::translate(m3d::mat4f(), m3d::vec3f{ 0.0f, 1.0f, 0.0f });
 			view = m3d::lookAt(camera->pos, camera->pos + camera->lookDir, camera->cUp);
 			proj = m3d::perspective(m3d::toRadians(90.0f), width / height, 0.1f, 100.0f);
 			proj[1][1] *= -1;
@@ -38,15 +38,25 @@ namespace cy3d
 	{
 	private:
 		VulkanContext& _context;
-		Scope<VulkanPipeline> _pipeline{ nullptr };
-		Scope<VulkanDescriptorSets> _descriptorSets{ nullptr };
+		//the state drawn with, its pipeline is always ready
+		PipelineState _pipelineState{};
+		//a state that replaces _pipelineState once its pipeline has been compiled in the background
+		std::optional<PipelineState> _pendingState;
+		//the last reloaded shader whose vertex inputs the layout could not satisfy, so it is only reported once
+		Ref<VulkanShader> _rejectedShader{ nullptr };
 		std::vector<Scope<VulkanBuffer>> _cameraUbos;
 		Scope<VulkanTexture> _texture{ nullptr };
 
 		Scope<VulkanBuffer> _vertexBuffer{ nullptr };
 		Scope<VulkanBuffer> _indexBuffer{ nullptr };
-		
-		std::vector<Mesh> _meshes;
+
+		Scope<GPUCuller> _culler{ nullptr };
+		Scope<DrawQueue> _drawQueue{ nullptr };
+		CameraUboData _cameraData{};
+
+		Scope<Scene> _scene{ nullptr };
+		//TESTING ONLY the node the test quads are drawn with
+		NodeId _testNode{ INVALID_NODE };
 		bool _isSceneStart{ false };
 
 	public:
@@ -57,6 +67,7 @@ namespace cy3d
 		void endScene();
 
 		bool isSceneStart() { return _isSceneStart; }
+		Scene* getScene() { return _scene.get(); }
 
 	private:
 		void init();
@@ -70,7 +81,7 @@ namespace cy3d
 
 		void createTestVertices();
 		void testUpdateUbos();
-		void testDraw();
+		void testSubmitDraws();
 	};
 }
 
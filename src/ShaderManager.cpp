@@ -1,5 +1,9 @@
 #include "pch.h"
 #include "ShaderManager.h"
+#include "platform/Vulkan/VulkanDescriptors.h"
+#include "platform/Vulkan/VulkanPipelineLibrary.h"
+#include "core/ThreadPool.h"
+#include "core/Profiler.h"
 
 namespace cy3d
 {
@@ -8,12 +12,81 @@ namespace cy3d
 
 	}
 
+	ShaderManager::~ShaderManager()
+	{
+		//the reload tasks reference the context
+		for (auto& [name, reload] : _reloads)
+		{
+			reload.wait();
+		}
+	}
+
 	bool ShaderManager::add(const std::string& directory, const std::string& name)
 	{
 		_shaders[name] = std::make_shared<VulkanShader>(_context, directory, name);
+		_directories[name] = directory;
+		watch(directory);
+		//new descriptor pools are sized from every shader that has been loaded
+		_context.getDescriptorPoolManager()->recordShader(*_shaders[name]);
 		return true;
 	}
 
+	bool ShaderManager::addBatch(const std::vector<ShaderDirectory>& shaders)
+	{
+		CY_PROFILE_FUNCTION();
+		using StageFuture = std::pair<VkShaderStageFlagBits, std::future<CompiledShaderStage>>;
+
+		//the tasks reference the sources so they must not move until every task has finished
+		std::vector<std::unordered_map<VkShaderStageFlagBits, ShaderData>> sources(shaders.size());
+		std::vector<std::vector<StageFuture>> pending(shaders.size());
+		for (std::size_t i = 0; i < shaders.size(); i++)
+		{
+			if (!VulkanShader::readSourceDirectory(shaders[i].directory, sources[i]))
+			{
+				//an empty source map marks the shader as failed below
+				sources[i].clear();
+				continue;
+			}
+			for (const auto& [stage, shaderData] : sources[i])
+			{
+				VkShaderStageFlagBits taskStage = stage;
+				const ShaderData* taskData = &shaderData;
+				pending[i].emplace_back(stage, _context.getThreadPool()->submit([this, taskStage, taskData]()
+				{
+					CompiledShaderStage compiled;
+					VulkanShader::compileStage(_context, taskStage, *taskData, compiled);
+					return compiled;
+				}));
+			}
+		}
+
+		bool success = true;
+		for (std::size_t i = 0; i < shaders.size(); i++)
+		{
+			CompiledShaderStages stages;
+			bool compiled = true;
+			for (auto& [stage, future] : pending[i])
+			{
+				stages[stage] = future.get();
+				compiled = compiled && !stages[stage].binary.empty();
+			}
+
+			if (!compiled || sources[i].empty())
+			{
+				CY_BASE_LOG_ERROR("Shader {0} failed to compile and was not added.", shaders[i].name);
+				success = false;
+				continue;
+			}
+
+			const std::string& name = shaders[i].name;
+			_shaders[name] = std::make_shared<VulkanShader>(_context, name, std::move(sources[i]), std::move(stages));
+			_directories[name] = shaders[i].directory;
+			watch(shaders[i].directory);
+			_context.getDescriptorPoolManager()->recordShader(*_shaders[name]);
+		}
+		return success;
+	}
+
 	Ref<VulkanShader> ShaderManager::get(const std::string& name)
 	{
 		CY_ASSERT(_shaders.count(name) != 0); //no shader by that name
@@ -25,4 +98,153 @@ namespace cy3d
 		CY_ASSERT(_shaders.count(name) != 0); //no shader by that name
 		return _shaders.at(name);
 	}
+
+	Ref<VulkanShader> ShaderManager::getCurrent(const Ref<VulkanShader>& shader)
+	{
+		return get(shader->getBaseName())->getVariant(shader->getDefines());
+	}
+
+	void ShaderManager::enableHotReload()
+	{
+		if (_watcher != nullptr)
+		{
+			return;
+		}
+
+		_watcher.reset(new FileWatcher());
+		if (std::filesystem::is_directory(SHADER_INCLUDE_DIRECTORY))
+		{
+			_watcher->watch(SHADER_INCLUDE_DIRECTORY);
+		}
+		for (const auto& [name, directory] : _directories)
+		{
+			_watcher->watch(directory);
+		}
+	}
+
+	void ShaderManager::update()
+	{
+		if (_watcher == nullptr)
+		{
+			return;
+		}
+		CY_PROFILE_FUNCTION();
+
+		std::vector<std::string> changed;
+		if (_watcher->poll(changed))
+		{
+			for (const auto& directory : changed)
+			{
+				//every shader may include from the include directory
+				bool everyShader = directory == SHADER_INCLUDE_DIRECTORY;
+				for (const auto& [name, shaderDirectory] : _directories)
+				{
+					if (everyShader || shaderDirectory == directory)
+					{
+						_staleShaders.insert(name);
+					}
+				}
+			}
+		}
+
+		for (auto it = _reloads.begin(); it != _reloads.end();)
+		{
+			if (it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			{
+				++it;
+				continue;
+			}
+			PendingReload reload = it->second.get();
+			finishReload(it->first, reload);
+			it = _reloads.erase(it);
+		}
+
+		//a shader that is already being reloaded waits until that reload is done, its sources may be outdated by now
+		for (auto it = _staleShaders.begin(); it != _staleShaders.end();)
+		{
+			if (_reloads.count(*it) != 0)
+			{
+				++it;
+				continue;
+			}
+			startReload(*it);
+			it = _staleShaders.erase(it);
+		}
+	}
+
+	void ShaderManager::watch(const std::string& directory)
+	{
+		if (_watcher != nullptr)
+		{
+			_watcher->watch(directory);
+		}
+	}
+
+	void ShaderManager::startReload(const std::string& name)
+	{
+		CY_BASE_LOG_INFO("Reloading shader {0}.", name);
+		VulkanContext* context = &_context;
+		std::string directory = _directories.at(name);
+		std::vector<ShaderDefines> variants;
+		for (const auto& [key, variant] : _shaders.at(name)->getVariants())
+		{
+			variants.push_back(variant->getDefines());
+		}
+
+		_reloads[name] = _context.getThreadPool()->submit([context, directory, variants]()
+		{
+			PendingReload reload{};
+			if (!std::filesystem::is_directory(directory) || !VulkanShader::readSourceDirectory(directory, reload.sources))
+			{
+				return reload;
+			}
+			reload.compiled = true;
+			for (const auto& [stage, shaderData] : reload.sources)
+			{
+				CompiledShaderStage& compiled = reload.stages[stage];
+				VulkanShader::compileStage(*context, stage, shaderData, compiled);
+				reload.compiled = reload.compiled && !compiled.binary.empty();
+			}
+			for (const auto& defines : variants)
+			{
+				reload.variants.emplace_back(defines, CompiledShaderStages{});
+				for (const auto& [stage, shaderData] : reload.sources)
+				{
+					CompiledShaderStage& compiled = reload.variants.back().second[stage];
+					VulkanShader::compileStage(*context, stage, shaderData, compiled, defines);
+					reload.compiled = reload.compiled && !compiled.binary.empty();
+				}
+			}
+			return reload;
+		});
+	}
+
+	void ShaderManager::finishReload(const std::string& name, PendingReload& reload)
+	{
+		if (!reload.compiled || reload.sources.empty())
+		{
+			CY_BASE_LOG_ERROR("Shader {0} failed to reload, the previous version stays in use.", name);
+			return;
+		}
+
+		Ref<VulkanShader> shader = std::make_shared<VulkanShader>(_context, name, std::move(reload.sources), std::move(reload.stages));
+		_shaders[name] = shader;
+		_context.getDescriptorPoolManager()->recordShader(*shader);
+		//pipelines whose vertex layout no longer fits keep the previous version, their owners pick the shader up themselves
+		bool pipelinesReloaded = _context.getPipelineLibrary()->reloadShader(shader);
+		for (auto& [defines, stages] : reload.variants)
+		{
+			Ref<VulkanShader> variant = shader->addVariant(defines, std::move(stages));
+			_context.getDescriptorPoolManager()->recordShader(*variant);
+			pipelinesReloaded = _context.getPipelineLibrary()->reloadShader(variant) && pipelinesReloaded;
+		}
+		if (pipelinesReloaded)
+		{
+			CY_BASE_LOG_INFO("Reloaded shader {0}.", name);
+		}
+		else
+		{
+			CY_BASE_LOG_INFO("Reloaded shader {0}, pipelines whose vertex layout does not fit it keep the previous version.", name);
+		}
+	}
 }
@@ -3,19 +3,87 @@
 #include "core/core.h"
 #include "platform/Vulkan/VulkanContext.h"
 #include "platform/Vulkan/VulkanShader.h"
+#include "core/FileWatcher.h"
 
 namespace cy3d
 {
+	struct ShaderDirectory
+	{
+		std::string directory;
+		std::string name;
+	};
+
+	/**
+	 * @brief Owns every shader by name.
+	 *
+	 * With hot reload enabled a shader whose directory changes is recompiled on the thread pool while the old one stays in
+	 * use. update() swaps the new shader in at the frame boundary and hands it to the pipeline library, which rebuilds the
+	 * shader's pipelines in the background and retires the old ones only after the frames in flight are done with them.
+	 * A shader that fails to compile is kept as it was. A change to SHADER_INCLUDE_DIRECTORY reloads every shader. The
+	 * variants of a shader are reloaded together with it.
+	*/
 	class ShaderManager
 	{
 	private:
+		struct PendingReload
+		{
+			std::unordered_map<VkShaderStageFlagBits, ShaderData> sources;
+			CompiledShaderStages stages;
+			//every variant the previous version had is rebuilt with it
+			std::vector<std::pair<ShaderDefines, CompiledShaderStages>> variants;
+			bool compiled{ false };
+		};
+
 		VulkanContext& _context;
 		std::unordered_map<std::string, Ref<VulkanShader>> _shaders;
+		//name -> directory the shader was read from
+		std::unordered_map<std::string, std::string> _directories;
+
+		Scope<FileWatcher> _watcher{ nullptr };
+		//shaders that changed while a reload of them was already running
+		std::unordered_set<std::string> _staleShaders;
+		std::unordered_map<std::string, std::future<PendingReload>> _reloads;
+
 	public:
 		ShaderManager(VulkanContext& context);
+		~ShaderManager();
+
+		CY_NOCOPY(ShaderManager);
+
 		bool add(const std::string& directory, const std::string& name);
+
+		/**
+		 * @brief Adds every shader in shaders. All of their stages are compiled and reflected at the same time on the
+		 * context's thread pool, the shaders' modules are then created on the calling thread once their stages are done.
+		 * Returns false if any stage failed to compile, the shaders that did compile are still added.
+		*/
+		bool addBatch(const std::vector<ShaderDirectory>& shaders);
+		bool has(const std::string& name) const { return _shaders.count(name) != 0; }
 		Ref<VulkanShader> get(const std::string& name);
 		const Ref<VulkanShader> get(const std::string& name) const;
+
+		/**
+		 * @brief The current version of shader or of the variant shader is, which is a different shader once a reload of it
+		 * has been swapped in.
+		*/
+		Ref<VulkanShader> getCurrent(const Ref<VulkanShader>& shader);
+
+		/**
+		 * @brief Starts watching the directories of every shader added so far and of any added later.
+		*/
+		void enableHotReload();
+		bool isHotReloadEnabled() const { return _watcher != nullptr; }
+
+		/**
+		 * @brief Starts reloads for shaders that changed on disk and swaps in the ones that finished. Never waits for a
+		 * compile. Call once per frame before any pipeline is requested.
+		*/
+		void update();
+
+	private:
+		void watch(const std::string& directory);
+		void startReload(const std::string& name);
+		void finishReload(const std::string& name, PendingReload& reload);
 	};
 }
 
@@ -0,0 +1,331 @@
+#pragma once
+#include "pch.h"
+
+#include "platform/Vulkan/Vulkan.h"
+#include "platform/Vulkan/VulkanVertexLayout.h"
+#include "platform/Vulkan/VulkanBuffer.h"
+#include "core/core.h"
+
+namespace cy3d
+{
+	/**
+	 * @brief The source data of a mesh as one tightly packed float stream per attribute. Streams a mesh does not have
+	 * are nullptr.
+	*/
+	struct MeshStreams
+	{
+		std::size_t vertexCount{ 0 };
+		const float* positions{ nullptr };	//xyz
+		const float* normals{ nullptr };	//xyz, unit length
+		const float* tangents{ nullptr };	//xyz and the bitangent sign in w
+		const float* colors{ nullptr };		//rgba
+		const float* texCoords{ nullptr };	//uv
+	};
+
+	/**
+	 * Semantics. Each one names the vertex shader input it feeds, the location it is expected at and the stream of
+	 * MeshStreams it is read from.
+	*/
+	struct Position
+	{
+		static constexpr const char* NAME = "inPosition";
+		static constexpr uint32_t LOCATION = 0;
+		static constexpr uint32_t COMPONENTS = 3;
+		static constexpr const float* MeshStreams::* STREAM = &MeshStreams::positions;
+	};
+
+	struct Color
+	{
+		static constexpr const char* NAME = "inColor";
+		static constexpr uint32_t LOCATION = 1;
+		static constexpr uint32_t COMPONENTS = 4;
+		static constexpr const float* MeshStreams::* STREAM = &MeshStreams::colors;
+	};
+
+	struct TexCoord
+	{
+		static constexpr const char* NAME = "inTexCoord";
+		static constexpr uint32_t LOCATION = 2;
+		static constexpr uint32_t COMPONENTS = 2;
+		static constexpr const float* MeshStreams::* STREAM = &MeshStreams::texCoords;
+	};
+
+	struct Normal
+	{
+		static constexpr const char* NAME = "inNormal";
+		static constexpr uint32_t LOCATION = 3;
+		static constexpr uint32_t COMPONENTS = 3;
+		static constexpr const float* MeshStreams::* STREAM = &MeshStreams::normals;
+	};
+
+	struct Tangent
+	{
+		static constexpr const char* NAME = "inTangent";
+		static constexpr uint32_t LOCATION = 4;
+		static constexpr uint32_t COMPONENTS = 4;
+		static constexpr const float* MeshStreams::* STREAM = &MeshStreams::tangents;
+	};
+
+	namespace detail
+	{
+		/**
+		 * @brief Rounds to the nearest half, flushes results below the smallest normal half to zero and saturates to
+		 * infinity. Written with selects only so loops over it vectorize.
+		*/
+		inline uint16_t floatToHalf(float value)
+		{
+			uint32_t bits = 0;
+			std::memcpy(&bits, &value, sizeof(bits));
+			uint32_t sign = (bits >> 16) & 0x8000u;
+			//adding half of the dropped mantissa rounds, a carry correctly bumps the exponent
+			uint32_t rounded = (bits & 0x7fffffffu) + 0x1000u;
+			int32_t exponent = static_cast<int32_t>(rounded >> 23) - 127 + 15;
+			uint32_t half = (static_cast<uint32_t>(exponent) << 10) | ((rounded >> 13) & 0x3ffu);
+			half = exponent <= 0 ? 0u : half;
+			half = exponent >= 31 ? 0x7c00u : half;
+			return static_cast<uint16_t>(sign | half);
+		}
+
+		inline float roundHalfAway(float value) { return value + (value < 0.0f ? -0.5f : 0.5f); }
+
+		inline int16_t toSNorm16(float value)
+		{
+			return static_cast<int16_t>(roundHalfAway(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+		}
+
+		inline uint8_t toUNorm8(float value)
+		{
+			return static_cast<uint8_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+	}
+
+	/**
+	 * Encodings. Each one reads its first INPUT_COMPONENTS components of a semantic and writes SIZE bytes that are
+	 * fetched as FORMAT.
+	*/
+	template<uint32_t N>
+	struct Float
+	{
+		static_assert(N >= 1 && N <= 4);
+		static constexpr uint32_t INPUT_COMPONENTS = N;
+		static constexpr uint32_t SIZE = N * sizeof(float);
+		static constexpr VkFormat FORMAT = std::array<VkFormat, 4>{ VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT,
+			VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT }[N - 1];
+
+		static void encode(const float* in, uint8_t* out) { std::memcpy(out, in, SIZE); }
+	};
+
+	//three component half formats are rarely supported for vertex fetch
+	template<uint32_t N>
+	struct Half
+	{
+		static_assert(N == 2 || N == 4);
+		static constexpr uint32_t INPUT_COMPONENTS = N;
+		static constexpr uint32_t SIZE = N * sizeof(uint16_t);
+		static constexpr VkFormat FORMAT = N == 2 ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R16G16B16A16_SFLOAT;
+
+		static void encode(const float* in, uint8_t* out)
+		{
+			uint16_t packed[N];
+			for (uint32_t c = 0; c < N; c++) packed[c] = detail::floatToHalf(in[c]);
+			std::memcpy(out, packed, SIZE);
+		}
+	};
+
+	template<uint32_t N>
+	struct SNorm16
+	{
+		static_assert(N == 2 || N == 4);
+		static constexpr uint32_t INPUT_COMPONENTS = N;
+		static constexpr uint32_t SIZE = N * sizeof(int16_t);
+		static constexpr VkFormat FORMAT = N == 2 ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_R16G16B16A16_SNORM;
+
+		static void encode(const float* in, uint8_t* out)
+		{
+			int16_t packed[N];
+			for (uint32_t c = 0; c < N; c++) packed[c] = detail::toSNorm16(in[c]);
+			std::memcpy(out, packed, SIZE);
+		}
+	};
+
+	struct UNorm8x4
+	{
+		static constexpr uint32_t INPUT_COMPONENTS = 4;
+		static constexpr uint32_t SIZE = 4;
+		static constexpr VkFormat FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+		static void encode(const float* in, uint8_t* out)
+		{
+			for (uint32_t c = 0; c < 4; c++) out[c] = detail::toUNorm8(in[c]);
+		}
+	};
+
+	/**
+	 * @brief A unit vector folded onto an octahedron and stored as two snorm16. The shader decodes it with
+	 * n = vec3(e, 1 - |e.x| - |e.y|); if (n.z < 0) n.xy = (1 - abs(n.yx)) * sign(n.xy); normalize(n).
+	*/
+	struct Oct16
+	{
+		static constexpr uint32_t INPUT_COMPONENTS = 3;
+		static constexpr uint32_t SIZE = 2 * sizeof(int16_t);
+		static constexpr VkFormat FORMAT = VK_FORMAT_R16G16_SNORM;
+
+		static void encode(const float* in, uint8_t* out)
+		{
+			float length = std::abs(in[0]) + std::abs(in[1]) + std::abs(in[2]);
+			float scale = length > 0.0f ? 1.0f / length : 0.0f;
+			float x = in[0] * scale;
+			float y = in[1] * scale;
+			//the lower hemisphere is folded over the diagonals
+			float foldedX = (1.0f - std::abs(y)) * std::copysign(1.0f, x);
+			float foldedY = (1.0f - std::abs(x)) * std::copysign(1.0f, y);
+			bool lower = in[2] < 0.0f;
+			int16_t packed[2] = { detail::toSNorm16(lower ? foldedX : x), detail::toSNorm16(lower ? foldedY : y) };
+			std::memcpy(out, packed, SIZE);
+		}
+	};
+
+	template<typename Semantic, typename Encoding>
+	struct Attr
+	{
+		static_assert(Encoding::INPUT_COMPONENTS <= Semantic::COMPONENTS, "the encoding reads more components than the semantic has");
+		using semantic = Semantic;
+		using encoding = Encoding;
+		static constexpr uint32_t SIZE = Encoding::SIZE;
+	};
+
+	/**
+	 * @brief A vertex layout known at compile time. Attributes are packed in the order they are listed without any
+	 * padding, so the stride is the sum of their sizes. Strides, offsets, formats and the Vulkan descriptions are all
+	 * constexpr.
+	 *
+	 * pack converts a whole mesh one attribute at a time. Every attribute gets its own loop whose body is fixed at
+	 * compile time, so nothing is decided per vertex and the compiler is free to vectorize the conversion.
+	 *
+	 * using StaticMeshLayout = VertexLayout<Attr<Position, Float<3>>, Attr<Normal, Oct16>, Attr<TexCoord, Half<2>>>;
+	 * static_assert(StaticMeshLayout::STRIDE == 20);
+	*/
+	template<typename... Attributes>
+	class VertexLayout
+	{
+		static_assert(sizeof...(Attributes) > 0);
+
+	public:
+		static constexpr uint32_t ATTRIBUTE_COUNT = sizeof...(Attributes);
+		static constexpr uint32_t STRIDE = (Attributes::SIZE + ...);
+
+		static constexpr std::array<uint32_t, ATTRIBUTE_COUNT> OFFSETS = []()
+		{
+			std::array<uint32_t, ATTRIBUTE_COUNT> sizes = { Attributes::SIZE... };
+			std::array<uint32_t, ATTRIBUTE_COUNT> offsets{};
+			for (uint32_t i = 1; i < ATTRIBUTE_COUNT; i++)
+			{
+				offsets[i] = offsets[i - 1] + sizes[i - 1];
+			}
+			return offsets;
+		}();
+
+		static constexpr std::array<VkFormat, ATTRIBUTE_COUNT> FORMATS = { Attributes::encoding::FORMAT... };
+
+		//a packed vertex, copy STRIDE bytes per vertex into a vertex buffer
+		struct Packed
+		{
+			uint8_t bytes[STRIDE];
+		};
+		static_assert(sizeof(Packed) == STRIDE);
+
+		template<typename Semantic>
+		static constexpr bool has() { return (std::is_same_v<typename Attributes::semantic, Semantic> || ...); }
+
+		template<typename Semantic>
+		static constexpr uint32_t offset()
+		{
+			static_assert(has<Semantic>(), "the layout has no attribute with this semantic");
+			constexpr std::array<bool, ATTRIBUTE_COUNT> matches = { std::is_same_v<typename Attributes::semantic, Semantic>... };
+			uint32_t index = 0;
+			while (!matches[index]) index++;
+			return OFFSETS[index];
+		}
+
+		static constexpr VkVertexInputBindingDescription bindingDescription(uint32_t binding = 0, VkVertexInputRate inputRate = VK_VERTEX_INPUT_RATE_VERTEX)
+		{
+			return VkVertexInputBindingDescription{ binding, STRIDE, inputRate };
+		}
+
+		static constexpr std::array<VkVertexInputAttributeDescription, ATTRIBUTE_COUNT> attributeDescriptions(uint32_t binding = 0)
+		{
+			std::array<uint32_t, ATTRIBUTE_COUNT> locations = { Attributes::semantic::LOCATION... };
+			std::array<VkVertexInputAttributeDescription, ATTRIBUTE_COUNT> descriptions{};
+			for (uint32_t i = 0; i < ATTRIBUTE_COUNT; i++)
+			{
+				descriptions[i] = VkVertexInputAttributeDescription{ locations[i], binding, FORMATS[i], OFFSETS[i] };
+			}
+			return descriptions;
+		}
+
+		/**
+		 * @brief The layout as a VertexInputLayout, so it can be added to the VulkanVertexLayoutRegistry and resolved
+		 * against the inputs of a shader.
+		*/
+		static VertexInputLayout toInputLayout(uint32_t binding = 0, VkVertexInputRate inputRate = VK_VERTEX_INPUT_RATE_VERTEX)
+		{
+			VertexInputLayout layout{};
+			layout.addBinding(binding, STRIDE, inputRate);
+			uint32_t index = 0;
+			(layout.addAttribute(Attributes::semantic::NAME, Attributes::semantic::LOCATION, binding, Attributes::encoding::FORMAT, OFFSETS[index++]), ...);
+			return layout;
+		}
+
+		/**
+		 * @brief Converts streams.vertexCount vertices into outVertices, which has to hold vertexCount * STRIDE bytes.
+		 * Returns false without writing anything if streams is missing a stream the layout reads.
+		*/
+		static bool pack(const MeshStreams& streams, void* outVertices)
+		{
+			bool complete = ((streams.*(Attributes::semantic::STREAM) != nullptr) && ...);
+			if (!complete)
+			{
+				return false;
+			}
+			packAttributes(streams, static_cast<uint8_t*>(outVertices), std::make_index_sequence<ATTRIBUTE_COUNT>{});
+			return true;
+		}
+
+		static std::vector<Packed> pack(const MeshStreams& streams)
+		{
+			std::vector<Packed> vertices(streams.vertexCount);
+			bool complete = pack(streams, vertices.data());
+			CY_ASSERT(complete); //the mesh is missing a stream the layout reads
+			return vertices;
+		}
+
+	private:
+		template<std::size_t... Indices>
+		static void packAttributes(const MeshStreams& streams, uint8_t* out, std::index_sequence<Indices...>)
+		{
+			(packAttribute<Indices>(streams, out), ...);
+		}
+
+		template<std::size_t Index>
+		static void packAttribute(const MeshStreams& streams, uint8_t* out)
+		{
+			using Attribute = std::tuple_element_t<Index, std::tuple<Attributes...>>;
+			using Semantic = typename Attribute::semantic;
+			using Encoding = typename Attribute::encoding;
+
+			const float* in = streams.*(Semantic::STREAM);
+			uint8_t* dst = out + OFFSETS[Index];
+			for (std::size_t vertex = 0; vertex < streams.vertexCount; vertex++)
+			{
+				Encoding::encode(in + vertex * Semantic::COMPONENTS, dst + vertex * STRIDE);
+			}
+		}
+	};
+
+	//the layout of Vertex, see Vertex::getLayout. The registry builds its "Vertex" layout from it
+	using SimpleVertexLayout = VertexLayout<Attr<Position, Float<3>>, Attr<Color, Float<3>>, Attr<TexCoord, Float<2>>>;
+	static_assert(SimpleVertexLayout::STRIDE == sizeof(Vertex) && SimpleVertexLayout::offset<TexCoord>() == offsetof(Vertex, texCoord));
+	//positions only, for depth and shadow passes
+	using PositionVertexLayout = VertexLayout<Attr<Position, Float<3>>>;
+	using StaticMeshVertexLayout = VertexLayout<Attr<Position, Float<3>>, Attr<Normal, Oct16>, Attr<Tangent, SNorm16<4>>, Attr<TexCoord, Half<2>>>;
+}
@@ -0,0 +1,150 @@
+#include "pch.h"
+#include "FileWatcher.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace cy3d
+{
+#ifdef __linux__
+	FileWatcher::FileWatcher()
+	{
+		_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (_inotify < 0)
+		{
+			CY_BASE_LOG_ERROR("Failed to create an inotify instance, files will not be watched.");
+		}
+	}
+
+	FileWatcher::~FileWatcher()
+	{
+		if (_inotify >= 0)
+		{
+			//closing the instance removes every watch
+			::close(_inotify);
+		}
+	}
+
+	bool FileWatcher::watch(const std::string& directory)
+	{
+		if (_inotify < 0)
+		{
+			return false;
+		}
+
+		//editors save by writing a temporary file and moving it over the original, so moves count as writes
+		int wd = inotify_add_watch(_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+		if (wd < 0)
+		{
+			CY_BASE_LOG_ERROR("Failed to watch {0}.", directory);
+			return false;
+		}
+		//watching a directory twice hands back the same descriptor
+		_watches[wd] = directory;
+		return true;
+	}
+
+	bool FileWatcher::poll(std::vector<std::string>& outChanged)
+	{
+		if (_inotify < 0)
+		{
+			return false;
+		}
+
+		std::size_t firstChanged = outChanged.size();
+		alignas(inotify_event) char buffer[4096];
+		while (true)
+		{
+			ssize_t length = ::read(_inotify, buffer, sizeof(buffer));
+			if (length <= 0)
+			{
+				//EAGAIN once the queue is drained
+				break;
+			}
+
+			for (ssize_t offset = 0; offset < length;)
+			{
+				const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+				offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+				auto found = _watches.find(event->wd);
+				if (found == _watches.end())
+				{
+					continue;
+				}
+				if (std::find(outChanged.begin() + firstChanged, outChanged.end(), found->second) == outChanged.end())
+				{
+					outChanged.push_back(found->second);
+				}
+			}
+		}
+		return outChanged.size() != firstChanged;
+	}
+#else
+	FileWatcher::FileWatcher()
+	{
+
+	}
+
+	FileWatcher::~FileWatcher()
+	{
+
+	}
+
+	bool FileWatcher::watch(const std::string& directory)
+	{
+		if (!std::filesystem::is_directory(directory))
+		{
+			CY_BASE_LOG_ERROR("Failed to watch {0}.", directory);
+			return false;
+		}
+		for (const auto& watched : _directories)
+		{
+			if (watched.directory == directory) return true;
+		}
+
+		WatchedDirectory watched{ directory };
+		scan(directory, watched.writeTimes);
+		_directories.push_back(std::move(watched));
+		return true;
+	}
+
+	bool FileWatcher::poll(std::vector<std::string>& outChanged)
+	{
+		auto now = std::chrono::steady_clock::now();
+		if (now - _lastScan < POLL_INTERVAL)
+		{
+			return false;
+		}
+		_lastScan = now;
+
+		std::size_t firstChanged = outChanged.size();
+		for (auto& watched : _directories)
+		{
+			std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes;
+			scan(watched.directory, writeTimes);
+			if (writeTimes != watched.writeTimes)
+			{
+				outChanged.push_back(watched.directory);
+				watched.writeTimes = std::move(writeTimes);
+			}
+		}
+		return outChanged.size() != firstChanged;
+	}
+
+	void FileWatcher::scan(const std::string& directory, std::unordered_map<std::string, std::filesystem::file_time_type>& outWriteTimes)
+	{
+		std::error_code error;
+		for (const auto& file : std::filesystem::directory_iterator(directory, error))
+		{
+			if (file.is_regular_file(error))
+			{
+				outWriteTimes[file.path().string()] = file.last_write_time(error);
+			}
+		}
+	}
+#endif
+}
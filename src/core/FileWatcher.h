@@ -0,0 +1,57 @@
+#pragma once
+#include "pch.h"
+
+#include "core.h"
+
+namespace cy3d
+{
+	/**
+	 * @brief Reports which watched directories had a file created, written, moved in or deleted since the last poll.
+	 * Directories are watched non recursively.
+	 *
+	 * On Linux the changes come from inotify and poll() only drains the events the kernel has already queued. Everywhere
+	 * else the directories are rescanned for new write times, at most once every POLL_INTERVAL.
+	 *
+	 * Not thread safe, poll from the thread that owns the watcher.
+	*/
+	class FileWatcher
+	{
+	public:
+		static constexpr std::chrono::milliseconds POLL_INTERVAL{ 500 };
+
+	private:
+#ifdef __linux__
+		int _inotify{ -1 };
+		//watch descriptor -> directory
+		std::unordered_map<int, std::string> _watches;
+#else
+		struct WatchedDirectory
+		{
+			std::string directory;
+			std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes;
+		};
+
+		std::vector<WatchedDirectory> _directories;
+		std::chrono::steady_clock::time_point _lastScan{};
+#endif
+
+	public:
+		FileWatcher();
+		~FileWatcher();
+
+		CY_NOCOPY(FileWatcher);
+
+		bool watch(const std::string& directory);
+
+		/**
+		 * @brief Never blocks. Appends every directory that changed to outChanged once, no matter how many of its files
+		 * changed. Returns true if anything was appended.
+		*/
+		bool poll(std::vector<std::string>& outChanged);
+
+#ifndef __linux__
+	private:
+		static void scan(const std::string& directory, std::unordered_map<std::string, std::filesystem::file_time_type>& outWriteTimes);
+#endif
+	};
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "pch.h"
+
+namespace cy3d
+{
+	constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+	constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+	/**
+	 * @brief 64 bit FNV-1a over raw bytes. Fast, stable across runs and platforms, so the hashes can also be written to disk.
+	*/
+	inline uint64_t hashBytes(const void* data, std::size_t size, uint64_t seed = FNV_OFFSET_BASIS)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		uint64_t hash = seed;
+		for (std::size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= FNV_PRIME;
+		}
+		return hash;
+	}
+
+	inline uint64_t hashString(const std::string& str, uint64_t seed = FNV_OFFSET_BASIS)
+	{
+		return hashBytes(str.data(), str.size(), seed);
+	}
+
+	/**
+	 * @brief Hashes the object representation of value. Only use with types without padding,
+	 * otherwise the uninitialized padding bytes end up in the hash.
+	*/
+	template<typename T>
+	inline uint64_t hashValue(const T& value, uint64_t seed = FNV_OFFSET_BASIS)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "hashValue requires a trivially copyable type");
+		return hashBytes(&value, sizeof(T), seed);
+	}
+
+	/**
+	 * @brief Mixes value into seed, boost::hash_combine with the 64 bit golden ratio constant.
+	*/
+	inline uint64_t hashCombine(uint64_t seed, uint64_t value)
+	{
+		return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+	}
+}
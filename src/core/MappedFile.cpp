@@ -0,0 +1,115 @@
+#include "pch.h"
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cy3d
+{
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	/**
+	 * @brief An empty file can not be mapped and is treated as a file that failed to open.
+	*/
+	bool MappedFile::open(const std::string& path)
+	{
+		close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (data == nullptr)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		_file = file;
+		_mapping = mapping;
+		_data = static_cast<const uint8_t*>(data);
+		_size = static_cast<std::size_t>(size.QuadPart);
+#else
+		int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			return false;
+		}
+
+		struct stat info{};
+		if (fstat(file, &info) != 0 || info.st_size == 0)
+		{
+			::close(file);
+			return false;
+		}
+
+		void* data = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		if (data == MAP_FAILED)
+		{
+			::close(file);
+			return false;
+		}
+
+		_file = file;
+		_data = static_cast<const uint8_t*>(data);
+		_size = static_cast<std::size_t>(info.st_size);
+#endif
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (_data == nullptr)
+		{
+			return;
+		}
+
+#ifdef _WIN32
+		UnmapViewOfFile(_data);
+		CloseHandle(static_cast<HANDLE>(_mapping));
+		CloseHandle(static_cast<HANDLE>(_file));
+		_mapping = nullptr;
+		_file = nullptr;
+#else
+		munmap(const_cast<uint8_t*>(_data), _size);
+		::close(_file);
+		_file = -1;
+#endif
+		_data = nullptr;
+		_size = 0;
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "pch.h"
+
+#include "core.h"
+
+namespace cy3d
+{
+	/**
+	 * @brief A read only memory mapping of a whole file. The contents are paged in by the OS as they are touched instead
+	 * of being read up front, so opening a large file costs about the same as opening a small one.
+	 *
+	 * The file should not be replaced while it is mapped, close() it first.
+	*/
+	class MappedFile
+	{
+	private:
+		const uint8_t* _data{ nullptr };
+		std::size_t _size{ 0 };
+#ifdef _WIN32
+		void* _file{ nullptr };
+		void* _mapping{ nullptr };
+#else
+		int _file{ -1 };
+#endif
+
+	public:
+		MappedFile() = default;
+		~MappedFile();
+
+		CY_NOCOPY(MappedFile);
+
+		bool open(const std::string& path);
+		void close();
+
+		bool isOpen() const { return _data != nullptr; }
+		const uint8_t* data() const { return _data; }
+		std::size_t size() const { return _size; }
+	};
+}
@@ -0,0 +1,162 @@
+#include "pch.h"
+#include "Profiler.h"
+
+namespace cy3d
+{
+	static std::atomic<uint64_t> frameNumber{ 0 };
+	static const std::chrono::steady_clock::time_point profilerEpoch = std::chrono::steady_clock::now();
+
+	static void writeEscaped(std::ostream& out, const char* str)
+	{
+		for (; *str != '\0'; str++)
+		{
+			if (*str == '"' || *str == '\\') out << '\\';
+			out << *str;
+		}
+	}
+
+	uint64_t Profiler::now()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - profilerEpoch).count());
+	}
+
+	void Profiler::record(const char* name, uint64_t beginNs, uint64_t endNs)
+	{
+		ThreadBuffer& buffer = threadBuffer();
+		uint64_t index = buffer.writeCount.load(std::memory_order_relaxed);
+		EventSlot& slot = buffer.events[index % EVENTS_PER_THREAD];
+
+		//only this thread writes the slot so the relaxed stores are plain stores, the fences order them for readers
+		slot.sequence.store(index * 2 + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.name.store(name, std::memory_order_relaxed);
+		slot.beginNs.store(beginNs, std::memory_order_relaxed);
+		slot.endNs.store(endNs, std::memory_order_relaxed);
+		slot.frame.store(frameNumber.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		slot.sequence.store(index * 2 + 2, std::memory_order_release);
+
+		buffer.writeCount.store(index + 1, std::memory_order_release);
+	}
+
+	void Profiler::nextFrame()
+	{
+		frameNumber.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	uint64_t Profiler::currentFrame()
+	{
+		return frameNumber.load(std::memory_order_relaxed);
+	}
+
+	void Profiler::setThreadName(const std::string& name)
+	{
+		ThreadBuffer& buffer = threadBuffer();
+		std::lock_guard<std::mutex> lock(registryMutex());
+		buffer.threadName = name;
+	}
+
+	/**
+	 * @brief Events are copied out of each ring buffer first. A copy is only kept if its slot still held the expected
+	 * event before and after the copy, otherwise the writer has overwritten it in the meantime.
+	*/
+	bool Profiler::exportChromeTrace(const std::string& path, uint64_t firstFrame, uint64_t lastFrame)
+	{
+		std::ofstream fout(path, std::ios::out | std::ios::trunc);
+		if (!fout.is_open())
+		{
+			CY_BASE_LOG_ERROR("Failed to open {0} to export the cpu profile.", path);
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(registryMutex());
+		std::vector<ProfileEvent> events;
+		bool first = true;
+		std::size_t exported = 0;
+
+		fout << "{\"traceEvents\":[";
+		for (auto& buffer : registry())
+		{
+			uint64_t end = buffer->writeCount.load(std::memory_order_acquire);
+			uint64_t begin = end > EVENTS_PER_THREAD ? end - EVENTS_PER_THREAD : 0;
+			events.clear();
+			for (uint64_t i = begin; i < end; i++)
+			{
+				const EventSlot& slot = buffer->events[i % EVENTS_PER_THREAD];
+				uint64_t expected = i * 2 + 2;
+				if (slot.sequence.load(std::memory_order_acquire) != expected)
+				{
+					continue;
+				}
+				ProfileEvent event{ slot.name.load(std::memory_order_relaxed), slot.beginNs.load(std::memory_order_relaxed),
+					slot.endNs.load(std::memory_order_relaxed), slot.frame.load(std::memory_order_relaxed) };
+				std::atomic_thread_fence(std::memory_order_acquire);
+				//the writer may have started overwriting the slot while it was copied
+				if (slot.sequence.load(std::memory_order_relaxed) != expected)
+				{
+					continue;
+				}
+				events.push_back(event);
+			}
+
+			if (!first) fout << ",";
+			first = false;
+			fout << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":\"";
+			writeEscaped(fout, buffer->threadName.c_str());
+			fout << "\"}}";
+
+			for (std::size_t i = 0; i < events.size(); i++)
+			{
+				const ProfileEvent& event = events[i];
+				if (event.frame < firstFrame || event.frame > lastFrame)
+				{
+					continue;
+				}
+
+				//complete events, timestamps in microseconds
+				fout << ",{\"name\":\"";
+				writeEscaped(fout, event.name);
+				fout << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->threadId
+					<< ",\"ts\":" << (event.beginNs / 1000) << "." << std::setw(3) << std::setfill('0') << (event.beginNs % 1000)
+					<< ",\"dur\":" << ((event.endNs - event.beginNs) / 1000) << "." << std::setw(3) << std::setfill('0') << ((event.endNs - event.beginNs) % 1000)
+					<< ",\"args\":{\"frame\":" << event.frame << "}}";
+				exported++;
+			}
+		}
+		fout << "],\"displayTimeUnit\":\"ms\"}";
+		fout.close();
+
+		CY_BASE_LOG_INFO("Exported {0} cpu profile events of frames {1} to {2} to {3}", exported, firstFrame, lastFrame, path);
+		return true;
+	}
+
+	Profiler::ThreadBuffer& Profiler::threadBuffer()
+	{
+		thread_local ThreadBuffer* buffer = nullptr;
+		if (buffer == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(registryMutex());
+			auto& buffers = registry();
+			buffers.emplace_back(new ThreadBuffer());
+			buffer = buffers.back().get();
+			buffer->threadId = static_cast<uint32_t>(buffers.size());
+			buffer->threadName = "Thread " + std::to_string(buffer->threadId);
+			buffer->events.reset(new EventSlot[EVENTS_PER_THREAD]);
+		}
+		return *buffer;
+	}
+
+	/**
+	 * @brief Buffers are never freed so the events of threads that have already exited can still be exported.
+	*/
+	std::vector<std::unique_ptr<Profiler::ThreadBuffer>>& Profiler::registry()
+	{
+		static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+		return buffers;
+	}
+
+	std::mutex& Profiler::registryMutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include "pch.h"
+
+#include "core.h"
+
+/**
+ * Profiling is compiled in by default so traces can be taken from production builds. Define CY_DISABLE_PROFILING
+ * to compile every scope out.
+*/
+#ifndef CY_DISABLE_PROFILING
+#define CY_PROFILE_CONCAT_INNER(a, b) a##b
+#define CY_PROFILE_CONCAT(a, b) CY_PROFILE_CONCAT_INNER(a, b)
+//name has to be a string literal or otherwise outlive the profiler
+#define CY_PROFILE_SCOPE(name) ::cy3d::ProfileScope CY_PROFILE_CONCAT(cyProfileScope, __LINE__)(name)
+#define CY_PROFILE_FUNCTION() CY_PROFILE_SCOPE(__FUNCTION__)
+#else
+#define CY_PROFILE_SCOPE(name)
+#define CY_PROFILE_FUNCTION()
+#endif
+
+namespace cy3d
+{
+	struct ProfileEvent
+	{
+		const char* name;
+		uint64_t beginNs;
+		uint64_t endNs;
+		uint64_t frame;
+	};
+
+	/**
+	 * @brief Records scoped cpu events into a ring buffer per thread and exports them in the Chrome trace event format
+	 * (chrome://tracing, Perfetto).
+	 *
+	 * A thread only ever writes to its own buffer, so recording an event is a clock read and a store without any locks.
+	 * The first event of a thread registers its buffer under a mutex. Each buffer keeps the last EVENTS_PER_THREAD events,
+	 * older ones are overwritten.
+	 *
+	 * Events are tagged with the frame that was current when they ended. Frame 0 is everything before the first call to
+	 * nextFrame, i.e. startup.
+	*/
+	class Profiler
+	{
+	public:
+		static constexpr std::size_t EVENTS_PER_THREAD = 1 << 16;
+
+	private:
+		/**
+		 * @brief One ring buffer slot guarded by a sequence lock. sequence is odd while the owning thread writes the
+		 * slot and 2 * (n + 1) once it holds the n-th event of its thread. The fields are atomics so a reader copying
+		 * a slot that is being overwritten gets torn values rather than undefined behaviour, and throws them away
+		 * because the sequence changed.
+		*/
+		struct EventSlot
+		{
+			std::atomic<uint64_t> sequence{ 0 };
+			std::atomic<const char*> name{ nullptr };
+			std::atomic<uint64_t> beginNs{ 0 };
+			std::atomic<uint64_t> endNs{ 0 };
+			std::atomic<uint64_t> frame{ 0 };
+		};
+
+		struct ThreadBuffer
+		{
+			uint32_t threadId{ 0 };
+			//guarded by the registry mutex
+			std::string threadName;
+			std::unique_ptr<EventSlot[]> events;
+			//number of events ever written, published after the event itself is written
+			std::atomic<uint64_t> writeCount{ 0 };
+		};
+
+	public:
+		static void record(const char* name, uint64_t beginNs, uint64_t endNs);
+		static uint64_t now();
+
+		/**
+		 * @brief Starts a new frame. Call once per frame from the thread that drives the frame loop.
+		*/
+		static void nextFrame();
+		static uint64_t currentFrame();
+
+		/**
+		 * @brief Names the calling thread in exported traces.
+		*/
+		static void setThreadName(const std::string& name);
+
+		/**
+		 * @brief Writes every event of the frames [firstFrame, lastFrame] to path as Chrome trace event JSON.
+		 * Safe to call while other threads keep recording, events they overwrite during the export are skipped.
+		*/
+		static bool exportChromeTrace(const std::string& path, uint64_t firstFrame, uint64_t lastFrame);
+
+	private:
+		static ThreadBuffer& threadBuffer();
+		static std::vector<std::unique_ptr<ThreadBuffer>>& registry();
+		static std::mutex& registryMutex();
+	};
+
+	class ProfileScope
+	{
+	private:
+		const char* _name;
+		uint64_t _beginNs;
+
+	public:
+		ProfileScope(const char* name) : _name(name), _beginNs(Profiler::now()) {}
+		~ProfileScope() { Profiler::record(_name, _beginNs, Profiler::now()); }
+
+		CY_NOCOPY(ProfileScope);
+	};
+}
@@ -0,0 +1,55 @@
+#include "pch.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+namespace cy3d
+{
+	ThreadPool::ThreadPool(std::size_t threadCount)
+	{
+		CY_ASSERT(threadCount > 0);
+		_workers.reserve(threadCount);
+		for (std::size_t i = 0; i < threadCount; i++)
+		{
+			_workers.emplace_back([this, i]()
+			{
+				Profiler::setThreadName("Worker " + std::to_string(i));
+				workerLoop();
+			});
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_condition.notify_all();
+
+		for (auto& worker : _workers)
+		{
+			worker.join();
+		}
+	}
+
+	void ThreadPool::workerLoop()
+	{
+		while (true)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_condition.wait(lock, [this]() { return _stop || !_tasks.empty(); });
+
+				//finish whatever is left in the queue before shutting down
+				if (_stop && _tasks.empty())
+				{
+					return;
+				}
+				task = std::move(_tasks.front());
+				_tasks.pop();
+			}
+			task();
+		}
+	}
+}
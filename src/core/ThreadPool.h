@@ -0,0 +1,61 @@
+#pragma once
+#include "pch.h"
+
+#include "core.h"
+
+namespace cy3d
+{
+	/**
+	 * @brief A fixed size pool of worker threads that pulls tasks from a single shared queue.
+	 * Tasks are executed in the order they are submitted but may finish in any order, so callers
+	 * that need a deterministic result should wait on the returned futures in submission order.
+	*/
+	class ThreadPool
+	{
+	private:
+		std::vector<std::thread> _workers;
+		std::queue<std::function<void()>> _tasks;
+		std::mutex _mutex;
+		std::condition_variable _condition;
+		bool _stop{ false };
+
+	public:
+		ThreadPool(std::size_t threadCount = defaultThreadCount());
+		~ThreadPool();
+
+		CY_NOCOPY(ThreadPool);
+
+		/**
+		 * @brief Queues a task to be run by one of the worker threads.
+		 * @return A future that becomes ready once the task has finished executing.
+		*/
+		template<typename F>
+		auto submit(F&& task) -> std::future<decltype(task())>
+		{
+			using return_type = decltype(task());
+			auto packaged = std::make_shared<std::packaged_task<return_type()>>(std::forward<F>(task));
+			std::future<return_type> result = packaged->get_future();
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				CY_ASSERT(_stop == false); //cannot submit tasks to a stopped pool
+				_tasks.emplace([packaged]() { (*packaged)(); });
+			}
+			_condition.notify_one();
+			return result;
+		}
+
+		std::size_t size() const { return _workers.size(); }
+
+		/**
+		 * @brief Leaves one hardware thread for the thread that owns the pool.
+		*/
+		static std::size_t defaultThreadCount()
+		{
+			std::size_t hardwareThreads = static_cast<std::size_t>(std::thread::hardware_concurrency());
+			return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+
+	private:
+		void workerLoop();
+	};
+}
@@ -1,15 +1,24 @@
 #include "pch.h"
 
 #include "FirstApp.h"
+#include "../../core/Profiler.h"
 
 #include <Logi/Logi.h>
 
 namespace cy3d
 {
 
-	FirstApp::FirstApp() 
+	FirstApp::FirstApp(const AppOptions& appOptions) : options(appOptions)
 	{
-		VulkanContext::createDefaultContext(cyContext);
+		Profiler::setThreadName("Main");
+		if (options.headless)
+		{
+			VulkanContext::createHeadlessContext(cyContext, options.width, options.height);
+		}
+		else
+		{
+			VulkanContext::createDefaultContext(cyContext, WindowTraits{ static_cast<int>(options.width), static_cast<int>(options.height), "Hello" });
+		}
 		sceneRenderer.reset(new SceneRenderer(cyContext));
 	}
 
@@ -21,6 +30,11 @@ namespace cy3d
 		float lastFrame = 0.0f;
 
 		camera.reset(Camera::create3D(cyContext, 90.0f, cyContext.getWindowWidth(), cyContext.getWindowHeight(), 0.1f, 100.0f));
+		if (options.headless)
+		{
+			runHeadless();
+			return;
+		}
 
 		//VulkanShader shader(cyContext, "resources/shaders/simpleshaders");
 
@@ -56,7 +70,50 @@ namespace cy3d
 
 
 	}
-}
 
+	/**
+	 * @brief Renders a fixed number of frames into the offscreen images and writes the last one to disk. Used to check
+	 * rendering on machines without a display.
+	*/
+	void FirstApp::runHeadless()
+	{
+		//the readback expects the image to have been rendered to at least once
+		CY_ASSERT(options.frames > 0);
+		for (uint32_t i = 0; i < options.frames; i++)
+		{
+			drawFrame();
+		}
+
+		std::vector<uint8_t> pixels;
+		cyContext.getSwapChain()->readPixels(pixels);
+		vkDeviceWaitIdle(cyContext.getDevice()->device());
 
+		if (!writeCapture(pixels))
+		{
+			throw std::runtime_error("failed to write the headless capture to " + options.capturePath);
+		}
+		CY_BASE_LOG_INFO("Wrote {0} frames, the last one to {1}.", options.frames, options.capturePath);
+	}
+
+	/**
+	 * @brief Writes the RGBA pixels of readPixels as a binary PPM, dropping alpha.
+	*/
+	bool FirstApp::writeCapture(const std::vector<uint8_t>& pixels)
+	{
+		uint32_t width = cyContext.getWindowWidth();
+		uint32_t height = cyContext.getWindowHeight();
+		CY_ASSERT(pixels.size() == static_cast<std::size_t>(width) * height * 4);
 
+		std::ofstream file(options.capturePath, std::ios::binary);
+		if (!file.is_open())
+		{
+			return false;
+		}
+		file << "P6\n" << width << " " << height << "\n255\n";
+		for (std::size_t i = 0; i < pixels.size(); i += 4)
+		{
+			file.write(reinterpret_cast<const char*>(&pixels[i]), 3);
+		}
+		return file.good();
+	}
+}
@@ -15,6 +15,21 @@
 
 namespace cy3d
 {
+	/**
+	 * @brief Set from the command line, see Main.cpp.
+	*/
+	struct AppOptions
+	{
+		//render without a window and write the last frame to capturePath
+		bool headless{ false };
+		uint32_t width{ 800 };
+		uint32_t height{ 600 };
+		uint32_t frames{ 3 };
+		std::string capturePath{ "capture.ppm" };
+		//set by --cull-benchmark, main then only runs FrustumCuller::benchmark on that many objects
+		uint32_t cullBenchmarkObjects{ 0 };
+	};
+
 	class FirstApp
 	{
 	private:
@@ -25,9 +40,10 @@ namespace cy3d
 		VulkanContext cyContext; 
 		std::unique_ptr<SceneRenderer> sceneRenderer;
 		std::shared_ptr<Camera> camera;
+		AppOptions options;
 
 	public:
-		FirstApp();
+		FirstApp(const AppOptions& appOptions = AppOptions{});
 		~FirstApp();
 
 		//delete copy methods
@@ -41,6 +57,8 @@ namespace cy3d
 		void createPipeline();
 		void createCommandBuffers();
 		void drawFrame();
+		void runHeadless();
+		bool writeCapture(const std::vector<uint8_t>& pixels);
 
 		friend class VulkanContext;
 	};
@@ -29,6 +29,11 @@ namespace cy3d
 
 	void VulkanAllocator::createBuffer(BufferCreateInfo& buffInfo, buffer_type& buffer, buffer_memory_type& allocation, offsets_type offsets)
 	{
+		//the info is copied around by value so the family indices are only pointed at here
+		if (buffInfo.bufferInfo.sharingMode == VK_SHARING_MODE_CONCURRENT)
+		{
+			buffInfo.bufferInfo.pQueueFamilyIndices = buffInfo.queueFamilies.data();
+		}
 		VK_CHECK(vmaCreateBuffer(_allocator, &buffInfo.bufferInfo, &buffInfo.allocCreateInfo, &buffer, &allocation, &buffInfo.allocInfo));
 
 		if (offsets.size() > 0)
@@ -74,6 +79,18 @@ namespace cy3d
 		//}
 	}
 
+	void VulkanAllocator::readBuffer(VmaAllocationInfo allocInfo, buffer_memory_type& allocation, VkDeviceSize bufferSize, void* outData)
+	{
+		CY_ASSERT(isCPUVisible(allocInfo) == true);
+
+		void* dataSource;
+		vmaMapMemory(_allocator, allocation, &dataSource);
+		//readback memory is not required to be coherent
+		vmaInvalidateAllocation(_allocator, allocation, 0, bufferSize);
+		memcpy(outData, dataSource, static_cast<std::size_t>(bufferSize));
+		vmaUnmapMemory(_allocator, allocation);
+	}
+
 	void VulkanAllocator::copyBuffer(VkBuffer& srcBuffer, VkBuffer& dstBuffer, VkDeviceSize size)
 	{
 		VkCommandBuffer commandBuffer = cyContext.getDevice()->beginSingleTimeCommands();
@@ -101,6 +118,10 @@ namespace cy3d
 
 	void VulkanAllocator::createImage(image_info_type& imageInfo, image_type& image, image_memory_type& allocation, void* data)
 	{
+		if (imageInfo.imageCreateInfo.sharingMode == VK_SHARING_MODE_CONCURRENT)
+		{
+			imageInfo.imageCreateInfo.pQueueFamilyIndices = imageInfo.queueFamilies.data();
+		}
 		VK_CHECK(vmaCreateImage(_allocator, &imageInfo.imageCreateInfo, &imageInfo.allocCreateInfo, &image, &allocation, &imageInfo.allocInfo));
 	}
 
@@ -126,6 +147,49 @@ namespace cy3d
 		cyContext.getDevice()->endSingleTimeCommands(commandBuffer);
 	}
 
+	/**
+	 * @brief Copies a color image that was rendered to and is in srcLayout into dstBuffer. The image is moved to
+	 * VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL for the copy and left there. Blocks until the copy has finished.
+	*/
+	void VulkanAllocator::copyImageToBuffer(image_type& srcImage, buffer_type& dstBuffer, const image_info_type& imageInfo, VkImageLayout srcLayout)
+	{
+		VkCommandBuffer commandBuffer = cyContext.getDevice()->beginSingleTimeCommands();
+
+		//waits for the color attachment writes of earlier submissions and moves the image into the layout the copy reads
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.oldLayout = srcLayout;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = srcImage;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = 0;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = imageInfo.imageCreateInfo.extent;
+
+		vkCmdCopyImageToBuffer(commandBuffer, srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dstBuffer, 1, &region);
+
+		cyContext.getDevice()->endSingleTimeCommands(commandBuffer);
+	}
+
 	void VulkanAllocator::destroyImage(image_type& image, image_memory_type& allocation)
 	{
 		vmaDestroyImage(_allocator, image, allocation);
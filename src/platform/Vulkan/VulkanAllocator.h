@@ -41,11 +41,13 @@ namespace cy3d
 
 		void createBuffer(BufferCreateInfo& buffInfo, buffer_type& buffer, buffer_memory_type& allocation, offsets_type offsets = {});
 		void fillBuffer(VmaAllocationInfo allocInfo, buffer_memory_type& allocation, VkDeviceSize bufferSize, offsets_type offsets, bool unmap = true);
+		void readBuffer(VmaAllocationInfo allocInfo, buffer_memory_type& allocation, VkDeviceSize bufferSize, void* outData);
 		void copyBuffer(buffer_type& srcBuffer, buffer_type& dstBuffer, VkDeviceSize size);
 		void destroyBuffer(buffer_type& buffer, buffer_memory_type& allocation);
 
 		void createImage(image_info_type& buffInfo, image_type& buffer, image_memory_type& allocation, void* data = nullptr);
 		void copyBufferToImage(buffer_type& srcBuffer, image_type& dstImage, const image_info_type& imageInfo);
+		void copyImageToBuffer(image_type& srcImage, buffer_type& dstBuffer, const image_info_type& imageInfo, VkImageLayout srcLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
 		void destroyImage(image_type& image, image_memory_type& allocation);
 
 		bool isCPUVisible(VmaAllocationInfo allocInfo);
@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "VulkanBuffer.h"
+#include "VulkanDescriptorSetCache.h"
 
 namespace cy3d
 {
@@ -12,6 +13,10 @@ namespace cy3d
 	{
 		if (_buffer != nullptr && _bufferMemory != nullptr)
 		{
+			if (cyContext.hasDescriptorSetCache())
+			{
+				cyContext.getDescriptorSetCache()->invalidate(_buffer);
+			}
 			cyContext.getAllocator()->destroyBuffer(_buffer, _bufferMemory);
 		}
 	}
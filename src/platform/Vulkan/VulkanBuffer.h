@@ -7,6 +7,7 @@
 #include "VulkanDevice.h"
 #include "VulkanContext.h"
 #include "VulkanAllocator.h"
+#include "VulkanVertexLayout.h"
 
 
 namespace cy3d
@@ -15,53 +16,36 @@ namespace cy3d
     struct Vertex {
         m3d::vec3f pos;
         m3d::vec3f color;
-        m3d::vec3f texCoord;
+        m3d::vec2f texCoord;
 
         /**
-         * @brief A vertex binding describes at which rate to load data from memory throughout the vertices.
-         * It specifies the number of bytes between data entries and whether to move to the next data entry after each vertex or after each instance.
-         * @return
+         * @brief The interleaved layout of Vertex in a single buffer at binding 0. The attributes are named after the
+         * inputs of SimpleShader.vert, a shader that reads fewer of them only fetches the ones it reads.
         */
-        static VkVertexInputBindingDescription getBindingDescription()
+        static const VertexInputLayout& getLayout()
         {
-            VkVertexInputBindingDescription bindingDescription{};
-            bindingDescription.binding = 0;
-            bindingDescription.stride = sizeof(Vertex);
-
-            /**
-             * VK_VERTEX_INPUT_RATE_VERTEX: Move to the next data entry after each vertex
-             * VK_VERTEX_INPUT_RATE_INSTANCE: Move to the next data entry after each instance: for instance rendering
-            */
-            bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-            return bindingDescription;
+            static const VertexInputLayout layout = VertexInputLayout{}
+                .addBinding(0, sizeof(Vertex))
+                .addAttribute("inPosition", 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, pos))
+                .addAttribute("inColor", 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color))
+                .addAttribute("inTexCoord", 2, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, texCoord));
+            return layout;
         }
 
-        static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions()
+        /**
+         * @brief Positions tightly packed at binding 0 and the remaining attributes at binding 1. Depth and shadow
+         * passes only read positions, so they only fetch binding 0 and move less than half the bytes per vertex.
+        */
+        static const VertexInputLayout& getSplitLayout()
         {
-            std::vector<VkVertexInputAttributeDescription> attributeDescriptions{ 3 };
-            attributeDescriptions[0].binding = 0; //The binding parameter tells Vulkan from which binding the per-vertex data comes. 
-            attributeDescriptions[0].location = 0; //The location parameter references the location directive of the input in the vertex shader.
-
-            /**
-             * float: VK_FORMAT_R32_SFLOAT
-             * vec2: VK_FORMAT_R32G32_SFLOAT
-             * vec3: VK_FORMAT_R32G32B32_SFLOAT
-             * vec4: VK_FORMAT_R32G32B32A32_SFLOAT
-            */
-            attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT; //The format parameter describes the type of data for the attribute.
-            attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-            attributeDescriptions[1].binding = 0;
-            attributeDescriptions[1].location = 1;
-            attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-            attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-            attributeDescriptions[2].binding = 0;
-            attributeDescriptions[2].location = 2;
-            attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-            attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-
-            return attributeDescriptions;
+            constexpr uint32_t positionSize = sizeof(m3d::vec3f);
+            static const VertexInputLayout layout = VertexInputLayout{}
+                .addBinding(0, positionSize)
+                .addBinding(1, sizeof(Vertex) - positionSize)
+                .addAttribute("inPosition", 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0)
+                .addAttribute("inColor", 1, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color) - positionSize)
+                .addAttribute("inTexCoord", 2, 1, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, texCoord) - positionSize);
+            return layout;
         }
     };
 
@@ -174,6 +158,17 @@ namespace cy3d
             cyContext.getAllocator()->fillBuffer(_bufferInfo.allocInfo, _bufferMemory, _bufferInfo.bufferInfo.size, { {data, _bufferInfo.bufferInfo.size, offset} });
         }
 
+        /**
+         * @brief Copies size bytes of data to offset, leaving the rest of the buffer untouched.
+        */
+        template<typename T>
+        void setData(T* data, VkDeviceSize size, uint32_t offset)
+        {
+            CY_ASSERT(_buffer != nullptr && _bufferMemory != nullptr);
+            CY_ASSERT(offset + size <= _bufferInfo.bufferInfo.size);
+            cyContext.getAllocator()->fillBuffer(_bufferInfo.allocInfo, _bufferMemory, _bufferInfo.bufferInfo.size, { {data, size, offset} });
+        }
+
         VkDescriptorBufferInfo descriptorInfo(VkDeviceSize buffSize = VK_WHOLE_SIZE, uint32_t offset = 0)
         {
             VkDescriptorBufferInfo bufferInfo{};
@@ -22,6 +22,23 @@ namespace cy3d
 		ImageInfo imageInfo{};
 		VmaAllocationCreateInfo allocCreateInfo{};
 		VmaAllocationInfo allocInfo{};
+		//the families of a concurrent image. imageCreateInfo.pQueueFamilyIndices is pointed at it when the image is created
+		std::array<uint32_t, 2> queueFamilies{};
+
+		/**
+		 * @brief Lets the image be used by both queue families without ownership transfers, for images shared between
+		 * the graphics queue and the async compute queue. Does nothing if both families are the same.
+		*/
+		void setConcurrent(uint32_t familyA, uint32_t familyB)
+		{
+			if (familyA == familyB)
+			{
+				return;
+			}
+			queueFamilies = { familyA, familyB };
+			imageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			imageCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+		}
 
 		static ImageCreateInfo createDefaultImageInfo(ImageInfo info)
 		{
@@ -59,6 +76,23 @@ namespace cy3d
 		VmaAllocationCreateInfo allocCreateInfo{};
 		VmaAllocationInfo allocInfo{};
 		bool needStagingBuffer{ false };
+		//the families of a concurrent buffer. bufferInfo.pQueueFamilyIndices is pointed at it when the buffer is created
+		std::array<uint32_t, 2> queueFamilies{};
+
+		/**
+		 * @brief Lets the buffer be used by both queue families without ownership transfers, for buffers shared between
+		 * the graphics queue and the async compute queue. Does nothing if both families are the same.
+		*/
+		void setConcurrent(uint32_t familyA, uint32_t familyB)
+		{
+			if (familyA == familyB)
+			{
+				return;
+			}
+			queueFamilies = { familyA, familyB };
+			bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+		}
 
 		/*
 		* Possible Usage bits:
@@ -153,6 +187,19 @@ namespace cy3d
 			return buffInfo;
 		}
 
+		/**
+		 * @brief Specify a host visible buffer that the GPU copies into and the CPU reads back from.
+		*/
+		static BufferCreateInfo createReadbackBufferInfo(VkDeviceSize bufferSize)
+		{
+
+			BufferCreateInfo buffInfo = createBufferInfo(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+			buffInfo.allocCreateInfo.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+			buffInfo.allocCreateInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+			return buffInfo;
+		}
+
 		static BufferCreateInfo createBufferInfo(VkDeviceSize bufferSize, VkBufferUsageFlags usage)
 		{
 			VkBufferCreateInfo info{};
@@ -0,0 +1,64 @@
+#include "pch.h"
+
+#include "VulkanCommandPool.h"
+#include "VulkanDevice.h"
+
+namespace cy3d
+{
+    VulkanCommandPool::VulkanCommandPool(VulkanContext& context, uint32_t queueFamilyIndex) : _context(context)
+    {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = queueFamilyIndex;
+
+        /**
+         * No VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT because the buffers are only ever reset
+         * together through vkResetCommandPool.
+        */
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+        VK_CHECK(vkCreateCommandPool(_context.getDevice()->device(), &poolInfo, nullptr, &_pool));
+    }
+
+    VulkanCommandPool::~VulkanCommandPool()
+    {
+        //destroying the pool frees every command buffer allocated from it
+        vkDestroyCommandPool(_context.getDevice()->device(), _pool, nullptr);
+    }
+
+    /**
+     * @brief Returns the next unused command buffer of the given level. A new buffer is only allocated
+     * when every buffer of that level has already been handed out since the last reset.
+    */
+    VkCommandBuffer VulkanCommandPool::allocate(VkCommandBufferLevel level)
+    {
+        bool isPrimary = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        std::vector<VkCommandBuffer>& buffers = isPrimary ? _primaryBuffers : _secondaryBuffers;
+        uint32_t& used = isPrimary ? _usedPrimary : _usedSecondary;
+
+        if (used == buffers.size())
+        {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = level;
+            allocInfo.commandPool = _pool;
+            allocInfo.commandBufferCount = 1;
+
+            VkCommandBuffer commandBuffer;
+            VK_CHECK(vkAllocateCommandBuffers(_context.getDevice()->device(), &allocInfo, &commandBuffer));
+            buffers.push_back(commandBuffer);
+        }
+        return buffers[used++];
+    }
+
+    /**
+     * @brief Resets every command buffer allocated from the pool back to the initial state. The caller must make sure
+     * none of the buffers are still pending execution, normally by waiting on the fence of the frame that submitted them.
+    */
+    void VulkanCommandPool::reset()
+    {
+        VK_CHECK(vkResetCommandPool(_context.getDevice()->device(), _pool, 0));
+        _usedPrimary = 0;
+        _usedSecondary = 0;
+    }
+}
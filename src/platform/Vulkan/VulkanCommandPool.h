@@ -0,0 +1,41 @@
+#pragma once
+#include "pch.h"
+
+#include "Vulkan.h"
+#include "VulkanContext.h"
+#include "Fwd.hpp"
+
+namespace cy3d
+{
+	/**
+	 * @brief A command pool whose command buffers all live for exactly one frame. Buffers are handed out linearly and
+	 * are never reset individually, instead the whole pool is reset at once after the fence of its frame has signaled.
+	 * Resetting the pool in bulk is cheaper than resetting each buffer and lets the driver recycle the pool's memory.
+	 *
+	 * Command pools are externally synchronized, so a pool must only be used by one thread at a time.
+	*/
+	class VulkanCommandPool
+	{
+	private:
+		VulkanContext& _context;
+		VkCommandPool _pool{ VK_NULL_HANDLE };
+
+		std::vector<VkCommandBuffer> _primaryBuffers;
+		std::vector<VkCommandBuffer> _secondaryBuffers;
+
+		//the number of buffers of each level that have been handed out since the last reset
+		uint32_t _usedPrimary{ 0 };
+		uint32_t _usedSecondary{ 0 };
+
+	public:
+		VulkanCommandPool(VulkanContext& context, uint32_t queueFamilyIndex);
+		~VulkanCommandPool();
+
+		CY_NOCOPY(VulkanCommandPool);
+
+		VkCommandBuffer allocate(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+		void reset();
+
+		VkCommandPool getPool() { return _pool; }
+	};
+}
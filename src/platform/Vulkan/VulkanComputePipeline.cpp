@@ -0,0 +1,83 @@
+#include "pch.h"
+
+#include "VulkanComputePipeline.h"
+#include "VulkanPipelineCache.h"
+#include "VulkanContext.h"
+#include "VulkanDevice.h"
+#include "VulkanDescriptors.h"
+
+namespace cy3d
+{
+    VulkanComputePipeline::VulkanComputePipeline(VulkanContext& context, const Ref<VulkanShader>& shader, const std::vector<SpecializationConstant>& specializationConstants)
+        : _context(context), _shader(shader), _specializationConstants(specializationConstants)
+    {
+        CY_ASSERT(_shader != nullptr);
+        CY_ASSERT(_shader->isCompute()); //compute pipelines are built from a shader with a .comp stage
+        const auto& stages = _shader->getPipelineCreateInfo();
+        CY_ASSERT(stages.size() == 1 && stages[0].stage == VK_SHADER_STAGE_COMPUTE_BIT);
+
+        _pipelineLayout = _shader->getPipelineLayout();
+        CY_ASSERT(_pipelineLayout != nullptr);
+
+        std::sort(_specializationConstants.begin(), _specializationConstants.end(), [](const auto& a, const auto& b) { return a.id < b.id; });
+        SpecializationData specialization(_specializationConstants);
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage = stages[0];
+        pipelineInfo.stage.pSpecializationInfo = specialization.get();
+        pipelineInfo.layout = _pipelineLayout->getLayout();
+        VK_CHECK(vkCreateComputePipelines(_context.getDevice()->device(), _context.getPipelineCache()->get(), 1, &pipelineInfo, nullptr, &_pipeline));
+    }
+
+    VulkanComputePipeline::~VulkanComputePipeline()
+    {
+        //the shader module belongs to the shader and the layout is shared
+        if (_pipeline != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(_context.getDevice()->device(), _pipeline, nullptr);
+        }
+    }
+
+    void VulkanComputePipeline::bind(VkCommandBuffer commandBuffer)
+    {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+    }
+
+    void VulkanComputePipeline::bindDescriptorSets(VkCommandBuffer commandBuffer, const std::vector<VkDescriptorSet>& sets, uint32_t firstSet)
+    {
+        if (sets.empty())
+        {
+            return;
+        }
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout->getLayout(), firstSet,
+            static_cast<uint32_t>(sets.size()), sets.data(), 0, nullptr);
+    }
+
+    void VulkanComputePipeline::pushConstants(VkCommandBuffer commandBuffer, const void* data, uint32_t size, uint32_t offset)
+    {
+        CY_ASSERT(!_shader->getPushConstantRanges().empty()); //the shader declares no push constant block
+        vkCmdPushConstants(commandBuffer, _pipelineLayout->getLayout(), VK_SHADER_STAGE_COMPUTE_BIT, offset, size, data);
+    }
+
+    void VulkanComputePipeline::dispatch(VkCommandBuffer commandBuffer, uint32_t x, uint32_t y, uint32_t z)
+    {
+        if (x == 0 || y == 0 || z == 0)
+        {
+            return;
+        }
+        vkCmdDispatch(commandBuffer, x, y, z);
+    }
+
+    void VulkanComputePipeline::dispatchIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset)
+    {
+        vkCmdDispatchIndirect(commandBuffer, buffer, offset);
+    }
+
+    uint32_t VulkanComputePipeline::groupCount(uint32_t invocations, uint32_t axis) const
+    {
+        CY_ASSERT(axis < 3);
+        uint32_t size = getWorkgroupSize()[axis];
+        return (invocations + size - 1) / size;
+    }
+}
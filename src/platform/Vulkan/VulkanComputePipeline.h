@@ -0,0 +1,59 @@
+#pragma once
+#include "pch.h"
+
+#include "Vulkan.h"
+#include "VulkanShader.h"
+#include "VulkanPipeline.h"
+#include "../../core/core.h"
+#include "Fwd.hpp"
+
+namespace cy3d
+{
+	/**
+	 * @brief A compute pipeline built from a shader with a single .comp stage. The pipeline layout is the shader's, so
+	 * descriptor sets allocated for the shader can be bound to it directly.
+	 *
+	 * The workgroup size is reflected from the shader, groupCount turns a number of invocations into the number of
+	 * workgroups that covers them.
+	*/
+	class VulkanComputePipeline
+	{
+	private:
+		VulkanContext& _context;
+		Ref<VulkanShader> _shader{ nullptr };
+		//held here as well so the layout outlives the shader while the pipeline is still waiting to be destroyed
+		Ref<VulkanPipelineLayout> _pipelineLayout{ nullptr };
+		VkPipeline _pipeline{ VK_NULL_HANDLE };
+		//sorted by id
+		std::vector<SpecializationConstant> _specializationConstants;
+
+	public:
+		VulkanComputePipeline(VulkanContext& context, const Ref<VulkanShader>& shader, const std::vector<SpecializationConstant>& specializationConstants = {});
+		~VulkanComputePipeline();
+
+		CY_NOCOPY(VulkanComputePipeline);
+
+		void bind(VkCommandBuffer commandBuffer);
+		void bindDescriptorSets(VkCommandBuffer commandBuffer, const std::vector<VkDescriptorSet>& sets, uint32_t firstSet = 0);
+		void pushConstants(VkCommandBuffer commandBuffer, const void* data, uint32_t size, uint32_t offset = 0);
+		/**
+		 * @brief Records a dispatch of x * y * z workgroups. The pipeline and its descriptor sets have to be bound.
+		*/
+		void dispatch(VkCommandBuffer commandBuffer, uint32_t x, uint32_t y = 1, uint32_t z = 1);
+		/**
+		 * @brief Records a dispatch whose workgroup counts are read from a VkDispatchIndirectCommand in buffer.
+		*/
+		void dispatchIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset = 0);
+
+		/**
+		 * @brief The number of workgroups along axis needed to run at least invocations invocations.
+		*/
+		uint32_t groupCount(uint32_t invocations, uint32_t axis = 0) const;
+
+		VkPipeline getPipeline() { return _pipeline; }
+		VkPipelineLayout getPipelineLayout() { return _pipelineLayout->getLayout(); }
+		const Ref<VulkanShader>& getShader() const { return _shader; }
+		const std::array<uint32_t, 3>& getWorkgroupSize() const { return _shader->getWorkgroupSize(); }
+		const std::vector<SpecializationConstant>& getSpecializationConstants() const { return _specializationConstants; }
+	};
+}
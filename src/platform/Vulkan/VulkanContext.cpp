@@ -8,12 +8,24 @@
 #include "VulkanSwapChain.h"
 #include "VulkanRenderer.h"
 #include "VulkanDescriptors.h"
+#include "VulkanPipelineCache.h"
+#include "VulkanPipelineLibrary.h"
+#include "VulkanDeletionQueue.h"
+#include "VulkanDescriptorSetCache.h"
+#include "VulkanLayoutCache.h"
+#include "VulkanShaderArchive.h"
+#include "VulkanShaderOptimizer.h"
+#include "VulkanVertexLayout.h"
 #include "../../src/ShaderManager.h"
+#include "../../core/ThreadPool.h"
 
 
 
 namespace cy3d
 {
+	VulkanContext::VulkanContext() = default;
+	VulkanContext::~VulkanContext() = default;
+
 	std::size_t& VulkanContext::getCurrentFrameIndex()
 	{
 		return currentFrameIndex;
@@ -55,6 +67,12 @@ namespace cy3d
 		return vulkanAllocator.get();
 	}
 
+	VulkanDeletionQueue* VulkanContext::getDeletionQueue()
+	{
+		CY_ASSERT(deletionQueue.get() != nullptr);
+		return deletionQueue.get();
+	}
+
 	VulkanSwapChain* VulkanContext::getSwapChain()
 	{
 		CY_ASSERT(cySwapChain.get() != nullptr);
@@ -67,30 +85,117 @@ namespace cy3d
 		return vulkanRenderer.get();
 	}
 
+	VulkanPipelineCache* VulkanContext::getPipelineCache()
+	{
+		CY_ASSERT(pipelineCache.get() != nullptr);
+		return pipelineCache.get();
+	}
+
+	VulkanShaderArchive* VulkanContext::getShaderArchive()
+	{
+		CY_ASSERT(shaderArchive.get() != nullptr);
+		return shaderArchive.get();
+	}
+
+	VulkanShaderOptimizer* VulkanContext::getShaderOptimizer()
+	{
+		CY_ASSERT(shaderOptimizer.get() != nullptr);
+		return shaderOptimizer.get();
+	}
+
 	Ref<VulkanDescriptorPoolManager> VulkanContext::getDescriptorPoolManager()
 	{
 		CY_ASSERT(descriptorPoolManager.get() != nullptr);
 		return descriptorPoolManager;
 	}
 
+	Ref<VulkanFrameDescriptorAllocator> VulkanContext::getFrameDescriptorAllocator()
+	{
+		CY_ASSERT(frameDescriptorAllocator.get() != nullptr);
+		return frameDescriptorAllocator;
+	}
+
+	Ref<VulkanDescriptorSetCache> VulkanContext::getDescriptorSetCache()
+	{
+		CY_ASSERT(descriptorSetCache.get() != nullptr);
+		return descriptorSetCache;
+	}
+
+	Ref<VulkanLayoutCache> VulkanContext::getLayoutCache()
+	{
+		CY_ASSERT(layoutCache.get() != nullptr);
+		return layoutCache;
+	}
+
+	Ref<VulkanVertexLayoutRegistry> VulkanContext::getVertexLayouts()
+	{
+		CY_ASSERT(vertexLayouts.get() != nullptr);
+		return vertexLayouts;
+	}
+
 	Ref<ShaderManager> VulkanContext::getShaderManager()
 	{
 		CY_ASSERT(shaderManager.get() != nullptr);
 		return shaderManager;
 	}
 
+	Ref<VulkanPipelineLibrary> VulkanContext::getPipelineLibrary()
+	{
+		CY_ASSERT(pipelineLibrary.get() != nullptr);
+		return pipelineLibrary;
+	}
+
+	Ref<ThreadPool> VulkanContext::getThreadPool()
+	{
+		CY_ASSERT(threadPool.get() != nullptr);
+		return threadPool;
+	}
+
 	/**
 	 * PUBLIC STATIC METHODS
 	*/
 	void VulkanContext::createDefaultContext(VulkanContext& emptyContext, WindowTraits wts)
 	{
+		emptyContext.threadPool.reset(new ThreadPool());
 		emptyContext.cyWindow.reset(new VulkanWindow(wts));
 		emptyContext.cyDevice.reset(new VulkanDevice(emptyContext));
+		emptyContext.pipelineCache.reset(new VulkanPipelineCache(emptyContext));
 		emptyContext.vulkanAllocator.reset(new VulkanAllocator(emptyContext));
+		emptyContext.deletionQueue.reset(new VulkanDeletionQueue(VulkanSwapChain::MAX_FRAMES_IN_FLIGHT));
 		emptyContext.cySwapChain.reset(new VulkanSwapChain(emptyContext));
-		emptyContext.vulkanRenderer.reset(new VulkanRenderer(emptyContext));
+		createManagers(emptyContext);
+	}
 
-		emptyContext.descriptorPoolManager.reset(new VulkanDescriptorPoolManager(emptyContext));
-		emptyContext.shaderManager.reset(new ShaderManager(emptyContext));
+	/**
+	 * @brief Creates a context without a window, surface or present queue for rendering on machines without a display.
+	 * Frames are rendered into width x height offscreen images.
+	*/
+	void VulkanContext::createHeadlessContext(VulkanContext& emptyContext, uint32_t width, uint32_t height)
+	{
+		emptyContext.threadPool.reset(new ThreadPool());
+		emptyContext.cyDevice.reset(new VulkanDevice(emptyContext));
+		emptyContext.pipelineCache.reset(new VulkanPipelineCache(emptyContext));
+		emptyContext.vulkanAllocator.reset(new VulkanAllocator(emptyContext));
+		emptyContext.deletionQueue.reset(new VulkanDeletionQueue(VulkanSwapChain::MAX_FRAMES_IN_FLIGHT));
+		emptyContext.cySwapChain.reset(new VulkanSwapChain(emptyContext, VkExtent2D{ width, height }));
+		createManagers(emptyContext);
+	}
+
+	/**
+	 * PRIVATE STATIC METHODS
+	*/
+	void VulkanContext::createManagers(VulkanContext& context)
+	{
+		context.vulkanRenderer.reset(new VulkanRenderer(context));
+
+		context.descriptorPoolManager.reset(new VulkanDescriptorPoolManager(context));
+		context.frameDescriptorAllocator.reset(new VulkanFrameDescriptorAllocator(context));
+		context.descriptorSetCache.reset(new VulkanDescriptorSetCache(context));
+		context.layoutCache.reset(new VulkanLayoutCache(context));
+		context.shaderArchive.reset(new VulkanShaderArchive());
+		context.shaderOptimizer.reset(new VulkanShaderOptimizer());
+		context.vertexLayouts.reset(new VulkanVertexLayoutRegistry());
+		context.shaderManager.reset(new ShaderManager(context));
+		context.pipelineLibrary.reset(new VulkanPipelineLibrary(context));
 	}
 }
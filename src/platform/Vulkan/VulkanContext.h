@@ -13,6 +13,9 @@ namespace cy3d
 	 * @brief Is responsible for creating unique instances of cyWindow, cyDevice, and cySwapChain. Cannot be
 	 * copied, assigned, or moved. Is not a singleton class. Multiple context objects can be created but they will all
 	 * have their own unique cyWindow, cyDevice, and cySwapChain.
+	 *
+	 * A headless context has no cyWindow. Its device is created without a surface or the swap chain extension and
+	 * cySwapChain renders into offscreen images that can be read back with VulkanSwapChain::readPixels.
 	*/
 	class VulkanContext
 	{
@@ -20,14 +23,31 @@ namespace cy3d
 		std::size_t currentFrameIndex{ 0 };
 		std::unique_ptr<VulkanWindow> cyWindow{ nullptr };
 		std::unique_ptr<VulkanDevice> cyDevice{ nullptr };
+		//declared after the device so it is saved and destroyed while the device still exists
+		std::unique_ptr<VulkanPipelineCache> pipelineCache{ nullptr };
 		std::unique_ptr<VulkanAllocator> vulkanAllocator{ nullptr };
+		//declared after the allocator so deferred images and buffers are destroyed while it still exists
+		std::unique_ptr<VulkanDeletionQueue> deletionQueue{ nullptr };
 		std::unique_ptr<VulkanSwapChain> cySwapChain{ nullptr };
 		std::unique_ptr<VulkanRenderer> vulkanRenderer{ nullptr };
 		Ref<VulkanDescriptorPoolManager> descriptorPoolManager{ nullptr };
+		Ref<VulkanFrameDescriptorAllocator> frameDescriptorAllocator{ nullptr };
+		Ref<VulkanLayoutCache> layoutCache{ nullptr };
+		//declared after the pool manager so the cached sets are dropped before their pools are destroyed
+		Ref<VulkanDescriptorSetCache> descriptorSetCache{ nullptr };
+		//declared before the shader manager so binaries compiled by its shaders are still saved on destruction
+		std::unique_ptr<VulkanShaderArchive> shaderArchive{ nullptr };
+		std::unique_ptr<VulkanShaderOptimizer> shaderOptimizer{ nullptr };
+		Ref<VulkanVertexLayoutRegistry> vertexLayouts{ nullptr };
 		Ref<ShaderManager> shaderManager{ nullptr };
+		//declared after the shader manager so its pipelines are destroyed before the shaders they were built from
+		Ref<VulkanPipelineLibrary> pipelineLibrary{ nullptr };
+		Ref<ThreadPool> threadPool{ nullptr };
 
 	public:
-		VulkanContext() = default;
+		//defined where every member type is complete
+		VulkanContext();
+		~VulkanContext();
 
 		//no copy assignment, move, or constructor
 		VulkanContext(const VulkanContext&) = delete;
@@ -40,18 +60,35 @@ namespace cy3d
 		uint32_t getWindowHeight();
 		auto getWindowExtent();
 		VulkanWindow* getWindow();
+		bool isHeadless() { return cyWindow == nullptr; }
 		VulkanDevice* getDevice();
 		VulkanAllocator* getAllocator();
+		VulkanDeletionQueue* getDeletionQueue();
 		VulkanSwapChain* getSwapChain();
 		VulkanRenderer* getRenderer();
+		VulkanPipelineCache* getPipelineCache();
+		VulkanShaderArchive* getShaderArchive();
+		VulkanShaderOptimizer* getShaderOptimizer();
 
 		Ref<VulkanDescriptorPoolManager> getDescriptorPoolManager();
+		Ref<VulkanFrameDescriptorAllocator> getFrameDescriptorAllocator();
+		Ref<VulkanDescriptorSetCache> getDescriptorSetCache();
+		//false while the context is being destroyed, resources destroyed after the cache have no sets to invalidate
+		bool hasDescriptorSetCache() const { return descriptorSetCache != nullptr; }
+		Ref<VulkanLayoutCache> getLayoutCache();
+		Ref<VulkanVertexLayoutRegistry> getVertexLayouts();
 		Ref<ShaderManager> getShaderManager();
+		Ref<VulkanPipelineLibrary> getPipelineLibrary();
+		Ref<ThreadPool> getThreadPool();
 
 		/**
 		 * PUBLIC STATIC METHODS
 		*/
 		static void createDefaultContext(VulkanContext& emptyContext, WindowTraits wts = WindowTraits{ 800, 600, "Hello" });
+		static void createHeadlessContext(VulkanContext& emptyContext, uint32_t width, uint32_t height);
+
+	private:
+		static void createManagers(VulkanContext& context);
 	};
 }
 
@@ -0,0 +1,68 @@
+#pragma once
+#include "pch.h"
+
+#include "Vulkan.h"
+#include "../../core/core.h"
+
+namespace cy3d
+{
+	/**
+	 * @brief Defers the destruction of gpu objects until every frame that could still be using them has finished,
+	 * so objects can be replaced without waiting for the device to go idle.
+	 *
+	 * Each deleter is tagged with the frame that was being recorded when it was pushed. nextFrame() is called by the
+	 * renderer once the fence of the frame slot it is about to reuse has signaled, at which point the frame submitted
+	 * framesInFlight frames earlier and everything submitted before it has completed.
+	*/
+	class VulkanDeletionQueue
+	{
+	private:
+		struct Deleter
+		{
+			uint64_t frame;
+			std::function<void()> destroy;
+		};
+
+		std::deque<Deleter> _deleters;
+		uint64_t _frameNumber{ 0 };
+		uint64_t _framesInFlight;
+
+	public:
+		VulkanDeletionQueue(uint64_t framesInFlight) : _framesInFlight(framesInFlight) {}
+
+		/**
+		 * @brief Runs every pending deleter. The device has to be idle, normally this only happens at shutdown.
+		*/
+		~VulkanDeletionQueue() { flush(); }
+
+		CY_NOCOPY(VulkanDeletionQueue);
+
+		void push(std::function<void()> destroy)
+		{
+			_deleters.push_back(Deleter{ _frameNumber, std::move(destroy) });
+		}
+
+		void nextFrame()
+		{
+			_frameNumber++;
+			while (!_deleters.empty() && _deleters.front().frame + _framesInFlight <= _frameNumber)
+			{
+				_deleters.front().destroy();
+				_deleters.pop_front();
+			}
+		}
+
+		void flush()
+		{
+			//a deleter may push another one, destroying a buffer retires the descriptor sets that reference it
+			while (!_deleters.empty())
+			{
+				Deleter deleter = std::move(_deleters.front());
+				_deleters.pop_front();
+				deleter.destroy();
+			}
+		}
+
+		uint64_t frameNumber() const { return _frameNumber; }
+	};
+}
@@ -0,0 +1,239 @@
+#include "pch.h"
+
+#include "VulkanDescriptorSetCache.h"
+#include "VulkanDescriptors.h"
+#include "VulkanDevice.h"
+#include "VulkanSwapChain.h"
+#include "VulkanDeletionQueue.h"
+#include "../../core/Hash.h"
+
+namespace cy3d
+{
+    static_assert(VulkanDescriptorSetCache::MAX_UNUSED_FRAMES > VulkanSwapChain::MAX_FRAMES_IN_FLIGHT, "evicted descriptor sets could still be in use");
+
+    bool DescriptorBinding::isImage() const
+    {
+        return type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+            || type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE
+            || type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+            || type == VK_DESCRIPTOR_TYPE_SAMPLER
+            || type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    }
+
+    bool DescriptorBinding::references(uint64_t handle) const
+    {
+        if (isImage())
+        {
+            return reinterpret_cast<uint64_t>(imageInfo.imageView) == handle || reinterpret_cast<uint64_t>(imageInfo.sampler) == handle;
+        }
+        return reinterpret_cast<uint64_t>(bufferInfo.buffer) == handle;
+    }
+
+    /**
+     * @brief VkDescriptorImageInfo has trailing padding so every field is hashed on its own.
+    */
+    uint64_t DescriptorBinding::hash(uint64_t seed) const
+    {
+        seed = hashCombine(seed, hashValue(binding));
+        seed = hashCombine(seed, hashValue(type));
+        if (isImage())
+        {
+            seed = hashCombine(seed, hashValue(imageInfo.sampler));
+            seed = hashCombine(seed, hashValue(imageInfo.imageView));
+            return hashCombine(seed, hashValue(imageInfo.imageLayout));
+        }
+        seed = hashCombine(seed, hashValue(bufferInfo.buffer));
+        seed = hashCombine(seed, hashValue(bufferInfo.offset));
+        return hashCombine(seed, hashValue(bufferInfo.range));
+    }
+
+    bool DescriptorBinding::operator==(const DescriptorBinding& other) const
+    {
+        if (binding != other.binding || type != other.type)
+        {
+            return false;
+        }
+        if (isImage())
+        {
+            return imageInfo.sampler == other.imageInfo.sampler
+                && imageInfo.imageView == other.imageInfo.imageView
+                && imageInfo.imageLayout == other.imageInfo.imageLayout;
+        }
+        return bufferInfo.buffer == other.bufferInfo.buffer
+            && bufferInfo.offset == other.bufferInfo.offset
+            && bufferInfo.range == other.bufferInfo.range;
+    }
+
+    DescriptorBinding DescriptorBinding::buffer(uint32_t binding, const VkDescriptorBufferInfo& info, VkDescriptorType type)
+    {
+        DescriptorBinding result{};
+        result.binding = binding;
+        result.type = type;
+        result.bufferInfo = info;
+        return result;
+    }
+
+    DescriptorBinding DescriptorBinding::image(uint32_t binding, const VkDescriptorImageInfo& info, VkDescriptorType type)
+    {
+        DescriptorBinding result{};
+        result.binding = binding;
+        result.type = type;
+        result.imageInfo = info;
+        return result;
+    }
+
+    VulkanDescriptorSetCache::VulkanDescriptorSetCache(VulkanContext& context) : _context(context)
+    {
+
+    }
+
+    VulkanDescriptorSetCache::~VulkanDescriptorSetCache()
+    {
+        //the sets are released along with their pools, which the pool manager destroys after the cache
+    }
+
+    VkDescriptorSet VulkanDescriptorSetCache::get(const Ref<VulkanDescriptorSetLayout>& layout, const std::vector<DescriptorBinding>& bindings)
+    {
+        uint64_t key = hashKey(layout->getLayout(), bindings);
+        //contents whose hashes collide share a key, so the stored contents decide which entry matches
+        auto range = _entries.equal_range(key);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second.layout == layout && it->second.bindings == bindings)
+            {
+                it->second.lastUsedFrame = _frame;
+                return it->second.set;
+            }
+        }
+
+        Entry& entry = _entries.emplace(key, Entry{})->second;
+        entry.layout = layout;
+        entry.bindings = bindings;
+        entry.lastUsedFrame = _frame;
+
+        std::vector<VkDescriptorSet> sets(1, VK_NULL_HANDLE);
+        _context.getDescriptorPoolManager()->allocateSets(sets, layout->getLayout(), &entry.pool);
+        entry.set = sets[0];
+        write(entry);
+        return entry.set;
+    }
+
+    void VulkanDescriptorSetCache::nextFrame()
+    {
+        _frame++;
+
+        //evicted sets are freed in one call per pool
+        std::unordered_map<VkDescriptorPool, std::vector<VkDescriptorSet>> evicted;
+        for (auto it = _entries.begin(); it != _entries.end();)
+        {
+            if (it->second.lastUsedFrame + MAX_UNUSED_FRAMES >= _frame)
+            {
+                ++it;
+                continue;
+            }
+            evicted[it->second.pool].push_back(it->second.set);
+            it = _entries.erase(it);
+        }
+
+        for (auto& [pool, sets] : evicted)
+        {
+            _context.getDescriptorPoolManager()->freeSets(pool, sets);
+        }
+    }
+
+    void VulkanDescriptorSetCache::invalidateHandle(uint64_t handle)
+    {
+        if (handle == 0)
+        {
+            return;
+        }
+
+        std::unordered_map<VkDescriptorPool, std::vector<VkDescriptorSet>> retired;
+        for (auto it = _entries.begin(); it != _entries.end();)
+        {
+            bool referenced = std::any_of(it->second.bindings.begin(), it->second.bindings.end(),
+                [handle](const DescriptorBinding& binding) { return binding.references(handle); });
+            if (!referenced)
+            {
+                ++it;
+                continue;
+            }
+            retired[it->second.pool].push_back(it->second.set);
+            it = _entries.erase(it);
+        }
+
+        if (retired.empty())
+        {
+            return;
+        }
+        //the pools are destroyed along with the context, by then the sets are gone with them
+        std::weak_ptr<VulkanDescriptorPoolManager> poolManager = _context.getDescriptorPoolManager();
+        _context.getDeletionQueue()->push([poolManager, retired]() mutable
+        {
+            if (auto pools = poolManager.lock())
+            {
+                for (auto& [pool, sets] : retired)
+                {
+                    pools->freeSets(pool, sets);
+                }
+            }
+        });
+    }
+
+    void VulkanDescriptorSetCache::clear()
+    {
+        std::unordered_map<VkDescriptorPool, std::vector<VkDescriptorSet>> sets;
+        for (auto& [key, entry] : _entries)
+        {
+            sets[entry.pool].push_back(entry.set);
+        }
+        for (auto& [pool, poolSets] : sets)
+        {
+            _context.getDescriptorPoolManager()->freeSets(pool, poolSets);
+        }
+        _entries.clear();
+    }
+
+    uint64_t VulkanDescriptorSetCache::hashKey(VkDescriptorSetLayout layout, const std::vector<DescriptorBinding>& bindings)
+    {
+        uint64_t seed = hashValue(layout);
+        for (const auto& binding : bindings)
+        {
+            seed = binding.hash(seed);
+        }
+        return seed;
+    }
+
+    void VulkanDescriptorSetCache::write(const Entry& entry)
+    {
+        //one binding per descriptor of the layout means the packed array is complete
+        if (entry.bindings.size() == entry.layout->getSlotCount())
+        {
+            std::vector<DescriptorInfo> infos(entry.bindings.size());
+            for (const auto& binding : entry.bindings)
+            {
+                DescriptorInfo& info = infos[entry.layout->getSlot(binding.binding)];
+                if (binding.isImage()) info.image = binding.imageInfo;
+                else info.buffer = binding.bufferInfo;
+            }
+            entry.layout->update(entry.set, infos.data());
+            return;
+        }
+
+        std::vector<VkWriteDescriptorSet> writes(entry.bindings.size());
+        for (std::size_t i = 0; i < entry.bindings.size(); i++)
+        {
+            const DescriptorBinding& binding = entry.bindings[i];
+            VkWriteDescriptorSet& write = writes[i];
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = entry.set;
+            write.dstBinding = binding.binding;
+            write.dstArrayElement = 0;
+            write.descriptorType = binding.type;
+            write.descriptorCount = 1;
+            write.pBufferInfo = binding.isImage() ? nullptr : &binding.bufferInfo;
+            write.pImageInfo = binding.isImage() ? &binding.imageInfo : nullptr;
+        }
+        vkUpdateDescriptorSets(_context.getDevice()->device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "pch.h"
+
+#include "Vulkan.h"
+#include "VulkanContext.h"
+#include "VulkanLayoutCache.h"
+#include "Fwd.hpp"
+
+namespace cy3d
+{
+	/**
+	 * @brief One resource bound to a descriptor set. Only bufferInfo or imageInfo is used, depending on type.
+	*/
+	struct DescriptorBinding
+	{
+		uint32_t binding{ 0 };
+		VkDescriptorType type{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER };
+		VkDescriptorBufferInfo bufferInfo{};
+		VkDescriptorImageInfo imageInfo{};
+
+		uint64_t hash(uint64_t seed) const;
+		bool isImage() const;
+		/**
+		 * @brief Whether the buffer, image view or sampler bound here has the handle value handle.
+		*/
+		bool references(uint64_t handle) const;
+		bool operator==(const DescriptorBinding& other) const;
+
+		static DescriptorBinding buffer(uint32_t binding, const VkDescriptorBufferInfo& info, VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+		static DescriptorBinding image(uint32_t binding, const VkDescriptorImageInfo& info, VkDescriptorType type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+	};
+
+	/**
+	 * @brief Descriptor sets keyed by their layout and everything bound to them. Asking for a set whose contents match
+	 * one that already exists returns the existing set, so materials that share buffers and textures share sets and only
+	 * the first request pays for the allocation and vkUpdateDescriptorSets.
+	 *
+	 * Sets that have not been requested for MAX_UNUSED_FRAMES frames are freed back to their pool by nextFrame. Bindings
+	 * have to be passed in the same order every time, the order is part of the key.
+	 *
+	 * Sets are keyed on raw handle values, which the driver may hand out again once an object is destroyed. Buffers,
+	 * images and samplers therefore invalidate their handles when they are destroyed, so a resource created later with
+	 * the same value is never given a set written for the old one.
+	*/
+	class VulkanDescriptorSetCache
+	{
+	public:
+		//has to stay above MAX_FRAMES_IN_FLIGHT so an evicted set is never still in use by the gpu
+		static constexpr uint64_t MAX_UNUSED_FRAMES = 120;
+
+	private:
+		struct Entry
+		{
+			//keeps the layout alive as long as sets allocated with it exist
+			Ref<VulkanDescriptorSetLayout> layout{ nullptr };
+			std::vector<DescriptorBinding> bindings;
+			VkDescriptorSet set{ VK_NULL_HANDLE };
+			VkDescriptorPool pool{ VK_NULL_HANDLE };
+			uint64_t lastUsedFrame{ 0 };
+		};
+
+		VulkanContext& _context;
+		//a multimap so sets whose keys collide each keep their own entry
+		std::unordered_multimap<uint64_t, Entry> _entries;
+		uint64_t _frame{ 0 };
+
+	public:
+		VulkanDescriptorSetCache(VulkanContext& context);
+		~VulkanDescriptorSetCache();
+
+		CY_NOCOPY(VulkanDescriptorSetCache);
+
+		/**
+		 * @brief A set is written with the layout's update template when bindings cover every descriptor of the layout,
+		 * otherwise with a VkWriteDescriptorSet per binding.
+		*/
+		VkDescriptorSet get(const Ref<VulkanDescriptorSetLayout>& layout, const std::vector<DescriptorBinding>& bindings);
+
+		/**
+		 * @brief Drops every set that references handle, a VkBuffer, VkImageView or VkSampler that is being destroyed.
+		 * The sets are freed through the deletion queue because frames still in flight may be using them.
+		*/
+		template<typename Handle>
+		void invalidate(Handle handle)
+		{
+			//non dispatchable handles are pointers on 64 bit platforms and uint64_t everywhere else
+			invalidateHandle(reinterpret_cast<uint64_t>(handle));
+		}
+
+		/**
+		 * @brief Ages every entry by a frame and frees the ones that have not been used for too long. Has to be called
+		 * once per frame after the fence of the frame being started has signaled.
+		*/
+		void nextFrame();
+
+		/**
+		 * @brief Frees every set. The caller has to make sure none of them are still in use by the gpu.
+		*/
+		void clear();
+
+		std::size_t size() const { return _entries.size(); }
+
+	private:
+		void invalidateHandle(uint64_t handle);
+		static uint64_t hashKey(VkDescriptorSetLayout layout, const std::vector<DescriptorBinding>& bindings);
+		void write(const Entry& entry);
+	};
+}
@@ -4,11 +4,58 @@
 
 #include "VulkanContext.h"
 #include "VulkanDevice.h"
+#include "VulkanSwapChain.h"
 
 
 namespace cy3d
 { 
 
+    /**
+    *
+    *
+    * Descriptor Pool Ratios
+    *
+    *
+   */
+    void DescriptorPoolRatios::addShader(const VulkanShader& shader)
+    {
+        for (const auto& setLayout : shader.getSharedSetLayouts())
+        {
+            for (const auto& binding : setLayout->getBindings())
+            {
+                _descriptorCounts[binding.descriptorType] += binding.descriptorCount;
+            }
+            _setCount++;
+        }
+        _version++;
+    }
+
+    std::vector<VkDescriptorPoolSize> DescriptorPoolRatios::getPoolSizes(uint32_t maxSets) const
+    {
+        std::vector<VkDescriptorPoolSize> sizes;
+        for (VkDescriptorType type : SUPPORTED_TYPES)
+        {
+            uint32_t count = maxSets / 5; //the default mix before any shader has been loaded
+            if (_setCount != 0)
+            {
+                uint64_t descriptors = _descriptorCounts.count(type) != 0 ? _descriptorCounts.at(type) : 0;
+                count = static_cast<uint32_t>((descriptors * maxSets + _setCount - 1) / _setCount);
+            }
+            sizes.push_back(VkDescriptorPoolSize{ type, std::max(count, MIN_DESCRIPTORS_PER_TYPE) });
+        }
+
+        //types outside the supported ones still get room if a shader uses them
+        for (const auto& [type, descriptors] : _descriptorCounts)
+        {
+            if (std::find(SUPPORTED_TYPES.begin(), SUPPORTED_TYPES.end(), type) == SUPPORTED_TYPES.end())
+            {
+                uint32_t count = static_cast<uint32_t>((descriptors * maxSets + _setCount - 1) / _setCount);
+                sizes.push_back(VkDescriptorPoolSize{ type, std::max(count, MIN_DESCRIPTORS_PER_TYPE) });
+            }
+        }
+        return sizes;
+    }
+
     /**
     *
     *
@@ -28,11 +75,19 @@ namespace cy3d
 
     void VulkanDescriptorPoolManager::init()
     {
-        _currentPool = getPool();
-        _usedPools.push_back(_currentPool);
+        //the first pool is created by the first allocation so it can already be sized from the loaded shaders
+    }
+
+    void VulkanDescriptorPoolManager::recordShader(const VulkanShader& shader)
+    {
+        _ratios.addShader(shader);
     }
 
-    bool VulkanDescriptorPoolManager::allocateSets(std::vector<VkDescriptorSet>& sets, VkDescriptorSetLayout layout)
+    /**
+     * @brief Allocates one set with the given layout for every element of sets. outPool receives the pool they came from,
+     * which is needed to free them individually later.
+    */
+    bool VulkanDescriptorPoolManager::allocateSets(std::vector<VkDescriptorSet>& sets, VkDescriptorSetLayout layout, VkDescriptorPool* outPool)
     {
         std::vector layouts(sets.size(), layout);
 
@@ -54,6 +109,7 @@ namespace cy3d
         switch (allocResult)
         {
         case VK_SUCCESS:
+            if (outPool != nullptr) *outPool = _currentPool;
             return true;
 
         case VK_ERROR_FRAGMENTED_POOL:
@@ -74,15 +130,25 @@ namespace cy3d
         {
             _currentPool = getPool();
             _usedPools.push_back(_currentPool);
+            allocInfo.descriptorPool = _currentPool;
             VK_CHECK(vkAllocateDescriptorSets(_context.getDevice()->device(), &allocInfo, sets.data()));
         }
 
+        if (outPool != nullptr) *outPool = _currentPool;
         return true;
     }
 
-    bool VulkanDescriptorPoolManager::freeSets(uint32_t poolId, std::vector<VkDescriptorSet>& descriptors)
+    /**
+     * @brief Returns sets to the pool they were allocated from. None of them may still be in use by the gpu.
+    */
+    bool VulkanDescriptorPoolManager::freeSets(VkDescriptorPool pool, std::vector<VkDescriptorSet>& descriptors)
     {
-        CY_ASSERT(false); //not implemented
+        if (descriptors.empty())
+        {
+            return true;
+        }
+        VK_CHECK(vkFreeDescriptorSets(_context.getDevice()->device(), pool, static_cast<uint32_t>(descriptors.size()), descriptors.data()));
+        descriptors.clear();
         return true;
     }
 
@@ -114,21 +180,18 @@ namespace cy3d
 
     VkDescriptorPool VulkanDescriptorPoolManager::createPool()
     {
-        std::array<VkDescriptorPoolSize, 2> defaultPoolSizes =
-        {
-            VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 20 },
-            VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 20 }
-        };
+        std::vector<VkDescriptorPoolSize> poolSizes = _ratios.getPoolSizes(SETS_PER_POOL);
 
         VkDescriptorPoolCreateInfo poolInfo = {};
         poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        poolInfo.flags = 0;
-        poolInfo.maxSets = 100;
-        poolInfo.poolSizeCount = defaultPoolSizes.size();
-        poolInfo.pPoolSizes = defaultPoolSizes.data();
+        //sets are freed individually once the descriptor set cache evicts them
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        poolInfo.maxSets = SETS_PER_POOL;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
 
         VkDescriptorPool pool;
-        vkCreateDescriptorPool(_context.getDevice()->device(), &poolInfo, nullptr, &pool);
+        VK_CHECK(vkCreateDescriptorPool(_context.getDevice()->device(), &poolInfo, nullptr, &pool));
         return pool;
     }
 
@@ -153,6 +216,112 @@ namespace cy3d
     }
 
 
+    /**
+    *
+    *
+    * Frame Descriptor Allocator
+    *
+    *
+   */
+    VulkanFrameDescriptorAllocator::VulkanFrameDescriptorAllocator(VulkanContext& context) : _context(context)
+    {
+        _frames.resize(VulkanSwapChain::MAX_FRAMES_IN_FLIGHT);
+    }
+
+    VulkanFrameDescriptorAllocator::~VulkanFrameDescriptorAllocator()
+    {
+        for (auto& frame : _frames)
+        {
+            for (auto& pool : frame.used)
+            {
+                destroyPool(pool);
+            }
+        }
+
+        for (auto& pool : _freePools)
+        {
+            destroyPool(pool);
+        }
+    }
+
+    VkDescriptorSet VulkanFrameDescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+    {
+        FramePools& frame = _frames[_context.getCurrentFrameIndex()];
+        if (frame.used.empty())
+        {
+            frame.used.push_back(getPool());
+        }
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = frame.used.back().pool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        VkResult result = vkAllocateDescriptorSets(_context.getDevice()->device(), &allocInfo, &set);
+        if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+        {
+            //the current pool is full, it stays in use until the frame comes around again
+            frame.used.push_back(getPool());
+            allocInfo.descriptorPool = frame.used.back().pool;
+            result = vkAllocateDescriptorSets(_context.getDevice()->device(), &allocInfo, &set);
+        }
+        VK_CHECK(result);
+        return set;
+    }
+
+    void VulkanFrameDescriptorAllocator::nextFrame()
+    {
+        FramePools& frame = _frames[_context.getCurrentFrameIndex()];
+        uint64_t ratiosVersion = _context.getDescriptorPoolManager()->getRatios().getVersion();
+        for (auto& pool : frame.used)
+        {
+            if (pool.ratiosVersion != ratiosVersion)
+            {
+                destroyPool(pool);
+                continue;
+            }
+            //releases every set allocated from the pool at once
+            VK_CHECK(vkResetDescriptorPool(_context.getDevice()->device(), pool.pool, 0));
+            _freePools.push_back(pool);
+        }
+        frame.used.clear();
+    }
+
+    VulkanFrameDescriptorAllocator::Pool VulkanFrameDescriptorAllocator::getPool()
+    {
+        if (!_freePools.empty())
+        {
+            Pool pool = _freePools.back();
+            _freePools.pop_back();
+            return pool;
+        }
+
+        const DescriptorPoolRatios& ratios = _context.getDescriptorPoolManager()->getRatios();
+        std::vector<VkDescriptorPoolSize> poolSizes = ratios.getPoolSizes(SETS_PER_POOL);
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        //sets are never freed individually, only by resetting the whole pool
+        poolInfo.flags = 0;
+        poolInfo.maxSets = SETS_PER_POOL;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+
+        Pool pool{};
+        pool.ratiosVersion = ratios.getVersion();
+        VK_CHECK(vkCreateDescriptorPool(_context.getDevice()->device(), &poolInfo, nullptr, &pool.pool));
+        return pool;
+    }
+
+    void VulkanFrameDescriptorAllocator::destroyPool(Pool& pool)
+    {
+        vkDestroyDescriptorPool(_context.getDevice()->device(), pool.pool, nullptr);
+        pool.pool = VK_NULL_HANDLE;
+    }
+
+
     /**
       *
       *
@@ -169,62 +338,67 @@ namespace cy3d
 
     void VulkanDescriptorSets::init(const Ref<VulkanShader>& shader, uint32_t frames)
     {
-        const auto& descLayouts = shader->getDescriptorSetLayouts();
-
-        CY_ASSERT(descLayouts.size() == 1); //cannot handle more than 1 layout until below is fixed
-        //create as many sets as there are layouts for each frame
-        for (std::size_t frame = 0; frame < frames; frame++)
-        {
-            _descriptorSets[frame].resize(descLayouts.size());
-        }
+        _setLayouts = shader->getSharedSetLayouts();
 
-        for (std::size_t layoutId = 0; layoutId < descLayouts.size(); layoutId++) //frame //set id //sets
+        for (uint32_t frame = 0; frame < frames; frame++)
         {
-            //allocate 
-            for (std::size_t frame = 0; frame < frames; frame++)
+            _descriptorSets[frame].resize(_setLayouts.size());
+            _stagedSets[frame].resize(_setLayouts.size());
+            for (std::size_t setId = 0; setId < _setLayouts.size(); setId++)
             {
-                //TODO this wont work with multiple layouts
-                _context.getDescriptorPoolManager()->allocateSets(_descriptorSets[frame], descLayouts.at(layoutId));
-            }  
+                std::vector<VkDescriptorSet> set(1, VK_NULL_HANDLE);
+                _context.getDescriptorPoolManager()->allocateSets(set, _setLayouts[setId]->getLayout());
+                _descriptorSets[frame][setId] = set[0];
+
+                StagedSet& staged = _stagedSets[frame][setId];
+                staged.infos.resize(_setLayouts[setId]->getSlotCount());
+                staged.written.resize(staged.infos.size(), false);
+            }
         }
     }
 
-    bool VulkanDescriptorSets::writeBufferToSet(const VkDescriptorBufferInfo& info, std::size_t frame, std::size_t setId, uint32_t bindingIndex)
+    bool VulkanDescriptorSets::writeBufferToSet(const VkDescriptorBufferInfo& info, std::size_t frame, std::size_t setId, uint32_t bindingIndex, VkDescriptorType type)
     {
-        VkWriteDescriptorSet descriptorWrite{};
-        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrite.dstSet = _descriptorSets[frame][setId];
-        descriptorWrite.dstBinding = bindingIndex;
-        descriptorWrite.dstArrayElement = 0;
-        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; // temporary
-        descriptorWrite.descriptorCount = 1;
-        descriptorWrite.pBufferInfo = &info;
-        descriptorWrite.pImageInfo = nullptr;
-        descriptorWrite.pTexelBufferView = nullptr;
-        _writes.push_back(descriptorWrite);
+        StagedSet& staged = stage(frame, setId, bindingIndex, type);
+        staged.infos[_setLayouts[setId]->getSlot(bindingIndex)].buffer = info;
         return true;
     }
 
     bool VulkanDescriptorSets::writeImageToSet(const VkDescriptorImageInfo& info, std::size_t frame, std::size_t setId, uint32_t bindingIndex)
     {
-        VkWriteDescriptorSet descriptorWrite{};
-        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrite.dstSet = _descriptorSets[frame][setId];
-        descriptorWrite.dstBinding = bindingIndex;
-        descriptorWrite.dstArrayElement = 0;
-        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER; // temporary
-        descriptorWrite.descriptorCount = 1;
-        descriptorWrite.pBufferInfo = nullptr;
-        descriptorWrite.pImageInfo = &info;
-        descriptorWrite.pTexelBufferView = nullptr;
-        _writes.push_back(descriptorWrite);
+        StagedSet& staged = stage(frame, setId, bindingIndex, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+        staged.infos[_setLayouts[setId]->getSlot(bindingIndex)].image = info;
         return true;
     }
 
     VulkanDescriptorSets& VulkanDescriptorSets::updateSets()
     {
-        vkUpdateDescriptorSets(_context.getDevice()->device(), static_cast<uint32_t>(_writes.size()), _writes.data(), 0, nullptr);
-        _writes.clear();
+        for (auto& [frame, stagedSets] : _stagedSets)
+        {
+            for (std::size_t setId = 0; setId < stagedSets.size(); setId++)
+            {
+                StagedSet& staged = stagedSets[setId];
+                if (!staged.dirty)
+                {
+                    continue;
+                }
+                //the template writes the whole set so nothing may be left uninitialized
+                CY_ASSERT(std::find(staged.written.begin(), staged.written.end(), false) == staged.written.end());
+                _setLayouts[setId]->update(_descriptorSets[frame][setId], staged.infos.data());
+                staged.dirty = false;
+            }
+        }
         return *this;
     }
+
+    VulkanDescriptorSets::StagedSet& VulkanDescriptorSets::stage(std::size_t frame, std::size_t setId, uint32_t bindingIndex, VkDescriptorType type)
+    {
+        CY_ASSERT(_stagedSets.count(static_cast<uint32_t>(frame)) != 0 && setId < _setLayouts.size());
+        CY_ASSERT(_setLayouts[setId]->getBinding(bindingIndex).descriptorType == type); //does not match the shader
+
+        StagedSet& staged = _stagedSets[static_cast<uint32_t>(frame)][setId];
+        staged.written[_setLayouts[setId]->getSlot(bindingIndex)] = true;
+        staged.dirty = true;
+        return staged;
+    }
 }
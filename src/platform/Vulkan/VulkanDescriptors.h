@@ -10,6 +10,45 @@
 
 namespace cy3d
 {
+	/**
+	 *
+	 *
+	 * Pool Ratios
+	 *
+	 *
+	*/
+
+	/**
+	 * @brief The average number of descriptors of each type per set over the set layouts of every shader loaded so far.
+	 * Pools sized from it run out of sets and of each descriptor type at about the same time instead of overflowing on
+	 * one type while the rest sit unused. Until the first shader is recorded a fixed default mix is used.
+	*/
+	class DescriptorPoolRatios
+	{
+	public:
+		//every supported type gets at least this many descriptors so a pool can still serve a shader loaded after it was created
+		static constexpr uint32_t MIN_DESCRIPTORS_PER_TYPE = 4;
+		static constexpr std::array<VkDescriptorType, 5> SUPPORTED_TYPES =
+		{
+			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT
+		};
+
+	private:
+		std::unordered_map<VkDescriptorType, uint64_t> _descriptorCounts;
+		uint64_t _setCount{ 0 };
+		//changes whenever the ratios do, lets pools created with outdated ratios be recognized
+		uint64_t _version{ 0 };
+
+	public:
+		void addShader(const VulkanShader& shader);
+		std::vector<VkDescriptorPoolSize> getPoolSizes(uint32_t maxSets) const;
+		uint64_t getVersion() const { return _version; }
+	};
+
 	/**
 	 *
 	 *
@@ -19,19 +58,29 @@ namespace cy3d
 	*/
 	class VulkanDescriptorPoolManager
 	{
+	public:
+		static constexpr uint32_t SETS_PER_POOL = 100;
+
 	private:
 		VulkanContext& _context;
 		std::vector<VkDescriptorPool> _usedPools;
 		std::vector<VkDescriptorPool> _openPools;
 		VkDescriptorPool _currentPool{ VK_NULL_HANDLE };
+		DescriptorPoolRatios _ratios;
 	public:
 		VulkanDescriptorPoolManager(VulkanContext& context);
 		~VulkanDescriptorPoolManager();
 
-		bool allocateSets(std::vector<VkDescriptorSet>& sets, VkDescriptorSetLayout layout);
-		bool freeSets(uint32_t poolId, std::vector<VkDescriptorSet>& descriptors);
+		bool allocateSets(std::vector<VkDescriptorSet>& sets, VkDescriptorSetLayout layout, VkDescriptorPool* outPool = nullptr);
+		bool freeSets(VkDescriptorPool pool, std::vector<VkDescriptorSet>& descriptors);
 		bool resetPools();
 
+		/**
+		 * @brief Adds the set layouts of shader to the statistics new pools are sized from.
+		*/
+		void recordShader(const VulkanShader& shader);
+		const DescriptorPoolRatios& getRatios() const { return _ratios; }
+
 	private:
 		void init();
 		bool cleanup();
@@ -40,6 +89,65 @@ namespace cy3d
 	};
 
 
+	/**
+	 *
+	 *
+	 * Frame Allocator
+	 *
+	 *
+	*/
+
+	/**
+	 * @brief Allocates transient descriptor sets that are only valid for the frame they were allocated in. Every frame in
+	 * flight has its own pools, which are reset with a single vkResetDescriptorPool each once the frame's fence has
+	 * signaled instead of freeing sets one by one. Reset pools are recycled across frames unless the pool ratios changed
+	 * since they were created, in which case they are destroyed and replaced by pools sized from the new ratios.
+	 *
+	 * Only the render thread may allocate from it.
+	*/
+	class VulkanFrameDescriptorAllocator
+	{
+	public:
+		static constexpr uint32_t SETS_PER_POOL = 256;
+
+	private:
+		struct Pool
+		{
+			VkDescriptorPool pool{ VK_NULL_HANDLE };
+			uint64_t ratiosVersion{ 0 };
+		};
+
+		struct FramePools
+		{
+			//the last one is the pool currently allocated from
+			std::vector<Pool> used;
+		};
+
+		VulkanContext& _context;
+		std::vector<FramePools> _frames;
+		std::vector<Pool> _freePools;
+
+	public:
+		VulkanFrameDescriptorAllocator(VulkanContext& context);
+		~VulkanFrameDescriptorAllocator();
+
+		CY_NOCOPY(VulkanFrameDescriptorAllocator);
+
+		/**
+		 * @brief Returns a set that stays valid until the current frame index comes around again.
+		*/
+		VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+
+		/**
+		 * @brief Resets the pools of the frame that is starting. Has to be called once per frame after its fence has signaled.
+		*/
+		void nextFrame();
+
+	private:
+		Pool getPool();
+		void destroyPool(Pool& pool);
+	};
+
 	/**
 	 *
 	 *
@@ -47,19 +155,36 @@ namespace cy3d
 	 *
 	 *
 	*/
+	/**
+	 * @brief A set per set id of a shader for each of frames. Writes are only staged into a packed DescriptorInfo array per
+	 * set, updateSets then writes every changed set with its layout's update template in one call. The staged contents are
+	 * kept so a later write of a single binding rewrites the rest of the set unchanged.
+	*/
 	class VulkanDescriptorSets
 	{
 	private:
+		struct StagedSet
+		{
+			std::vector<DescriptorInfo> infos;
+			std::vector<bool> written;
+			bool dirty{ false };
+		};
+
 		VulkanContext& _context;
-		std::vector<VkWriteDescriptorSet> _writes;
+		std::vector<Ref<VulkanDescriptorSetLayout>> _setLayouts;
 
 		std::unordered_map<uint32_t, std::vector<VkDescriptorSet>> _descriptorSets; //  frame - set id - descriptor set
+		std::unordered_map<uint32_t, std::vector<StagedSet>> _stagedSets; //  frame - set id - staged contents
 
 	public:
 		VulkanDescriptorSets(VulkanContext& context, const Ref<VulkanShader>& shader, uint32_t frames);
 
-		bool writeBufferToSet(const VkDescriptorBufferInfo& info, std::size_t frame,  std::size_t setId, uint32_t bindingIndex);
+		bool writeBufferToSet(const VkDescriptorBufferInfo& info, std::size_t frame,  std::size_t setId, uint32_t bindingIndex, VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
 		bool writeImageToSet(const VkDescriptorImageInfo& info, std::size_t frame, std::size_t setId, uint32_t bindingIndex);
+
+		/**
+		 * @brief Writes every set that has changed since the last call. Every binding of a set has to have been written once.
+		*/
 		VulkanDescriptorSets& updateSets();
 
 		std::vector<VkDescriptorSet>& at(std::size_t frame)
@@ -70,6 +195,7 @@ namespace cy3d
 
 	private:
 		void init(const Ref<VulkanShader>& shader, uint32_t frames);
+		StagedSet& stage(std::size_t frame, std::size_t setId, uint32_t bindingIndex, VkDescriptorType type);
 
 	};
 }
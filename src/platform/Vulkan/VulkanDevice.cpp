@@ -37,11 +37,19 @@ namespace cy3d
 		}
 	}
 
-	VulkanDevice::VulkanDevice(VulkanContext& context) : cyContext(context) 
+	VulkanDevice::VulkanDevice(VulkanContext& context) : cyContext(context), _headless(context.isHeadless())
 	{
+		if (!_headless)
+		{
+			deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+		}
+
 		createInstance(); //init vulkan and create an _instance of it
 		setupDebugMessenger(); //setup validation layers.
-		createSurface(); //connection between the window and vulkan
+		if (!_headless)
+		{
+			createSurface(); //connection between the window and vulkan
+		}
 		pickPhysicalDevice(); //picks the gpu that the program will use
 		createLogicalDevice(); //describes what features of the physical device will be used.
 		createCommandPool();
@@ -57,7 +65,10 @@ namespace cy3d
 			DestroyDebugUtilsMessengerEXT(_instance, debugMessenger, nullptr);
 		}
 
-		vkDestroySurfaceKHR(_instance, _surface, nullptr);
+		if (_surface != VK_NULL_HANDLE)
+		{
+			vkDestroySurfaceKHR(_instance, _surface, nullptr);
+		}
 		vkDestroyInstance(_instance, nullptr);
 	}
 
@@ -136,6 +147,10 @@ namespace cy3d
 
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 		std::set<uint32_t> uniqueQueueFamilies{ indices.graphicsFamily.value(), indices.presentFamily.value() };
+		if (indices.computeFamily.has_value())
+		{
+			uniqueQueueFamilies.insert(indices.computeFamily.value());
+		}
 
 		/**
 		 * Vulkan lets you assign priorities to queues to influence the scheduling of
@@ -154,11 +169,45 @@ namespace cy3d
 			queueCreateInfos.push_back(queueCreateInfo);
 		}
 
+		/**
+		 * Indirect draws are generated on the gpu by the culling compute shader. multiDrawIndirect lets a single
+		 * vkCmdDrawIndexedIndirect consume the whole command buffer and drawIndirectCount lets the draw count be read
+		 * from a gpu buffer so the culled draws never round trip through the cpu. Both are optional and only enabled
+		 * when the physical device supports them.
+		*/
+		VkPhysicalDeviceProperties properties{};
+		vkGetPhysicalDeviceProperties(_physicalDevice, &properties);
+		//the Vulkan 1.2 feature struct may only be chained if the device itself supports 1.2
+		bool supportsVulkan12 = properties.apiVersion >= VK_API_VERSION_1_2;
+
+		VkPhysicalDeviceVulkan12Features supportedFeatures12{};
+		supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		VkPhysicalDeviceFeatures2 supportedFeatures{};
+		supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		if (supportsVulkan12)
+		{
+			supportedFeatures.pNext = &supportedFeatures12;
+			vkGetPhysicalDeviceFeatures2(_physicalDevice, &supportedFeatures);
+		}
+		else
+		{
+			vkGetPhysicalDeviceFeatures(_physicalDevice, &supportedFeatures.features);
+		}
+
+		_supportsMultiDrawIndirect = supportedFeatures.features.multiDrawIndirect == VK_TRUE;
+		_supportsDrawIndirectCount = supportsVulkan12 && supportedFeatures12.drawIndirectCount == VK_TRUE;
+
 		VkPhysicalDeviceFeatures deviceFeatures{};
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		deviceFeatures.multiDrawIndirect = _supportsMultiDrawIndirect ? VK_TRUE : VK_FALSE;
+
+		VkPhysicalDeviceVulkan12Features deviceFeatures12{};
+		deviceFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		deviceFeatures12.drawIndirectCount = _supportsDrawIndirectCount ? VK_TRUE : VK_FALSE;
 
 		VkDeviceCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		createInfo.pNext = supportsVulkan12 ? &deviceFeatures12 : nullptr;
 
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
@@ -194,6 +243,10 @@ namespace cy3d
 		*/
 		vkGetDeviceQueue(_device, indices.graphicsFamily.value(), 0, &graphicsQueue_);
 		vkGetDeviceQueue(_device, indices.presentFamily.value(), 0, &presentQueue_);
+		if (indices.computeFamily.has_value())
+		{
+			vkGetDeviceQueue(_device, indices.computeFamily.value(), 0, &computeQueue_);
+		}
 	}
 
 	/**
@@ -213,8 +266,11 @@ namespace cy3d
 
 		 * VK_COMMAND_POOL_CREATE_TRANSIENT_BIT: Hint that command buffers are rerecorded with new commands very often (may change memory allocation behavior)
 		 * VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT: Allow command buffers to be rerecorded individually, without this flag they all have to be reset together
+		 *
+		 * This pool only backs single time commands which are freed right after they finish, so buffers never need to be
+		 * reset individually. Per frame command buffers come from the renderer's own pools which are reset in bulk.
 		*/
-		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 
 		VK_CHECK(vkCreateCommandPool(_device, &poolInfo, nullptr, &_commandPool));
 	}
@@ -236,8 +292,9 @@ namespace cy3d
 
 		bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-		bool swapChainAdequate = false;
-		if (extensionsSupported)
+		//software implementations such as lavapipe are fine when headless, there is nothing to present to
+		bool swapChainAdequate = _headless;
+		if (extensionsSupported && !_headless)
 		{
 			SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 			swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
@@ -307,11 +364,16 @@ namespace cy3d
 
 	std::vector<const char*> VulkanDevice::getRequiredExtensions()
 	{
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions;
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		std::vector<const char*> extensions;
 
-		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		//glfw is never initialized for a headless device and the surface extensions are not needed
+		if (!_headless)
+		{
+			uint32_t glfwExtensionCount = 0;
+			const char** glfwExtensions;
+			glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+			extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		}
 
 		if (enableValidationLayers)
 		{
@@ -406,13 +468,40 @@ namespace cy3d
 			 * Will treat them as if they were separate queues for a uniform approach
 			*/
 			if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) indices.graphicsFamily = i;
-			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, _surface, &presentSupport);
-			if (queueFamily.queueCount > 0 && presentSupport) indices.presentFamily = i;
+
+			/**
+			 * A headless device has no surface to present to. The present family aliases the graphics family so no
+			 * extra queue is created and presentQueue() is never used.
+			*/
+			if (_headless)
+			{
+				indices.presentFamily = indices.graphicsFamily;
+			}
+			else
+			{
+				VkBool32 presentSupport = false;
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, _surface, &presentSupport);
+				if (queueFamily.queueCount > 0 && presentSupport) indices.presentFamily = i;
+			}
 			if (indices.isComplete()) break;
 			i++;
 		}
 
+		/**
+		 * The loop above stops as soon as graphics and present are found, so dedicated compute families are searched
+		 * separately. A family with compute but no graphics bit is usually backed by separate hardware queues and lets
+		 * compute work overlap with rendering.
+		*/
+		for (uint32_t family = 0; family < queueFamilyCount; family++)
+		{
+			const auto& queueFamily = queueFamilies[family];
+			if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT))
+			{
+				indices.computeFamily = family;
+				break;
+			}
+		}
+
 		return indices;
 	}
 
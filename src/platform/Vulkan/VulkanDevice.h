@@ -20,6 +20,8 @@ namespace cy3d
 		//std::optional variables on assignment of value will return true for has_value()
 		std::optional<uint32_t> graphicsFamily;
 		std::optional<uint32_t> presentFamily;
+		//a family with compute but no graphics support, only set when the device has one
+		std::optional<uint32_t> computeFamily;
 		bool isComplete() { return graphicsFamily.has_value() && presentFamily.has_value(); }
 	};
 
@@ -69,7 +71,7 @@ namespace cy3d
 		 * extension, which on Windows is called VK_KHR_win32_surface and is also automatically 
 		 * included in the list from glfwGetRequiredInstanceExtensions.
 		*/
-		VkSurfaceKHR _surface;
+		VkSurfaceKHR _surface{ VK_NULL_HANDLE };
 
 		/**
 		 * The queues are automatically created along with the logical device, but we don't have a handle to interface with them yet. 
@@ -77,15 +79,25 @@ namespace cy3d
 		*/
 		VkQueue graphicsQueue_;
 		VkQueue presentQueue_;
+		//VK_NULL_HANDLE when the device has no dedicated compute family
+		VkQueue computeQueue_{ VK_NULL_HANDLE };
 
 		const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
 		//
 		/**
 		* The supported features/extensions of physicalDevice.
 		* 
-		* Check that the physical device has Swap Chain Support
+		* Check that the physical device has Swap Chain Support. A headless device never presents so it
+		* does not require any.
 		*/
-		const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+		std::vector<const char*> deviceExtensions;
+
+		//no window, surface or present queue. Set from the context before anything else is created
+		bool _headless{ false };
+
+		//optional features used by gpu driven rendering
+		bool _supportsMultiDrawIndirect{ false };
+		bool _supportsDrawIndirectCount{ false };
 
 
 	public:
@@ -106,6 +118,15 @@ namespace cy3d
 		VkInstance instance() { return _instance; }
 		VkQueue graphicsQueue() { return graphicsQueue_; }
 		VkQueue presentQueue() { return presentQueue_; }
+		VkQueue computeQueue() { return computeQueue_; }
+		/**
+		 * @brief True when the device has a compute queue family without graphics support. Work submitted to it
+		 * runs alongside the graphics queue instead of in between its submissions.
+		*/
+		bool hasAsyncCompute() { return computeQueue_ != VK_NULL_HANDLE; }
+		bool supportsMultiDrawIndirect() { return _supportsMultiDrawIndirect; }
+		bool supportsDrawIndirectCount() { return _supportsDrawIndirectCount; }
+		bool isHeadless() { return _headless; }
 
 		SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(_physicalDevice); }
 		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -0,0 +1,229 @@
+#include "pch.h"
+
+#include "VulkanGPUProfiler.h"
+#include "VulkanDevice.h"
+#include "VulkanSwapChain.h"
+
+namespace cy3d
+{
+    VulkanGPUProfiler::VulkanGPUProfiler(VulkanContext& context, uint32_t workerCount) : _context(context), _workerCount(workerCount)
+    {
+        /**
+         * timestampValidBits is the number of meaningful bits in a timestamp written on the queue family, zero means
+         * the family does not support timestamps at all.
+        */
+        uint32_t graphicsFamily = _context.getDevice()->findPhysicalQueueFamilies().graphicsFamily.value();
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(_context.getDevice()->physicalDevice(), &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(_context.getDevice()->physicalDevice(), &familyCount, families.data());
+
+        uint32_t validBits = families[graphicsFamily].timestampValidBits;
+        _supported = validBits != 0;
+        _timestampMask = validBits >= 64 ? UINT64_MAX : (uint64_t(1) << validBits) - 1;
+        _timestampPeriod = static_cast<double>(_context.getDevice()->properties.limits.timestampPeriod);
+        if (!_supported)
+        {
+            CY_BASE_LOG_INFO("The graphics queue does not support timestamps, gpu profiling is disabled.");
+            return;
+        }
+
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        //the render thread's queries come first, followed by one range per worker
+        poolInfo.queryCount = totalQueryCount();
+
+        _frames.resize(VulkanSwapChain::MAX_FRAMES_IN_FLIGHT);
+        for (auto& frame : _frames)
+        {
+            VK_CHECK(vkCreateQueryPool(_context.getDevice()->device(), &poolInfo, nullptr, &frame.pool));
+            frame.scopes.reserve(MAX_SCOPES_PER_FRAME);
+            frame.workers.resize(_workerCount);
+            for (auto& worker : frame.workers)
+            {
+                worker.scopes.reserve(MAX_SCOPES_PER_WORKER);
+            }
+        }
+        _timestamps.resize(totalQueryCount());
+    }
+
+    VulkanGPUProfiler::~VulkanGPUProfiler()
+    {
+        for (auto& frame : _frames)
+        {
+            vkDestroyQueryPool(_context.getDevice()->device(), frame.pool, nullptr);
+        }
+    }
+
+    void VulkanGPUProfiler::beginFrame(VkCommandBuffer commandBuffer)
+    {
+        if (!_supported) return;
+
+        FrameQueries& frame = _frames[_context.getCurrentFrameIndex()];
+        if (frame.submitted)
+        {
+            readResults(frame);
+        }
+
+        frame.scopes.clear();
+        for (auto& worker : frame.workers)
+        {
+            worker.scopes.clear();
+            worker.localParents.clear();
+            worker.openScopes.clear();
+        }
+        frame.queryCount = 0;
+        frame.submitted = false;
+        _openScopes.clear();
+
+        //queries have to be reset before they are written again and the reset can not happen inside a render pass
+        vkCmdResetQueryPool(commandBuffer, frame.pool, 0, totalQueryCount());
+        beginScope(commandBuffer, "Frame");
+    }
+
+    void VulkanGPUProfiler::endFrame(VkCommandBuffer commandBuffer)
+    {
+        if (!_supported) return;
+
+        endScope(commandBuffer);
+        CY_ASSERT(_openScopes.empty());
+        FrameQueries& frame = _frames[_context.getCurrentFrameIndex()];
+        for (auto& worker : frame.workers)
+        {
+            CY_ASSERT(worker.openScopes.empty());
+        }
+        frame.submitted = true;
+    }
+
+    void VulkanGPUProfiler::beginScope(VkCommandBuffer commandBuffer, const std::string& name)
+    {
+        if (!_supported) return;
+
+        FrameQueries& frame = _frames[_context.getCurrentFrameIndex()];
+        CY_ASSERT(frame.scopes.size() < MAX_SCOPES_PER_FRAME);
+
+        GPUScopeTiming scope{};
+        scope.name = name;
+        scope.parent = _openScopes.empty() ? GPUScopeTiming::NO_PARENT : _openScopes.back();
+        scope.depth = static_cast<uint32_t>(_openScopes.size());
+
+        uint32_t index = static_cast<uint32_t>(frame.scopes.size());
+        frame.scopes.push_back(std::move(scope));
+        _openScopes.push_back(index);
+
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.pool, index * 2);
+        frame.queryCount = (index + 1) * 2;
+    }
+
+    void VulkanGPUProfiler::endScope(VkCommandBuffer commandBuffer)
+    {
+        if (!_supported) return;
+
+        CY_ASSERT(!_openScopes.empty());
+        FrameQueries& frame = _frames[_context.getCurrentFrameIndex()];
+        uint32_t index = _openScopes.back();
+        _openScopes.pop_back();
+
+        //the end timestamp is written once every command before it has finished
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.pool, index * 2 + 1);
+    }
+
+    void VulkanGPUProfiler::beginWorkerScope(uint32_t worker, VkCommandBuffer commandBuffer, const std::string& name)
+    {
+        if (!_supported) return;
+
+        CY_ASSERT(worker < _workerCount);
+        FrameQueries& frame = _frames[_context.getCurrentFrameIndex()];
+        WorkerQueries& queries = frame.workers[worker];
+        CY_ASSERT(queries.scopes.size() < MAX_SCOPES_PER_WORKER);
+
+        GPUScopeTiming scope{};
+        scope.name = name;
+        //the render thread is waiting on the workers so its open scopes do not change underneath
+        scope.parent = _openScopes.empty() ? GPUScopeTiming::NO_PARENT : _openScopes.back();
+        scope.depth = static_cast<uint32_t>(_openScopes.size() + queries.openScopes.size());
+
+        uint32_t index = static_cast<uint32_t>(queries.scopes.size());
+        queries.localParents.push_back(queries.openScopes.empty() ? GPUScopeTiming::NO_PARENT : queries.openScopes.back());
+        queries.scopes.push_back(std::move(scope));
+        queries.openScopes.push_back(index);
+
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.pool, workerQueryBase(worker) + index * 2);
+    }
+
+    void VulkanGPUProfiler::endWorkerScope(uint32_t worker, VkCommandBuffer commandBuffer)
+    {
+        if (!_supported) return;
+
+        FrameQueries& frame = _frames[_context.getCurrentFrameIndex()];
+        WorkerQueries& queries = frame.workers[worker];
+        CY_ASSERT(!queries.openScopes.empty());
+        uint32_t index = queries.openScopes.back();
+        queries.openScopes.pop_back();
+
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.pool, workerQueryBase(worker) + index * 2 + 1);
+    }
+
+    /**
+     * @brief The frame's fence has signaled so its queries are available and this does not wait. If the driver still
+     * reports them as not ready the previous results are kept.
+    */
+    void VulkanGPUProfiler::readResults(FrameQueries& frame)
+    {
+        if (frame.queryCount == 0)
+        {
+            return;
+        }
+
+        auto read = [&](uint32_t firstQuery, uint32_t queryCount)
+        {
+            return vkGetQueryPoolResults(_context.getDevice()->device(), frame.pool, firstQuery, queryCount,
+                queryCount * sizeof(uint64_t), _timestamps.data() + firstQuery, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        };
+        auto toMilliseconds = [&](uint32_t beginQuery)
+        {
+            uint64_t begin = _timestamps[beginQuery] & _timestampMask;
+            uint64_t end = _timestamps[beginQuery + 1] & _timestampMask;
+            uint64_t ticks = (end - begin) & _timestampMask;
+            return static_cast<double>(ticks) * _timestampPeriod / 1000000.0;
+        };
+
+        //only the written queries are read, unwritten ones would never become available
+        VkResult result = read(0, frame.queryCount);
+        for (uint32_t worker = 0; worker < _workerCount && result == VK_SUCCESS; worker++)
+        {
+            uint32_t count = static_cast<uint32_t>(frame.workers[worker].scopes.size()) * 2;
+            if (count != 0)
+            {
+                result = read(workerQueryBase(worker), count);
+            }
+        }
+        if (result == VK_NOT_READY)
+        {
+            return;
+        }
+        VK_CHECK(result);
+
+        _results = frame.scopes;
+        for (uint32_t i = 0; i < _results.size(); i++)
+        {
+            _results[i].milliseconds = toMilliseconds(i * 2);
+        }
+        for (uint32_t worker = 0; worker < _workerCount; worker++)
+        {
+            const WorkerQueries& queries = frame.workers[worker];
+            uint32_t offset = static_cast<uint32_t>(_results.size());
+            for (uint32_t i = 0; i < queries.scopes.size(); i++)
+            {
+                GPUScopeTiming timing = queries.scopes[i];
+                if (queries.localParents[i] != GPUScopeTiming::NO_PARENT)
+                {
+                    timing.parent = offset + queries.localParents[i];
+                }
+                timing.milliseconds = toMilliseconds(workerQueryBase(worker) + i * 2);
+                _results.push_back(std::move(timing));
+            }
+        }
+    }
+}
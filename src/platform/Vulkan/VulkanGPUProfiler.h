@@ -0,0 +1,138 @@
+#pragma once
+#include "pch.h"
+
+#include "Vulkan.h"
+#include "VulkanContext.h"
+#include "Fwd.hpp"
+
+namespace cy3d
+{
+	/**
+	 * @brief The gpu time of one named scope. The scopes recorded on the render thread come first, in the order they
+	 * were begun, followed by the scopes of each worker in turn. A scope's children always follow it and parent is the
+	 * index of the enclosing scope, or NO_PARENT for the frame's root. A worker's outermost scopes are parented to the
+	 * render thread scope that was open when they were begun.
+	*/
+	struct GPUScopeTiming
+	{
+		static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+		std::string name;
+		uint32_t parent{ NO_PARENT };
+		uint32_t depth{ 0 };
+		double milliseconds{ 0.0 };
+	};
+
+	/**
+	 * @brief Measures how much gpu time named scopes of a frame take by writing a vkCmdWriteTimestamp pair around each.
+	 *
+	 * Every frame in flight has its own query pool. The results of a frame are read back the next time its frame index
+	 * is started, after the swap chain has waited on that frame's fence, so reading them never stalls. The timings
+	 * returned by getResults are therefore MAX_FRAMES_IN_FLIGHT frames old.
+	 *
+	 * beginScope and endScope may only be called from the render thread. Secondary command buffers recorded on worker
+	 * threads use beginWorkerScope and endWorkerScope instead: every worker owns its own range of the query pool and its
+	 * own scope list, so workers never touch shared state. A primary command buffer inside a render pass begun with
+	 * VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS can only execute commands, so scopes within such a pass have to be
+	 * written into the secondary buffers.
+	*/
+	class VulkanGPUProfiler
+	{
+	public:
+		//two queries per scope
+		static constexpr uint32_t MAX_SCOPES_PER_FRAME = 128;
+		static constexpr uint32_t MAX_SCOPES_PER_WORKER = 16;
+
+	private:
+		struct WorkerQueries
+		{
+			std::vector<GPUScopeTiming> scopes;
+			//the enclosing scope among this worker's scopes, NO_PARENT for the outermost ones
+			std::vector<uint32_t> localParents;
+			std::vector<uint32_t> openScopes;
+		};
+
+		struct FrameQueries
+		{
+			VkQueryPool pool{ VK_NULL_HANDLE };
+			std::vector<GPUScopeTiming> scopes;
+			std::vector<WorkerQueries> workers;
+			uint32_t queryCount{ 0 };
+			bool submitted{ false };
+		};
+
+		VulkanContext& _context;
+		uint32_t _workerCount;
+		std::vector<FrameQueries> _frames;
+		std::vector<uint32_t> _openScopes;
+		std::vector<GPUScopeTiming> _results;
+		std::vector<uint64_t> _timestamps;
+
+		//nanoseconds per timestamp tick
+		double _timestampPeriod{ 0.0 };
+		uint64_t _timestampMask{ 0 };
+		bool _supported{ false };
+
+	public:
+		/**
+		 * @param workerCount The number of threads that record secondary command buffers, see VulkanRenderer::recordParallel.
+		*/
+		VulkanGPUProfiler(VulkanContext& context, uint32_t workerCount);
+		~VulkanGPUProfiler();
+
+		CY_NOCOPY(VulkanGPUProfiler);
+
+		/**
+		 * @brief Reads back the results of the last frame that used the current frame index, resets its queries and
+		 * begins the frame's root scope. The frame's fence must have signaled.
+		*/
+		void beginFrame(VkCommandBuffer commandBuffer);
+
+		/**
+		 * @brief Ends the root scope. Every other scope has to be ended by now.
+		*/
+		void endFrame(VkCommandBuffer commandBuffer);
+
+		void beginScope(VkCommandBuffer commandBuffer, const std::string& name);
+		void endScope(VkCommandBuffer commandBuffer);
+
+		/**
+		 * @brief Only called from the thread recording for worker, and only while the render thread waits for the
+		 * workers, because the scope is parented to the render thread's innermost open scope.
+		*/
+		void beginWorkerScope(uint32_t worker, VkCommandBuffer commandBuffer, const std::string& name);
+		void endWorkerScope(uint32_t worker, VkCommandBuffer commandBuffer);
+
+		/**
+		 * @brief The scope timings of the most recently completed frame.
+		*/
+		const std::vector<GPUScopeTiming>& getResults() { return _results; }
+		bool isSupported() { return _supported; }
+
+	private:
+		void readResults(FrameQueries& frame);
+		uint32_t workerQueryBase(uint32_t worker) const { return (MAX_SCOPES_PER_FRAME + worker * MAX_SCOPES_PER_WORKER) * 2; }
+		uint32_t totalQueryCount() const { return (MAX_SCOPES_PER_FRAME + _workerCount * MAX_SCOPES_PER_WORKER) * 2; }
+	};
+
+	/**
+	 * @brief Begins a gpu scope on construction and ends it when it goes out of scope.
+	*/
+	class VulkanGPUScope
+	{
+	private:
+		VulkanGPUProfiler& _profiler;
+		VkCommandBuffer _commandBuffer;
+
+	public:
+		VulkanGPUScope(VulkanGPUProfiler& profiler, VkCommandBuffer commandBuffer, const std::string& name)
+			: _profiler(profiler), _commandBuffer(commandBuffer)
+		{
+			_profiler.beginScope(_commandBuffer, name);
+		}
+
+		~VulkanGPUScope() { _profiler.endScope(_commandBuffer); }
+
+		CY_NOCOPY(VulkanGPUScope);
+	};
+}
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "VulkanImage.h"
 #include "VulkanDevice.h"
+#include "VulkanDescriptorSetCache.h"
 
 
 namespace cy3d
@@ -49,6 +50,10 @@ namespace cy3d
 
 		if (_imageView != nullptr)
 		{
+			if (cyContext.hasDescriptorSetCache())
+			{
+				cyContext.getDescriptorSetCache()->invalidate(_imageView);
+			}
 			vkDestroyImageView(cyContext.getDevice()->device(), _imageView, nullptr);
 		}
 	}
@@ -35,6 +35,7 @@ namespace cy3d
 		void transitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
 
 		image_type& getImage() { return _image; }
+		const image_info_type& getImageInfo() { return _imageInfo; }
 		VkFormat getFormat() { return _imageInfo.imageInfo.format; }
 		VkDeviceSize getImageSize() { return _imageInfo.imageInfo.imageSize; }
 		VkImageAspectFlags getAspectFlags() { return _imageInfo.imageInfo.aspectFlags; }
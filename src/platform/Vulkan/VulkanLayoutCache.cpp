@@ -0,0 +1,226 @@
+#include "pch.h"
+
+#include "VulkanLayoutCache.h"
+#include "VulkanDevice.h"
+#include "../../core/Hash.h"
+
+namespace cy3d
+{
+    VulkanDescriptorSetLayout::VulkanDescriptorSetLayout(VkDevice device, const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+        : _device(device), _bindings(bindings)
+    {
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(_bindings.size());
+        layoutInfo.pBindings = _bindings.data();
+        VK_CHECK(vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &_layout));
+        createUpdateTemplate();
+    }
+
+    VulkanDescriptorSetLayout::~VulkanDescriptorSetLayout()
+    {
+        if (_updateTemplate != VK_NULL_HANDLE)
+        {
+            vkDestroyDescriptorUpdateTemplate(_device, _updateTemplate, nullptr);
+        }
+        vkDestroyDescriptorSetLayout(_device, _layout, nullptr);
+    }
+
+    uint32_t VulkanDescriptorSetLayout::getSlot(uint32_t binding) const
+    {
+        return _firstSlots[findBinding(binding)];
+    }
+
+    const VkDescriptorSetLayoutBinding& VulkanDescriptorSetLayout::getBinding(uint32_t binding) const
+    {
+        return _bindings[findBinding(binding)];
+    }
+
+    void VulkanDescriptorSetLayout::update(VkDescriptorSet set, const DescriptorInfo* infos) const
+    {
+        CY_ASSERT(_updateTemplate != VK_NULL_HANDLE); //nothing to write into a set without bindings
+        vkUpdateDescriptorSetWithTemplate(_device, set, _updateTemplate, infos);
+    }
+
+    std::size_t VulkanDescriptorSetLayout::findBinding(uint32_t binding) const
+    {
+        auto found = std::lower_bound(_bindings.begin(), _bindings.end(), binding, [](const auto& layoutBinding, uint32_t value)
+        {
+            return layoutBinding.binding < value;
+        });
+        CY_ASSERT(found != _bindings.end() && found->binding == binding); //the layout has no such binding
+        return static_cast<std::size_t>(found - _bindings.begin());
+    }
+
+    /**
+     * @brief One template entry per binding. An entry covers all of a binding's array elements, which read consecutive
+     * slots because the stride is the size of one slot.
+    */
+    void VulkanDescriptorSetLayout::createUpdateTemplate()
+    {
+        if (_bindings.empty())
+        {
+            return;
+        }
+
+        std::vector<VkDescriptorUpdateTemplateEntry> entries;
+        entries.reserve(_bindings.size());
+        _firstSlots.reserve(_bindings.size());
+        for (const auto& binding : _bindings)
+        {
+            VkDescriptorUpdateTemplateEntry entry{};
+            entry.dstBinding = binding.binding;
+            entry.dstArrayElement = 0;
+            entry.descriptorCount = binding.descriptorCount;
+            entry.descriptorType = binding.descriptorType;
+            entry.offset = _slotCount * sizeof(DescriptorInfo);
+            entry.stride = sizeof(DescriptorInfo);
+            entries.push_back(entry);
+
+            _firstSlots.push_back(_slotCount);
+            _slotCount += binding.descriptorCount;
+        }
+
+        VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+        templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+        templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+        templateInfo.pDescriptorUpdateEntries = entries.data();
+        templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+        templateInfo.descriptorSetLayout = _layout;
+        VK_CHECK(vkCreateDescriptorUpdateTemplate(_device, &templateInfo, nullptr, &_updateTemplate));
+    }
+
+    VulkanPipelineLayout::VulkanPipelineLayout(VkDevice device, const std::vector<Ref<VulkanDescriptorSetLayout>>& setLayouts,
+        const std::vector<VkPushConstantRange>& pushConstants)
+        : _device(device), _setLayouts(setLayouts), _pushConstants(pushConstants)
+    {
+        std::vector<VkDescriptorSetLayout> layouts;
+        layouts.reserve(_setLayouts.size());
+        for (const auto& setLayout : _setLayouts)
+        {
+            layouts.push_back(setLayout->getLayout());
+        }
+
+        VkPipelineLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layoutInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
+        layoutInfo.pSetLayouts = layouts.data();
+        layoutInfo.pushConstantRangeCount = static_cast<uint32_t>(_pushConstants.size());
+        layoutInfo.pPushConstantRanges = _pushConstants.data();
+        VK_CHECK(vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &_layout));
+    }
+
+    VulkanPipelineLayout::~VulkanPipelineLayout()
+    {
+        vkDestroyPipelineLayout(_device, _layout, nullptr);
+    }
+
+    VulkanLayoutCache::VulkanLayoutCache(VulkanContext& context) : _context(context)
+    {
+
+    }
+
+    VulkanLayoutCache::~VulkanLayoutCache()
+    {
+        //layouts that are still referenced destroy themselves once their last owner lets go of them
+    }
+
+    Ref<VulkanDescriptorSetLayout> VulkanLayoutCache::getDescriptorSetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings)
+    {
+        //the canonical order, reflection hands the bindings over in whatever order its maps iterate in
+        std::sort(bindings.begin(), bindings.end(), [](const auto& a, const auto& b) { return a.binding < b.binding; });
+        uint64_t key = hashBindings(bindings);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        //bindings whose hashes collide share a key, expired layouts are dropped on the way
+        auto range = _setLayouts.equal_range(key);
+        for (auto it = range.first; it != range.second;)
+        {
+            Ref<VulkanDescriptorSetLayout> layout = it->second.lock();
+            if (layout == nullptr)
+            {
+                it = _setLayouts.erase(it);
+                continue;
+            }
+            if (equalBindings(layout->getBindings(), bindings))
+            {
+                return layout;
+            }
+            ++it;
+        }
+
+        Ref<VulkanDescriptorSetLayout> layout = std::make_shared<VulkanDescriptorSetLayout>(_context.getDevice()->device(), bindings);
+        _setLayouts.emplace(key, layout);
+        return layout;
+    }
+
+    Ref<VulkanPipelineLayout> VulkanLayoutCache::getPipelineLayout(const std::vector<Ref<VulkanDescriptorSetLayout>>& setLayouts,
+        const std::vector<VkPushConstantRange>& pushConstants)
+    {
+        //set layouts are deduplicated, so equal handles mean equal layouts
+        uint64_t key = FNV_OFFSET_BASIS;
+        for (const auto& setLayout : setLayouts)
+        {
+            key = hashCombine(key, hashValue(setLayout->getLayout()));
+        }
+        for (const auto& range : pushConstants)
+        {
+            key = hashCombine(key, hashValue(range));
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto range = _pipelineLayouts.equal_range(key);
+        for (auto it = range.first; it != range.second;)
+        {
+            Ref<VulkanPipelineLayout> layout = it->second.lock();
+            if (layout == nullptr)
+            {
+                it = _pipelineLayouts.erase(it);
+                continue;
+            }
+            if (layout->getSetLayouts() == setLayouts && equalPushConstants(layout->getPushConstants(), pushConstants))
+            {
+                return layout;
+            }
+            ++it;
+        }
+
+        Ref<VulkanPipelineLayout> layout = std::make_shared<VulkanPipelineLayout>(_context.getDevice()->device(), setLayouts, pushConstants);
+        _pipelineLayouts.emplace(key, layout);
+        return layout;
+    }
+
+    /**
+     * @brief pImmutableSamplers is hashed by pointer, immutable samplers are not deduplicated.
+    */
+    uint64_t VulkanLayoutCache::hashBindings(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+    {
+        uint64_t seed = FNV_OFFSET_BASIS;
+        for (const auto& binding : bindings)
+        {
+            seed = hashCombine(seed, hashValue(binding.binding));
+            seed = hashCombine(seed, hashValue(binding.descriptorType));
+            seed = hashCombine(seed, hashValue(binding.descriptorCount));
+            seed = hashCombine(seed, hashValue(binding.stageFlags));
+            seed = hashCombine(seed, hashValue(binding.pImmutableSamplers));
+        }
+        return seed;
+    }
+
+    bool VulkanLayoutCache::equalBindings(const std::vector<VkDescriptorSetLayoutBinding>& a, const std::vector<VkDescriptorSetLayoutBinding>& b)
+    {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const auto& lhs, const auto& rhs)
+        {
+            return lhs.binding == rhs.binding && lhs.descriptorType == rhs.descriptorType && lhs.descriptorCount == rhs.descriptorCount
+                && lhs.stageFlags == rhs.stageFlags && lhs.pImmutableSamplers == rhs.pImmutableSamplers;
+        });
+    }
+
+    bool VulkanLayoutCache::equalPushConstants(const std::vector<VkPushConstantRange>& a, const std::vector<VkPushConstantRange>& b)
+    {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const auto& lhs, const auto& rhs)
+        {
+            return lhs.stageFlags == rhs.stageFlags && lhs.offset == rhs.offset && lhs.size == rhs.size;
+        });
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include "pch.h"
+
+#include "../../core/core.h"
+#include "Vulkan.h"
+#include "VulkanContext.h"
+#include "Fwd.hpp"
+
+namespace cy3d
+{
+	/**
+	 * @brief One slot of the packed array a descriptor update template reads a set's contents from.
+	*/
+	union DescriptorInfo
+	{
+		VkDescriptorBufferInfo buffer;
+		VkDescriptorImageInfo image;
+		VkBufferView texelBufferView;
+	};
+
+	/**
+	 * @brief A descriptor set layout shared by every shader that declares the same bindings. Destroyed with the last
+	 * reference to it.
+	 *
+	 * Also owns a descriptor update template generated from the bindings. The template reads one DescriptorInfo per
+	 * descriptor, bindings in ascending order and array elements back to back, so an entire set is written from one packed
+	 * array with a single vkUpdateDescriptorSetWithTemplate instead of a VkWriteDescriptorSet per binding.
+	*/
+	class VulkanDescriptorSetLayout
+	{
+	private:
+		VkDevice _device{ VK_NULL_HANDLE };
+		VkDescriptorSetLayout _layout{ VK_NULL_HANDLE };
+		//sorted by binding
+		std::vector<VkDescriptorSetLayoutBinding> _bindings;
+		//null for a layout without bindings
+		VkDescriptorUpdateTemplate _updateTemplate{ VK_NULL_HANDLE };
+		//index of the first slot of each binding, parallel to _bindings
+		std::vector<uint32_t> _firstSlots;
+		uint32_t _slotCount{ 0 };
+
+	public:
+		VulkanDescriptorSetLayout(VkDevice device, const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+		~VulkanDescriptorSetLayout();
+
+		CY_NOCOPY(VulkanDescriptorSetLayout);
+
+		VkDescriptorSetLayout getLayout() const { return _layout; }
+		const std::vector<VkDescriptorSetLayoutBinding>& getBindings() const { return _bindings; }
+
+		/**
+		 * @brief Number of DescriptorInfo the update template reads.
+		*/
+		uint32_t getSlotCount() const { return _slotCount; }
+
+		/**
+		 * @brief Slot of the first descriptor of binding in the packed array.
+		*/
+		uint32_t getSlot(uint32_t binding) const;
+		const VkDescriptorSetLayoutBinding& getBinding(uint32_t binding) const;
+
+		/**
+		 * @brief Writes every descriptor of set from infos, which has to hold getSlotCount() valid entries.
+		*/
+		void update(VkDescriptorSet set, const DescriptorInfo* infos) const;
+
+	private:
+		std::size_t findBinding(uint32_t binding) const;
+		void createUpdateTemplate();
+	};
+
+	/**
+	 * @brief A pipeline layout shared by every pipeline whose shaders use the same set layouts and push constants.
+	 * Keeps its set layouts alive.
+	*/
+	class VulkanPipelineLayout
+	{
+	private:
+		VkDevice _device{ VK_NULL_HANDLE };
+		VkPipelineLayout _layout{ VK_NULL_HANDLE };
+		std::vector<Ref<VulkanDescriptorSetLayout>> _setLayouts;
+		std::vector<VkPushConstantRange> _pushConstants;
+
+	public:
+		VulkanPipelineLayout(VkDevice device, const std::vector<Ref<VulkanDescriptorSetLayout>>& setLayouts,
+			const std::vector<VkPushConstantRange>& pushConstants);
+		~VulkanPipelineLayout();
+
+		CY_NOCOPY(VulkanPipelineLayout);
+
+		VkPipelineLayout getLayout() const { return _layout; }
+		const std::vector<Ref<VulkanDescriptorSetLayout>>& getSetLayouts() const { return _setLayouts; }
+		const std::vector<VkPushConstantRange>& getPushConstants() const { return _pushConstants; }
+	};
+
+	/**
+	 * @brief Context wide cache of descriptor set and pipeline layouts. Set layouts are keyed by a hash of their bindings
+	 * in binding order, so shaders that declare the same bindings in any order get the same VkDescriptorSetLayout. Because
+	 * of that pipeline layouts can be keyed by the set layout handles themselves, and pipelines built from different
+	 * shaders with matching resources share a VkPipelineLayout, which lets bound descriptor sets survive pipeline switches.
+	 *
+	 * The cache only holds weak references. A layout is destroyed once nothing uses it anymore and recreated on the next
+	 * request. Safe to call from any thread.
+	*/
+	class VulkanLayoutCache
+	{
+	private:
+		VulkanContext& _context;
+		std::mutex _mutex;
+		//multimaps so layouts whose hashes collide each keep their own entry
+		std::unordered_multimap<uint64_t, WeakRef<VulkanDescriptorSetLayout>> _setLayouts;
+		std::unordered_multimap<uint64_t, WeakRef<VulkanPipelineLayout>> _pipelineLayouts;
+
+	public:
+		VulkanLayoutCache(VulkanContext& context);
+		~VulkanLayoutCache();
+
+		CY_NOCOPY(VulkanLayoutCache);
+
+		Ref<VulkanDescriptorSetLayout> getDescriptorSetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings);
+		Ref<VulkanPipelineLayout> getPipelineLayout(const std::vector<Ref<VulkanDescriptorSetLayout>>& setLayouts,
+			const std::vector<VkPushConstantRange>& pushConstants = {});
+
+	private:
+		static uint64_t hashBindings(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+		static bool equalBindings(const std::vector<VkDescriptorSetLayoutBinding>& a, const std::vector<VkDescriptorSetLayoutBinding>& b);
+		static bool equalPushConstants(const std::vector<VkPushConstantRange>& a, const std::vector<VkPushConstantRange>& b);
+	};
+}
@@ -1,41 +1,38 @@
 #include "pch.h"
 
 #include "VulkanPipeline.h"
+#include "VulkanPipelineCache.h"
 #include "VulkanContext.h"
 #include "VulkanBuffer.h"
+#include "../../core/Hash.h"
 
 #include <Logi/Logi.h>
 
 namespace cy3d
 {
-    VulkanPipeline::VulkanPipeline(VulkanContext& context, const Ref<VulkanShader>& shader, const PipelineSpec& spec) : _context(context)
+    VulkanPipeline::VulkanPipeline(VulkanContext& context, const Ref<VulkanShader>& shader, const PipelineSpec& spec)
+        : _context(context), _state(PipelineState::createDefault(shader, spec.renderpass))
     {
-        init(shader, spec);
+        init();
     }
 
-    VulkanPipeline::~VulkanPipeline()
+    VulkanPipeline::VulkanPipeline(VulkanContext& context, const PipelineState& state) : _context(context), _state(state)
     {
-        for (auto& shaderStage : _shaderStages)
-        {
-            vkDestroyShaderModule(_context.getDevice()->device(), shaderStage.module, nullptr);
-        }
-
-        for (auto& descriptorLayout : _descriptorSetLayouts)
-        {
-            vkDestroyDescriptorSetLayout(_context.getDevice()->device(), descriptorLayout, nullptr);
-        }
+        init();
+    }
 
+    VulkanPipeline::~VulkanPipeline()
+    {
+        //the shader modules belong to the shader and the layouts are shared
         cleanup();
     }
 
-    void VulkanPipeline::init(const Ref<VulkanShader>& shader, const PipelineSpec& spec)
+    void VulkanPipeline::init()
     {
-        //take ownership of descriptor set layouts
-        _descriptorSetLayouts = shader->getDescriptorSetLayouts();
-        //take ownership of shader modules
-        _shaderStages = shader->getPipelineCreateInfo();
+        CY_ASSERT(_state.shader != nullptr);
+        CY_ASSERT(_state.renderPass != VK_NULL_HANDLE);
         createLayout();
-        createGraphicsPipeline(spec);
+        createGraphicsPipeline();
     }
 
     void VulkanPipeline::cleanup()
@@ -44,69 +41,95 @@ namespace cy3d
         {
             vkDestroyPipeline(_context.getDevice()->device(), graphicsPipeline, nullptr);
         }
-
-        if (_pipelineLayout != nullptr)
-        {
-            vkDestroyPipelineLayout(_context.getDevice()->device(), _pipelineLayout, nullptr);
-        }
     }
 
     void VulkanPipeline::createLayout()
     {
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = _descriptorSetLayouts.size();
-        pipelineLayoutInfo.pSetLayouts = _descriptorSetLayouts.data();
-        pipelineLayoutInfo.pushConstantRangeCount = 0; //used to send data to shaders
-        pipelineLayoutInfo.pPushConstantRanges = nullptr;
-
-        VK_CHECK(vkCreatePipelineLayout(_context.getDevice()->device(), &pipelineLayoutInfo, nullptr, &_pipelineLayout));
+        //held here as well so the layout outlives the shader while the pipeline is still waiting to be destroyed
+        _pipelineLayout = _state.shader->getPipelineLayout();
+        CY_ASSERT(_pipelineLayout != nullptr);
     }
 
-    void VulkanPipeline::createGraphicsPipeline(const PipelineSpec& spec)
+    void VulkanPipeline::createGraphicsPipeline()
     {
-        auto bindingDescription = Vertex::getBindingDescription();
-        auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
         VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInputInfo.vertexBindingDescriptionCount = 1;
-        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-        
+        vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(_state.vertexBindings.size());
+        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(_state.vertexAttributes.size());
+        vertexInputInfo.pVertexBindingDescriptions = _state.vertexBindings.data();
+        vertexInputInfo.pVertexAttributeDescriptions = _state.vertexAttributes.data();
+
+        //the viewport and scissor are only placeholders, they are overwritten when the render pass begins
+        PipelineSpec spec{ _state.renderPass, 1, 1 };
         PipelineConfigInfo configInfo{};
         VulkanPipeline::defaultPipelineConfigInfo(spec, configInfo);
 
+        configInfo.inputAssemblyInfo.topology = _state.topology;
+        configInfo.rasterizationInfo.polygonMode = _state.polygonMode;
+        configInfo.rasterizationInfo.cullMode = _state.cullMode;
+        configInfo.rasterizationInfo.frontFace = _state.frontFace;
+
+        configInfo.colorBlendAttachment.blendEnable = _state.blendEnable ? VK_TRUE : VK_FALSE;
+        configInfo.colorBlendAttachment.srcColorBlendFactor = _state.srcColorBlendFactor;
+        configInfo.colorBlendAttachment.dstColorBlendFactor = _state.dstColorBlendFactor;
+        configInfo.colorBlendAttachment.colorBlendOp = _state.colorBlendOp;
+        configInfo.colorBlendAttachment.srcAlphaBlendFactor = _state.srcAlphaBlendFactor;
+        configInfo.colorBlendAttachment.dstAlphaBlendFactor = _state.dstAlphaBlendFactor;
+        configInfo.colorBlendAttachment.alphaBlendOp = _state.alphaBlendOp;
+        configInfo.colorBlendAttachment.colorWriteMask = _state.colorWriteMask;
+
+        configInfo.depthStencilInfo.depthTestEnable = _state.depthTestEnable ? VK_TRUE : VK_FALSE;
+        configInfo.depthStencilInfo.depthWriteEnable = _state.depthWriteEnable ? VK_TRUE : VK_FALSE;
+        configInfo.depthStencilInfo.depthCompareOp = _state.depthCompareOp;
+
+        /**
+         * Viewport and scissor are set by the renderer every time a command buffer begins, so the pipeline does not
+         * depend on the swap chain extent and survives a resize.
+        */
+        std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+        VkPipelineDynamicStateCreateInfo dynamicInfo{};
+        dynamicInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamicInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+        dynamicInfo.pDynamicStates = dynamicStates.data();
+
+        //copied so the specialization can be attached without touching the shader's stages
+        SpecializationData specialization(_state.specializationConstants);
+        std::vector<VkPipelineShaderStageCreateInfo> shaderStages = _state.shader->getPipelineCreateInfo();
+        for (auto& stage : shaderStages)
+        {
+            stage.pSpecializationInfo = specialization.get();
+        }
+
         VkGraphicsPipelineCreateInfo pipelineInfo{};
         pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipelineInfo.stageCount = 2;
-        pipelineInfo.pStages = _shaderStages.data();
+        pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+        pipelineInfo.pStages = shaderStages.data();
         pipelineInfo.pVertexInputState = &vertexInputInfo;
         pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
         pipelineInfo.pViewportState = &configInfo.viewportInfo;
         pipelineInfo.pRasterizationState = &configInfo.rasterizationInfo;
         pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
         pipelineInfo.pColorBlendState = &configInfo.colorBlendInfo;
-        pipelineInfo.pDynamicState = nullptr;  // Optional
+        pipelineInfo.pDynamicState = &dynamicInfo;
         pipelineInfo.pDepthStencilState = &configInfo.depthStencilInfo;
 
-        pipelineInfo.layout = _pipelineLayout;
-        pipelineInfo.renderPass = spec.renderpass;
-        pipelineInfo.subpass = configInfo.subpass;
+        pipelineInfo.layout = _pipelineLayout->getLayout();
+        pipelineInfo.renderPass = _state.renderPass;
+        pipelineInfo.subpass = _state.subpass;
 
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;  // Optional
         pipelineInfo.basePipelineIndex = -1;               // Optional
 
 
-        VK_CHECK(vkCreateGraphicsPipelines(_context.getDevice()->device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline));
+        VK_CHECK(vkCreateGraphicsPipelines(_context.getDevice()->device(), _context.getPipelineCache()->get(), 1, &pipelineInfo, nullptr, &graphicsPipeline));
     }
 
     bool VulkanPipeline::recreate(const PipelineSpec& spec)
     {
-        cleanup(); //destroy graphics pipeline and layout
-        createLayout(); //recreate the layout
-        createGraphicsPipeline(spec); //recreate the graphics pipeline
+        cleanup(); //destroy the graphics pipeline
+        _state.renderPass = spec.renderpass;
+        createLayout(); //pick up the shader's layout again
+        createGraphicsPipeline(); //recreate the graphics pipeline
         return true;
     }
 
@@ -115,6 +138,140 @@ namespace cy3d
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
     }
 
+    SpecializationData::SpecializationData(const std::vector<SpecializationConstant>& constants)
+    {
+        for (const auto& constant : constants)
+        {
+            VkSpecializationMapEntry entry{};
+            entry.constantID = constant.id;
+            entry.offset = static_cast<uint32_t>(values.size() * sizeof(uint32_t));
+            entry.size = sizeof(uint32_t);
+            entries.push_back(entry);
+            values.push_back(constant.value);
+        }
+        info.mapEntryCount = static_cast<uint32_t>(entries.size());
+        info.pMapEntries = entries.data();
+        info.dataSize = values.size() * sizeof(uint32_t);
+        info.pData = values.data();
+    }
+
+    uint64_t PipelineState::hash() const
+    {
+        CY_ASSERT(shader != nullptr);
+        uint64_t seed = hashString(shader->getName());
+        seed = hashCombine(seed, hashValue(renderPass));
+        seed = hashCombine(seed, hashValue(subpass));
+
+        for (const auto& binding : vertexBindings)
+        {
+            seed = hashCombine(seed, hashValue(binding.binding));
+            seed = hashCombine(seed, hashValue(binding.stride));
+            seed = hashCombine(seed, hashValue(binding.inputRate));
+        }
+        for (const auto& attribute : vertexAttributes)
+        {
+            seed = hashCombine(seed, hashValue(attribute.location));
+            seed = hashCombine(seed, hashValue(attribute.binding));
+            seed = hashCombine(seed, hashValue(attribute.format));
+            seed = hashCombine(seed, hashValue(attribute.offset));
+        }
+
+        uint32_t rasterState[] = {
+            static_cast<uint32_t>(topology), static_cast<uint32_t>(polygonMode), static_cast<uint32_t>(cullMode), static_cast<uint32_t>(frontFace),
+            static_cast<uint32_t>(blendEnable), static_cast<uint32_t>(srcColorBlendFactor), static_cast<uint32_t>(dstColorBlendFactor),
+            static_cast<uint32_t>(colorBlendOp), static_cast<uint32_t>(srcAlphaBlendFactor), static_cast<uint32_t>(dstAlphaBlendFactor),
+            static_cast<uint32_t>(alphaBlendOp), static_cast<uint32_t>(colorWriteMask),
+            static_cast<uint32_t>(depthTestEnable), static_cast<uint32_t>(depthWriteEnable), static_cast<uint32_t>(depthCompareOp)
+        };
+        seed = hashCombine(seed, hashValue(rasterState));
+
+        for (const auto& constant : specializationConstants)
+        {
+            seed = hashCombine(seed, hashValue(constant.id));
+            seed = hashCombine(seed, hashValue(constant.value));
+        }
+        return seed;
+    }
+
+    bool PipelineState::operator==(const PipelineState& other) const
+    {
+        auto sameBinding = [](const VkVertexInputBindingDescription& a, const VkVertexInputBindingDescription& b)
+        {
+            return a.binding == b.binding && a.stride == b.stride && a.inputRate == b.inputRate;
+        };
+        auto sameAttribute = [](const VkVertexInputAttributeDescription& a, const VkVertexInputAttributeDescription& b)
+        {
+            return a.location == b.location && a.binding == b.binding && a.format == b.format && a.offset == b.offset;
+        };
+
+        return shader == other.shader && renderPass == other.renderPass && subpass == other.subpass
+            && std::equal(vertexBindings.begin(), vertexBindings.end(), other.vertexBindings.begin(), other.vertexBindings.end(), sameBinding)
+            && std::equal(vertexAttributes.begin(), vertexAttributes.end(), other.vertexAttributes.begin(), other.vertexAttributes.end(), sameAttribute)
+            && topology == other.topology && polygonMode == other.polygonMode && cullMode == other.cullMode && frontFace == other.frontFace
+            && blendEnable == other.blendEnable && srcColorBlendFactor == other.srcColorBlendFactor && dstColorBlendFactor == other.dstColorBlendFactor
+            && colorBlendOp == other.colorBlendOp && srcAlphaBlendFactor == other.srcAlphaBlendFactor && dstAlphaBlendFactor == other.dstAlphaBlendFactor
+            && alphaBlendOp == other.alphaBlendOp && colorWriteMask == other.colorWriteMask
+            && depthTestEnable == other.depthTestEnable && depthWriteEnable == other.depthWriteEnable && depthCompareOp == other.depthCompareOp
+            && std::equal(specializationConstants.begin(), specializationConstants.end(), other.specializationConstants.begin(), other.specializationConstants.end(),
+                [](const SpecializationConstant& a, const SpecializationConstant& b) { return a.id == b.id && a.value == b.value; });
+    }
+
+    void PipelineState::specialize(uint32_t id, uint32_t value)
+    {
+        //kept sorted so the same constants set in any order hash the same
+        auto found = std::lower_bound(specializationConstants.begin(), specializationConstants.end(), id, [](const SpecializationConstant& constant, uint32_t searched)
+        {
+            return constant.id < searched;
+        });
+        if (found != specializationConstants.end() && found->id == id)
+        {
+            found->value = value;
+            return;
+        }
+        specializationConstants.insert(found, SpecializationConstant{ id, value });
+    }
+
+    void PipelineState::specialize(const std::string& name, uint32_t value)
+    {
+        CY_ASSERT(shader != nullptr);
+        specialize(shader->getSpecializationConstantId(name), value);
+    }
+
+    void PipelineState::specialize(const std::string& name, int32_t value)
+    {
+        specialize(name, static_cast<uint32_t>(value));
+    }
+
+    void PipelineState::specialize(const std::string& name, float value)
+    {
+        uint32_t bits = 0;
+        std::memcpy(&bits, &value, sizeof(bits));
+        specialize(name, bits);
+    }
+
+    void PipelineState::specialize(const std::string& name, bool value)
+    {
+        specialize(name, static_cast<uint32_t>(value ? VK_TRUE : VK_FALSE));
+    }
+
+    bool PipelineState::setVertexLayout(const VertexInputLayout& layout)
+    {
+        CY_ASSERT(shader != nullptr);
+        return layout.resolve(*shader, vertexBindings, vertexAttributes);
+    }
+
+    PipelineState PipelineState::createDefault(const Ref<VulkanShader>& shader, VkRenderPass renderPass, const VertexInputLayout& layout)
+    {
+        PipelineState state{};
+        state.shader = shader;
+        state.renderPass = renderPass;
+        if (!state.setVertexLayout(layout))
+        {
+            CY_ASSERT(false); //the shader reads a vertex input the layout does not have, resolve logged which
+        }
+        return state;
+    }
+
     /*
     * PUBLIC STATIC METHODS
     */
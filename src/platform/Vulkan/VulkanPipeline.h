@@ -5,6 +5,7 @@
 #include "VulkanDevice.h"
 #include "VulkanDescriptors.h"
 #include "VulkanShader.h"
+#include "VulkanBuffer.h"
 #include "../../core/core.h"
 #include "Fwd.hpp"
 
@@ -31,6 +32,92 @@ namespace cy3d
 		uint32_t width, height;  
 	};
 
+	/**
+	 * @brief The value of one specialization constant. Every constant is 32 bits wide, bools are VkBool32 and floats are
+	 * stored by their bits.
+	*/
+	struct SpecializationConstant
+	{
+		uint32_t id;
+		uint32_t value;
+	};
+
+	/**
+	 * @brief Packs specialization constants into a VkSpecializationInfo. The info points into this object, so it has to
+	 * live until the pipeline is created.
+	*/
+	struct SpecializationData
+	{
+		std::vector<VkSpecializationMapEntry> entries;
+		std::vector<uint32_t> values;
+		VkSpecializationInfo info{};
+
+		SpecializationData(const std::vector<SpecializationConstant>& constants);
+		CY_NOCOPY(SpecializationData);
+
+		//nullptr when there are no constants
+		const VkSpecializationInfo* get() const { return entries.empty() ? nullptr : &info; }
+	};
+
+	/**
+	 * @brief Everything that makes two graphics pipelines built from the same shader different. Viewport and scissor are
+	 * not part of it because they do not change the pipeline's identity.
+	*/
+	struct PipelineState
+	{
+		Ref<VulkanShader> shader{ nullptr };
+		VkRenderPass renderPass{ VK_NULL_HANDLE };
+		uint32_t subpass{ 0 };
+
+		std::vector<VkVertexInputBindingDescription> vertexBindings;
+		std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+
+		VkPrimitiveTopology topology{ VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST };
+		VkPolygonMode polygonMode{ VK_POLYGON_MODE_FILL };
+		VkCullModeFlags cullMode{ VK_CULL_MODE_BACK_BIT };
+		VkFrontFace frontFace{ VK_FRONT_FACE_COUNTER_CLOCKWISE };
+
+		bool blendEnable{ false };
+		VkBlendFactor srcColorBlendFactor{ VK_BLEND_FACTOR_ONE };
+		VkBlendFactor dstColorBlendFactor{ VK_BLEND_FACTOR_ZERO };
+		VkBlendOp colorBlendOp{ VK_BLEND_OP_ADD };
+		VkBlendFactor srcAlphaBlendFactor{ VK_BLEND_FACTOR_ONE };
+		VkBlendFactor dstAlphaBlendFactor{ VK_BLEND_FACTOR_ZERO };
+		VkBlendOp alphaBlendOp{ VK_BLEND_OP_ADD };
+		VkColorComponentFlags colorWriteMask{ VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT };
+
+		bool depthTestEnable{ true };
+		bool depthWriteEnable{ true };
+		VkCompareOp depthCompareOp{ VK_COMPARE_OP_LESS };
+
+		//sorted by id, applied to every stage. A stage ignores the ids it does not declare
+		std::vector<SpecializationConstant> specializationConstants;
+
+		/**
+		 * @brief Replaces the vertex bindings and attributes with the ones layout resolves to for shader. Has to be called
+		 * again when shader is replaced, the inputs of the new shader may differ.
+		*/
+		bool setVertexLayout(const VertexInputLayout& layout);
+
+		/**
+		 * @brief Sets the specialization constant of shader called name, or the one with id.
+		*/
+		void specialize(uint32_t id, uint32_t value);
+		void specialize(const std::string& name, uint32_t value);
+		void specialize(const std::string& name, int32_t value);
+		void specialize(const std::string& name, float value);
+		void specialize(const std::string& name, bool value);
+
+		uint64_t hash() const;
+		bool operator==(const PipelineState& other) const;
+		bool operator!=(const PipelineState& other) const { return !(*this == other); }
+
+		/**
+		 * @brief The state defaultPipelineConfigInfo describes with the vertex inputs of shader resolved against layout.
+		*/
+		static PipelineState createDefault(const Ref<VulkanShader>& shader, VkRenderPass renderPass, const VertexInputLayout& layout = Vertex::getLayout());
+	};
+
 	struct PipelineConfigInfo
 	{
 		PipelineConfigInfo() = default;
@@ -79,14 +166,15 @@ namespace cy3d
 		//VulkanDevice& cyDevice;
 		VulkanContext& _context;
 		VkPipeline graphicsPipeline{ nullptr };
-		VkPipelineLayout _pipelineLayout{ nullptr };
+		//shared with every pipeline whose shader uses the same layouts
+		Ref<VulkanPipelineLayout> _pipelineLayout{ nullptr };
 
-		std::vector<VkPipelineShaderStageCreateInfo> _shaderStages;
-		std::vector<VkDescriptorSetLayout> _descriptorSetLayouts;
+		PipelineState _state;
 
 
 	public:
 		VulkanPipeline(VulkanContext& context, const Ref<VulkanShader>& shader, const PipelineSpec& spec);
+		VulkanPipeline(VulkanContext& context, const PipelineState& state);
 		~VulkanPipeline();
 
 		//delete copy methods
@@ -98,16 +186,17 @@ namespace cy3d
 		bool recreate(const PipelineSpec& spec);
 		void bind(VkCommandBuffer commandBuffer);
 		VkPipeline getGraphicsPipeline() { return graphicsPipeline; }
-		VkPipelineLayout getPipelineLayout() { return _pipelineLayout; }
+		VkPipelineLayout getPipelineLayout() { return _pipelineLayout->getLayout(); }
+		const PipelineState& getState() const { return _state; }
 		/*
 		* PUBLIC STATIC METHODS
 		*/
 		static void defaultPipelineConfigInfo(const PipelineSpec& spec, PipelineConfigInfo& outConfig);
 
 	private:
-		void init(const Ref<VulkanShader>& shader, const PipelineSpec& spec);
+		void init();
 		void createLayout();
-		void createGraphicsPipeline(const PipelineSpec& spec);
+		void createGraphicsPipeline();
 		void cleanup();
 	};
 }
@@ -0,0 +1,163 @@
+#include "pch.h"
+
+#include "VulkanPipelineCache.h"
+#include "VulkanDevice.h"
+
+namespace cy3d
+{
+    VulkanPipelineCache::VulkanPipelineCache(VulkanContext& context, const std::string& path)
+        : _context(context), _path(path), _ownerThread(std::this_thread::get_id())
+    {
+        std::vector<char> data{};
+        if (readFile(data) && !isCompatible(data))
+        {
+            CY_BASE_LOG_INFO("Pipeline cache {0} was created by a different device or driver and will be rebuilt.", _path);
+            data.clear();
+        }
+        _cache = createCache(data);
+    }
+
+    VulkanPipelineCache::~VulkanPipelineCache()
+    {
+        save();
+        for (auto [thread, cache] : _threadCaches)
+        {
+            vkDestroyPipelineCache(_context.getDevice()->device(), cache, nullptr);
+        }
+        vkDestroyPipelineCache(_context.getDevice()->device(), _cache, nullptr);
+    }
+
+    VkPipelineCache VulkanPipelineCache::get()
+    {
+        std::thread::id thread = std::this_thread::get_id();
+        if (thread == _ownerThread)
+        {
+            return _cache;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto found = _threadCaches.find(thread);
+        if (found != _threadCaches.end())
+        {
+            return found->second;
+        }
+        VkPipelineCache cache = createCache({});
+        _threadCaches[thread] = cache;
+        return cache;
+    }
+
+    /**
+     * @brief Merges every per thread cache into the main cache. The per thread caches are left in place, merging them
+     * again later only adds what they learned since.
+     * No other thread may be creating pipelines while this runs.
+    */
+    void VulkanPipelineCache::merge()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_threadCaches.empty())
+        {
+            return;
+        }
+
+        std::vector<VkPipelineCache> sources;
+        sources.reserve(_threadCaches.size());
+        for (auto [thread, cache] : _threadCaches)
+        {
+            sources.push_back(cache);
+        }
+        VK_CHECK(vkMergePipelineCaches(_context.getDevice()->device(), _cache, static_cast<uint32_t>(sources.size()), sources.data()));
+    }
+
+    /**
+     * @brief Writes the merged cache to a temporary file first and then renames it over the old one,
+     * so a crash while saving never leaves a truncated cache behind.
+    */
+    bool VulkanPipelineCache::save()
+    {
+        merge();
+
+        std::size_t size = 0;
+        VK_CHECK(vkGetPipelineCacheData(_context.getDevice()->device(), _cache, &size, nullptr));
+        std::vector<char> data(size);
+        VK_CHECK(vkGetPipelineCacheData(_context.getDevice()->device(), _cache, &size, data.data()));
+
+        std::filesystem::path path(_path);
+        std::error_code error;
+        if (path.has_parent_path())
+        {
+            std::filesystem::create_directories(path.parent_path(), error);
+        }
+
+        std::filesystem::path tempPath = path;
+        tempPath += ".tmp";
+        std::ofstream fout(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!fout.is_open())
+        {
+            CY_BASE_LOG_ERROR("Failed to open {0} to save the pipeline cache.", tempPath.string());
+            return false;
+        }
+        fout.write(data.data(), size);
+        fout.close();
+
+        std::filesystem::rename(tempPath, path, error);
+        if (error)
+        {
+            CY_BASE_LOG_ERROR("Failed to save the pipeline cache to {0}: {1}", _path, error.message());
+            return false;
+        }
+        CY_BASE_LOG_INFO("Saved {0} bytes of pipeline cache to {1}", size, _path);
+        return true;
+    }
+
+    VkPipelineCache VulkanPipelineCache::createCache(const std::vector<char>& initialData)
+    {
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = initialData.size();
+        cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+        VkPipelineCache cache;
+        VK_CHECK(vkCreatePipelineCache(_context.getDevice()->device(), &cacheInfo, nullptr, &cache));
+        return cache;
+    }
+
+    bool VulkanPipelineCache::readFile(std::vector<char>& outData)
+    {
+        std::ifstream fin(_path, std::ios::in | std::ios::binary | std::ios::ate);
+        if (!fin.is_open())
+        {
+            return false;
+        }
+        std::streamsize size = fin.tellg();
+        fin.seekg(0, std::ios::beg);
+        outData.resize(static_cast<std::size_t>(size));
+        fin.read(outData.data(), size);
+        return fin.good();
+    }
+
+    /**
+     * @brief Checks the VK_PIPELINE_CACHE_HEADER_VERSION_ONE header. Drivers are required to reject incompatible data
+     * themselves but some have been known not to, so the blob is only handed to the driver if it was made by the same
+     * vendor, device and driver.
+     *
+     * Header layout: header size, header version, vendor id, device id (4 bytes each) then the 16 byte cache UUID.
+    */
+    bool VulkanPipelineCache::isCompatible(const std::vector<char>& data)
+    {
+        constexpr std::size_t headerSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+        if (data.size() < headerSize)
+        {
+            return false;
+        }
+
+        uint32_t header[4];
+        std::memcpy(header, data.data(), sizeof(header));
+        const VkPhysicalDeviceProperties& properties = _context.getDevice()->properties;
+
+        return header[0] >= headerSize
+            && header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+            && header[2] == properties.vendorID
+            && header[3] == properties.deviceID
+            && std::memcmp(data.data() + 4 * sizeof(uint32_t), properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+}
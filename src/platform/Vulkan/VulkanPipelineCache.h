@@ -0,0 +1,49 @@
+#pragma once
+#include "pch.h"
+
+#include "Vulkan.h"
+#include "VulkanContext.h"
+#include "Fwd.hpp"
+
+namespace cy3d
+{
+	constexpr auto PIPELINE_CACHE_PATH = "resources/cache/pipelines.bin";
+
+	/**
+	 * @brief Owns the VkPipelineCache every pipeline is created with and persists it between runs.
+	 *
+	 * The cache is loaded from disk on creation if its header matches the current vendor, device and driver cache UUID,
+	 * a blob from another gpu or driver is ignored and an empty cache is created instead. Threads other than the one that
+	 * created the cache get their own cache so parallel pipeline compiles do not contend on one cache, those caches are
+	 * merged back into the main cache with merge(). On destruction everything is merged and written back to disk.
+	*/
+	class VulkanPipelineCache
+	{
+	private:
+		VulkanContext& _context;
+		std::string _path;
+		VkPipelineCache _cache{ VK_NULL_HANDLE };
+		std::thread::id _ownerThread;
+
+		std::mutex _mutex;
+		std::unordered_map<std::thread::id, VkPipelineCache> _threadCaches;
+
+	public:
+		VulkanPipelineCache(VulkanContext& context, const std::string& path = PIPELINE_CACHE_PATH);
+		~VulkanPipelineCache();
+
+		CY_NOCOPY(VulkanPipelineCache);
+
+		/**
+		 * @brief Returns the cache the calling thread should create its pipelines with.
+		*/
+		VkPipelineCache get();
+		void merge();
+		bool save();
+
+	private:
+		VkPipelineCache createCache(const std::vector<char>& initialData);
+		bool readFile(std::vector<char>& outData);
+		bool isCompatible(const std::vector<char>& data);
+	};
+}
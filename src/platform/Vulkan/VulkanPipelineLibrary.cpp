@@ -0,0 +1,217 @@
+#include "pch.h"
+
+#include "VulkanPipelineLibrary.h"
+#include "VulkanDeletionQueue.h"
+#include "../../core/ThreadPool.h"
+
+namespace cy3d
+{
+    VulkanPipelineLibrary::VulkanPipelineLibrary(VulkanContext& context) : _context(context)
+    {
+
+    }
+
+    VulkanPipelineLibrary::~VulkanPipelineLibrary()
+    {
+        //the workers reference the shaders and render passes so they have to finish first
+        waitForPending();
+    }
+
+    VulkanPipelineLibrary::Entry* VulkanPipelineLibrary::find(const PipelineState& state)
+    {
+        //states whose hashes collide share a key, so the state itself decides which entry is the right one
+        auto range = _entries.equal_range(state.hash());
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            //the caller may still hold the shader a reload replaced, the entry always has the current one
+            PipelineState current = state;
+            current.shader = it->second.state.shader;
+            if (it->second.state == current && current.shader->getName() == state.shader->getName())
+            {
+                return &it->second;
+            }
+        }
+        return nullptr;
+    }
+
+    VulkanPipelineLibrary::Entry& VulkanPipelineLibrary::findOrAdd(const PipelineState& state, bool& outAdded)
+    {
+        Entry* found = find(state);
+        outAdded = found == nullptr;
+        if (!outAdded)
+        {
+            return *found;
+        }
+
+        Entry& entry = _entries.emplace(state.hash(), Entry{})->second;
+        entry.state = state;
+        return entry;
+    }
+
+    VulkanPipeline* VulkanPipelineLibrary::get(const PipelineState& state, const PipelineState& fallback)
+    {
+        //a reloaded shader may not be ready yet, so the fallback may still hold the previous version of it
+        CY_ASSERT(state.shader->getName() == fallback.shader->getName());
+        prepare(state);
+
+        Entry* entry = find(state);
+        if (entry->pipeline != nullptr)
+        {
+            return entry->pipeline.get();
+        }
+        return getBlocking(fallback);
+    }
+
+    VulkanPipeline* VulkanPipelineLibrary::getBlocking(const PipelineState& state)
+    {
+        bool added = false;
+        Entry& entry = findOrAdd(state, added);
+        if (entry.pipeline == nullptr)
+        {
+            if (entry.pending.valid())
+            {
+                entry.pipeline = entry.pending.get();
+            }
+            else
+            {
+                entry.pipeline.reset(new VulkanPipeline(_context, state));
+            }
+        }
+        return entry.pipeline.get();
+    }
+
+    void VulkanPipelineLibrary::prepare(const PipelineState& state)
+    {
+        bool added = false;
+        Entry& entry = findOrAdd(state, added);
+        if (!added)
+        {
+            return;
+        }
+
+        CY_BASE_LOG_INFO("Compiling pipeline variant {0:x} of shader {1} in the background.", state.hash(), state.shader->getName());
+        compile(entry);
+    }
+
+    void VulkanPipelineLibrary::compile(Entry& entry)
+    {
+        VulkanContext* context = &_context;
+        PipelineState state = entry.state;
+        entry.pending = _context.getThreadPool()->submit([context, state]()
+        {
+            return Scope<VulkanPipeline>(new VulkanPipeline(*context, state));
+        });
+    }
+
+    void VulkanPipelineLibrary::collect()
+    {
+        for (auto& [key, entry] : _entries)
+        {
+            if (entry.pending.valid() && entry.pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            {
+                retirePipeline(std::move(entry.pipeline));
+                entry.pipeline = entry.pending.get();
+            }
+        }
+    }
+
+    bool VulkanPipelineLibrary::reloadShader(const Ref<VulkanShader>& shader)
+    {
+        bool reloaded = true;
+        for (auto& [key, entry] : _entries)
+        {
+            if (entry.state.shader->getName() != shader->getName())
+            {
+                continue;
+            }
+            if (!feedsVertexInputs(entry.state, *shader))
+            {
+                CY_BASE_LOG_ERROR("Pipeline variant {0:x} of shader {1} keeps the previous version, its vertex layout does not feed the reloaded inputs.",
+                    key, shader->getName());
+                reloaded = false;
+                continue;
+            }
+
+            //a rebuild of the previous version that is still running is finished first so its pipeline can be retired
+            if (entry.pending.valid())
+            {
+                retirePipeline(std::move(entry.pipeline));
+                entry.pipeline = entry.pending.get();
+            }
+            entry.state.shader = shader;
+            compile(entry);
+        }
+        return reloaded;
+    }
+
+    /**
+     * @brief Every vertex input of shader needs an attribute at its location, the attributes were resolved for the
+     * inputs of the previous version.
+    */
+    bool VulkanPipelineLibrary::feedsVertexInputs(const PipelineState& state, const VulkanShader& shader)
+    {
+        for (const auto& input : shader.getVertexInputs())
+        {
+            bool fed = std::any_of(state.vertexAttributes.begin(), state.vertexAttributes.end(),
+                [&input](const VkVertexInputAttributeDescription& attribute) { return attribute.location == input.location; });
+            if (!fed)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool VulkanPipelineLibrary::isReady(const PipelineState& state)
+    {
+        Entry* found = find(state);
+        return found != nullptr && found->pipeline != nullptr;
+    }
+
+    void VulkanPipelineLibrary::clear()
+    {
+        waitForPending();
+        _entries.clear();
+    }
+
+    void VulkanPipelineLibrary::retire(VkRenderPass renderPass)
+    {
+        for (auto it = _entries.begin(); it != _entries.end();)
+        {
+            if (it->second.state.renderPass != renderPass)
+            {
+                ++it;
+                continue;
+            }
+
+            //a background compile references the render pass so it has to finish first
+            if (it->second.pending.valid())
+            {
+                retirePipeline(it->second.pending.get());
+            }
+            retirePipeline(std::move(it->second.pipeline));
+            it = _entries.erase(it);
+        }
+    }
+
+    void VulkanPipelineLibrary::retirePipeline(Scope<VulkanPipeline> pipeline)
+    {
+        if (pipeline == nullptr)
+        {
+            return;
+        }
+        std::shared_ptr<VulkanPipeline> retired(std::move(pipeline));
+        _context.getDeletionQueue()->push([retired]() {});
+    }
+
+    void VulkanPipelineLibrary::waitForPending()
+    {
+        for (auto& [key, entry] : _entries)
+        {
+            if (entry.pending.valid())
+            {
+                entry.pipeline = entry.pending.get();
+            }
+        }
+    }
+}
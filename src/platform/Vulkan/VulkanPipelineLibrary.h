@@ -0,0 +1,96 @@
+#pragma once
+#include "pch.h"
+
+#include "Vulkan.h"
+#include "VulkanContext.h"
+#include "VulkanPipeline.h"
+#include "Fwd.hpp"
+
+namespace cy3d
+{
+	/**
+	 * @brief Every graphics pipeline variant keyed by the hash of its PipelineState.
+	 *
+	 * get() never blocks on a missing variant. It queues the variant on the thread pool and hands back the fallback,
+	 * which is compiled synchronously the first time it is needed, until the variant has finished. The fallback has to be
+	 * built from the same shader as the variant, or a previous version of it, and should already be ready so get() never
+	 * waits. Callers take the descriptor set layouts from the pipeline they were handed.
+	 *
+	 * Entries are keyed by shader name, not by shader instance, so a reloaded shader replaces the shader of its existing
+	 * entries and callers pick up the new pipelines without changing their PipelineState. Entries whose vertex layout does
+	 * not fit the reloaded shader keep the previous one, see reloadShader.
+	 *
+	 * Only the render thread may call into the library, the worker threads only ever construct the VulkanPipeline.
+	*/
+	class VulkanPipelineLibrary
+	{
+	private:
+		struct Entry
+		{
+			PipelineState state;
+			Scope<VulkanPipeline> pipeline{ nullptr };
+			std::future<Scope<VulkanPipeline>> pending;
+		};
+
+		VulkanContext& _context;
+		//a multimap so states whose hashes collide each keep their own entry
+		std::unordered_multimap<uint64_t, Entry> _entries;
+
+	public:
+		VulkanPipelineLibrary(VulkanContext& context);
+		~VulkanPipelineLibrary();
+
+		CY_NOCOPY(VulkanPipelineLibrary);
+
+		/**
+		 * @brief Returns the variant for state if it has been compiled, otherwise queues it and returns the fallback.
+		*/
+		VulkanPipeline* get(const PipelineState& state, const PipelineState& fallback);
+
+		/**
+		 * @brief Returns the variant for state, compiling it on the calling thread if needed.
+		*/
+		VulkanPipeline* getBlocking(const PipelineState& state);
+
+		/**
+		 * @brief Queues state to be compiled in the background without using it yet.
+		*/
+		void prepare(const PipelineState& state);
+
+		/**
+		 * @brief Moves background compiles that have finished into the library. Call once per frame.
+		*/
+		void collect();
+
+		/**
+		 * @brief Destroys every pipeline. The caller has to make sure none of them are still in use by the gpu.
+		*/
+		void clear();
+
+		/**
+		 * @brief Removes every pipeline built against renderPass. Their destruction is deferred through the deletion queue
+		 * so frames still in flight can keep using them.
+		*/
+		void retire(VkRenderPass renderPass);
+
+		/**
+		 * @brief Rebuilds every pipeline of the shader with the same name as shader in the background. The current pipelines
+		 * keep being handed out until their replacements are collected and are then destroyed through the deletion queue.
+		 *
+		 * An entry whose vertex attributes do not feed every vertex input of shader keeps its previous shader and pipeline.
+		 * Returns false if any entry did, its owner has to resolve a new vertex layout for shader to use it.
+		*/
+		bool reloadShader(const Ref<VulkanShader>& shader);
+
+		bool isReady(const PipelineState& state);
+
+	private:
+		Entry* find(const PipelineState& state);
+		Entry& findOrAdd(const PipelineState& state, bool& outAdded);
+		static bool feedsVertexInputs(const PipelineState& state, const VulkanShader& shader);
+		void compile(Entry& entry);
+		//destruction is deferred through the deletion queue so frames still in flight can keep using the pipeline
+		void retirePipeline(Scope<VulkanPipeline> pipeline);
+		void waitForPending();
+	};
+}
@@ -3,6 +3,11 @@
 #include "VulkanRenderer.h"
 #include "VulkanDevice.h"
 #include "VulkanSwapChain.h"
+#include "VulkanDeletionQueue.h"
+#include "VulkanDescriptors.h"
+#include "VulkanDescriptorSetCache.h"
+#include "../../core/ThreadPool.h"
+#include "../../core/Profiler.h"
 
 
 namespace cy3d
@@ -14,19 +19,12 @@ namespace cy3d
 
 	VulkanRenderer::~VulkanRenderer()
 	{
-        cleanup();
+        for (VkSemaphore semaphore : computeFinishedSemaphores)
+        {
+            vkDestroySemaphore(cyContext.getDevice()->device(), semaphore, nullptr);
+        }
 	}
 
-    void VulkanRenderer::cleanup()
-    {
-        vkFreeCommandBuffers(
-            cyContext.getDevice()->device(), 
-            cyContext.getDevice()->getCommandPool(), 
-            static_cast<uint32_t>(commandBuffers.size()), 
-            commandBuffers.data()
-        );
-    }
-
 	void VulkanRenderer::beginFrame()
 	{
 
@@ -52,27 +50,44 @@ namespace cy3d
         //the isFrameStart == false to fail
         isFrameStarted = true;
 
+        //acquireNextImage waited on this frame's fence so none of its command buffers are in use anymore.
+        resetFrameCommandPools();
+        //and every frame before it has completed as well, so anything retired MAX_FRAMES_IN_FLIGHT frames ago can go.
+        cyContext.getDeletionQueue()->nextFrame();
+        cyContext.getDescriptorSetCache()->nextFrame();
+        cyContext.getFrameDescriptorAllocator()->nextFrame();
+        currentCommandBuffer = allocateFrameCommandBuffer();
+
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
         VK_CHECK(vkBeginCommandBuffer(getCurrentCommandBuffer(), &beginInfo));
+        gpuProfiler->beginFrame(getCurrentCommandBuffer());
 	}
 
 	void VulkanRenderer::endFrame()
 	{
         CY_ASSERT(isFrameStarted == true);
+        CY_ASSERT(currentComputeCommandBuffer == VK_NULL_HANDLE); //beginAsyncCompute without submitAsyncCompute
+        gpuProfiler->endFrame(getCurrentCommandBuffer());
         VK_CHECK(vkEndCommandBuffer(getCurrentCommandBuffer()));
 
-        VkResult res = cyContext.getSwapChain()->submitCommandBuffers(&getCurrentCommandBuffer(), &currentImageIndex);
+        //without a dedicated queue the compute work was already submitted ahead of this buffer on the graphics queue
+        bool waitOnCompute = hasAsyncCompute() && computeWaitStages != 0;
+        VkResult res = cyContext.getSwapChain()->submitCommandBuffers(&getCurrentCommandBuffer(), &currentImageIndex,
+            waitOnCompute ? computeFinishedSemaphores[cyContext.getCurrentFrameIndex()] : VK_NULL_HANDLE, computeWaitStages);
+        computeWaitStages = 0;
         
         /**
          * If the swap chain turns out to be out of date when attempting to acquire an image,
          * then it is no longer possible to present to it. Therefore we should immediately recreate
          * the swap chain and try again in the next drawFrame call.
         */
-        if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR || cyContext.getWindow()->isWindowFrameBufferResized())
+        bool windowResized = !cyContext.isHeadless() && cyContext.getWindow()->isWindowFrameBufferResized();
+        if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR || windowResized)
         {
-            cyContext.getWindow()->resetWindowFrameBufferResizedFlag();
+            if (windowResized) cyContext.getWindow()->resetWindowFrameBufferResizedFlag();
             recreateSwapChain();
         }
 
@@ -87,9 +102,16 @@ namespace cy3d
         currentFrameIndex = (currentFrameIndex + 1) % VulkanSwapChain::MAX_FRAMES_IN_FLIGHT;
 	}
 
-    void VulkanRenderer::beginRenderPass(VkRenderPass& renderPass)
+    /**
+     * @brief Begins the render pass on the primary command buffer. When contents is VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+     * the only command that can be recorded into the primary buffer until endRenderPass is vkCmdExecuteCommands, so
+     * draws have to be recorded through recordParallel.
+    */
+    void VulkanRenderer::beginRenderPass(VkRenderPass& renderPass, VkSubpassContents contents)
     {
         CY_ASSERT(isFrameStarted == true);
+        currentRenderPass = renderPass;
+        currentSubpassContents = contents;
 
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -105,69 +127,294 @@ namespace cy3d
         renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
         renderPassInfo.pClearValues = clearValues.data();
 
-        vkCmdBeginRenderPass(getCurrentCommandBuffer(), &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdBeginRenderPass(getCurrentCommandBuffer(), &renderPassInfo, contents);
 
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = static_cast<float>(cyContext.getSwapChain()->getSwapChainExtent().width);
-        viewport.height = static_cast<float>(cyContext.getSwapChain()->getSwapChainExtent().height);
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        VkRect2D scissor{ {0, 0}, cyContext.getSwapChain()->getSwapChainExtent() };
-        vkCmdSetViewport(getCurrentCommandBuffer(), 0, 1, &viewport);
-        vkCmdSetScissor(getCurrentCommandBuffer(), 0, 1, &scissor);
+        //secondary command buffers do not inherit dynamic state so they set their own
+        if (contents == VK_SUBPASS_CONTENTS_INLINE)
+        {
+            setViewportAndScissor(getCurrentCommandBuffer());
+        }
     }
 
     void VulkanRenderer::endRenderPass()
     {
         CY_ASSERT(isFrameStarted == true);
 
-        vkCmdEndRenderPass(commandBuffers[cyContext.getCurrentFrameIndex()]);
+        vkCmdEndRenderPass(getCurrentCommandBuffer());
+        currentRenderPass = VK_NULL_HANDLE;
+        currentSubpassContents = VK_SUBPASS_CONTENTS_INLINE;
+    }
+
+    /**
+     * @brief Splits itemCount items into contiguous ranges and records each range into its own secondary command buffer
+     * on the thread pool. The calling thread records the first range itself. The secondary buffers are executed in range
+     * order so the result is identical to recording every item in order on one thread. Each range is timed as a gpu
+     * scope named scopeName followed by the range index.
+     *
+     * Must be called inside a render pass that was begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+    */
+    void VulkanRenderer::recordParallel(uint32_t itemCount, const secondary_record_fn& record, const std::string& scopeName)
+    {
+        CY_ASSERT(isFrameStarted == true);
+        CY_ASSERT(currentRenderPass != VK_NULL_HANDLE);
+        CY_ASSERT(currentSubpassContents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+        if (itemCount == 0)
+        {
+            return;
+        }
+
+        std::vector<Scope<VulkanCommandPool>>& workers = workerPools[cyContext.getCurrentFrameIndex()];
+        uint32_t rangeCount = (itemCount + MIN_ITEMS_PER_WORKER - 1) / MIN_ITEMS_PER_WORKER;
+        rangeCount = std::min(rangeCount, static_cast<uint32_t>(workers.size()));
+        uint32_t itemsPerRange = (itemCount + rangeCount - 1) / rangeCount;
+
+        std::vector<VkCommandBuffer> secondaryBuffers(rangeCount, VK_NULL_HANDLE);
+        auto recordRange = [&](uint32_t rangeIndex)
+        {
+            uint32_t begin = rangeIndex * itemsPerRange;
+            uint32_t end = std::min(begin + itemsPerRange, itemCount);
+            VkCommandBuffer commandBuffer = beginSecondaryCommandBuffer(*workers[rangeIndex]);
+            //the range index doubles as the worker index, no two ranges share a pool or a query range
+            gpuProfiler->beginWorkerScope(rangeIndex, commandBuffer, scopeName + " " + std::to_string(rangeIndex));
+            record(commandBuffer, begin, end);
+            gpuProfiler->endWorkerScope(rangeIndex, commandBuffer);
+            VK_CHECK(vkEndCommandBuffer(commandBuffer));
+            secondaryBuffers[rangeIndex] = commandBuffer;
+        };
+
+        std::vector<std::future<void>> pending;
+        pending.reserve(rangeCount);
+        for (uint32_t rangeIndex = 1; rangeIndex < rangeCount; rangeIndex++)
+        {
+            pending.push_back(cyContext.getThreadPool()->submit([&recordRange, rangeIndex]() { recordRange(rangeIndex); }));
+        }
+        recordRange(0);
+
+        for (auto& future : pending)
+        {
+            future.get();
+        }
+
+        vkCmdExecuteCommands(getCurrentCommandBuffer(), static_cast<uint32_t>(secondaryBuffers.size()), secondaryBuffers.data());
+    }
+
+    /**
+     * @brief Binds pipeline with sets starting at set 0 and records a dispatch of x * y * z workgroups. Records into the
+     * frame's primary command buffer unless commandBuffer is given, which has to be the case inside a render pass since
+     * dispatches can not be recorded there. Barriers between the dispatch and whatever consumes its results are left
+     * to the caller.
+    */
+    void VulkanRenderer::dispatch(VulkanComputePipeline& pipeline, const std::vector<VkDescriptorSet>& sets, uint32_t x, uint32_t y, uint32_t z,
+        VkCommandBuffer commandBuffer)
+    {
+        CY_ASSERT(isFrameStarted == true);
+        if (commandBuffer == VK_NULL_HANDLE)
+        {
+            CY_ASSERT(currentRenderPass == VK_NULL_HANDLE);
+            commandBuffer = getCurrentCommandBuffer();
+        }
+
+        pipeline.bind(commandBuffer);
+        pipeline.bindDescriptorSets(commandBuffer, sets);
+        pipeline.dispatch(commandBuffer, x, y, z);
+    }
+
+    /**
+     * @brief Begins a command buffer for compute work that does not depend on anything recorded this frame, such as
+     * simulation or skinning for the next frame. With a dedicated compute family it runs on the compute queue alongside
+     * the graphics work, otherwise it is submitted to the graphics queue ahead of the frame. Only dispatches, copies and
+     * barriers may be recorded into it.
+     *
+     * Buffers the graphics queue reads after the compute queue wrote them have to be created with
+     * BufferCreateInfo::setConcurrent and images with ImageCreateInfo::setConcurrent. One async compute batch per frame.
+    */
+    VkCommandBuffer VulkanRenderer::beginAsyncCompute()
+    {
+        CY_ASSERT(isFrameStarted == true);
+        CY_ASSERT(currentComputeCommandBuffer == VK_NULL_HANDLE);
+        CY_ASSERT(computeWaitStages == 0); //only one async compute batch per frame
+
+        currentComputeCommandBuffer = hasAsyncCompute()
+            ? computePools[cyContext.getCurrentFrameIndex()]->allocate()
+            : allocateFrameCommandBuffer();
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK(vkBeginCommandBuffer(currentComputeCommandBuffer, &beginInfo));
+        return currentComputeCommandBuffer;
+    }
+
+    /**
+     * @brief Submits the buffer begun by beginAsyncCompute. The frame's graphics work waits for it at waitStages, so
+     * everything the compute work wrote is visible to those stages without further barriers.
+    */
+    void VulkanRenderer::submitAsyncCompute(VkPipelineStageFlags waitStages)
+    {
+        CY_PROFILE_FUNCTION();
+        CY_ASSERT(currentComputeCommandBuffer != VK_NULL_HANDLE);
+        CY_ASSERT(waitStages != 0);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &currentComputeCommandBuffer;
+
+        if (hasAsyncCompute())
+        {
+            VK_CHECK(vkEndCommandBuffer(currentComputeCommandBuffer));
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &computeFinishedSemaphores[cyContext.getCurrentFrameIndex()];
+            //the frame's fence covers this submission too because the graphics submission waits on it
+            VK_CHECK(vkQueueSubmit(cyContext.getDevice()->computeQueue(), 1, &submitInfo, VK_NULL_HANDLE));
+        }
+        else
+        {
+            //a barrier applies to everything later in submission order, including the frame's own command buffer
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+            vkCmdPipelineBarrier(currentComputeCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, waitStages,
+                0, 1, &barrier, 0, nullptr, 0, nullptr);
+            VK_CHECK(vkEndCommandBuffer(currentComputeCommandBuffer));
+            VK_CHECK(vkQueueSubmit(cyContext.getDevice()->graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE));
+        }
+
+        computeWaitStages = waitStages;
+        currentComputeCommandBuffer = VK_NULL_HANDLE;
     }
 
 	void VulkanRenderer::init()
 	{
-		createCommandBuffers(); 
+		createCommandPools();
+		createComputeSemaphores();
+		gpuProfiler.reset(new VulkanGPUProfiler(cyContext, workerCount()));
 	}
 
     /**
-    * @brief Allocates and records the commands for each swap chain image.
+     * @brief Hands out a command buffer from the current frame's pool. The buffer is only valid until the
+     * frame's pool is reset, which happens the next time this frame index is started.
     */
-	void VulkanRenderer::createCommandBuffers()
-	{
-        commandBuffers.resize(VulkanSwapChain::MAX_FRAMES_IN_FLIGHT);
+    VkCommandBuffer VulkanRenderer::allocateFrameCommandBuffer(VkCommandBufferLevel level)
+    {
+        return framePools[cyContext.getCurrentFrameIndex()]->allocate(level);
+    }
 
-        VkCommandBufferAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    /**
+     * @brief Creates a command pool for every frame in flight plus one pool per worker for every frame in flight.
+     * All of them allocate from the graphics queue family. Devices with a dedicated compute family get one more
+     * pool per frame for async compute.
+    */
+	void VulkanRenderer::createCommandPools()
+	{
+        uint32_t graphicsFamily = cyContext.getDevice()->findPhysicalQueueFamilies().graphicsFamily.value();
+        //one extra worker for the thread that calls recordParallel
+        std::size_t workerCount = cyContext.getThreadPool()->size() + 1;
 
-        /**
-         * The level parameter specifies if the allocated command buffers are primary or secondary command buffers.
+        framePools.resize(VulkanSwapChain::MAX_FRAMES_IN_FLIGHT);
+        workerPools.resize(VulkanSwapChain::MAX_FRAMES_IN_FLIGHT);
+        for (std::size_t frame = 0; frame < VulkanSwapChain::MAX_FRAMES_IN_FLIGHT; frame++)
+        {
+            framePools[frame].reset(new VulkanCommandPool(cyContext, graphicsFamily));
 
-         * VK_COMMAND_BUFFER_LEVEL_PRIMARY: Can be submitted to a queue for execution, but cannot be called from other command buffers.
-         * VK_COMMAND_BUFFER_LEVEL_SECONDARY: Cannot be submitted directly, but can be called from primary command buffers.
-        */
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = cyContext.getDevice()->getCommandPool();
-        allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+            workerPools[frame].resize(workerCount);
+            for (auto& worker : workerPools[frame])
+            {
+                worker.reset(new VulkanCommandPool(cyContext, graphicsFamily));
+            }
+        }
 
-        VK_CHECK(vkAllocateCommandBuffers(cyContext.getDevice()->device(), &allocInfo, commandBuffers.data()));
+        QueueFamilyIndices indices = cyContext.getDevice()->findPhysicalQueueFamilies();
+        if (cyContext.getDevice()->hasAsyncCompute() && indices.computeFamily.has_value())
+        {
+            computePools.resize(VulkanSwapChain::MAX_FRAMES_IN_FLIGHT);
+            for (auto& pool : computePools)
+            {
+                pool.reset(new VulkanCommandPool(cyContext, indices.computeFamily.value()));
+            }
+        }
 	}
 
-    void VulkanRenderer::recreateSwapChain()
+    void VulkanRenderer::createComputeSemaphores()
     {
-        //if window is currently minimized block
-        cyContext.getWindow()->blockWhileWindowMinimized();
+        if (!hasAsyncCompute())
+        {
+            return;
+        }
 
-        //make sure nothing is currently being used 
-        //before cleaning up.
-        vkDeviceWaitIdle(cyContext.getDevice()->device());
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        computeFinishedSemaphores.resize(VulkanSwapChain::MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+        for (auto& semaphore : computeFinishedSemaphores)
+        {
+            VK_CHECK(vkCreateSemaphore(cyContext.getDevice()->device(), &semaphoreInfo, nullptr, &semaphore));
+        }
+    }
 
-        cyContext.getSwapChain()->reCreate();
+    void VulkanRenderer::resetFrameCommandPools()
+    {
+        std::size_t frame = cyContext.getCurrentFrameIndex();
+        framePools[frame]->reset();
+        for (auto& worker : workerPools[frame])
+        {
+            worker->reset();
+        }
+        if (hasAsyncCompute())
+        {
+            computePools[frame]->reset();
+        }
+    }
+
+    /**
+     * @brief Takes the next secondary command buffer from the worker's pool and begins it so that it continues
+     * the current render pass.
+    */
+    VkCommandBuffer VulkanRenderer::beginSecondaryCommandBuffer(VulkanCommandPool& pool)
+    {
+        VkCommandBuffer commandBuffer = pool.allocate(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = currentRenderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = cyContext.getSwapChain()->getFrameBuffer(currentImageIndex);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+        VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+        setViewportAndScissor(commandBuffer);
+        return commandBuffer;
+    }
+
+    void VulkanRenderer::setViewportAndScissor(VkCommandBuffer commandBuffer)
+    {
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(cyContext.getSwapChain()->getSwapChainExtent().width);
+        viewport.height = static_cast<float>(cyContext.getSwapChain()->getSwapChainExtent().height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        VkRect2D scissor{ {0, 0}, cyContext.getSwapChain()->getSwapChainExtent() };
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    }
 
-        cleanup();
+    void VulkanRenderer::recreateSwapChain()
+    {
+        //if window is currently minimized block
+        if (!cyContext.isHeadless())
+        {
+            cyContext.getWindow()->blockWhileWindowMinimized();
+        }
 
-        createCommandBuffers();
+        //no device wait here, the swap chain hands everything frames in flight may still use to the deletion queue
+        cyContext.getSwapChain()->reCreate();
 
         _needsResize = true;
     }
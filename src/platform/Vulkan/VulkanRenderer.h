@@ -7,22 +7,58 @@
 #include "VulkanContext.h"
 #include "VulkanDevice.h"
 #include "VulkanPipeline.h"
+#include "VulkanComputePipeline.h"
 #include "VulkanBuffer.h"
 #include "VulkanImage.h"
 #include "VulkanDescriptors.h"
 #include "VulkanTexture.h"
+#include "VulkanCommandPool.h"
+#include "VulkanGPUProfiler.h"
 
 namespace cy3d
 {
 	class VulkanRenderer
 	{
+	public:
+		/**
+		 * Records the items [begin, end) into the given secondary command buffer.
+		*/
+		using secondary_record_fn = std::function<void(VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end)>;
+
+		/**
+		 * The smallest number of items worth handing to a worker. Below this the cost of
+		 * waking a thread and executing another secondary buffer outweighs the recording itself.
+		*/
+		static constexpr uint32_t MIN_ITEMS_PER_WORKER = 64;
 
 	private:
 		VulkanContext& cyContext;
 		/**
-		 * Record a command buffer for every image in the swap chain.
+		 * One command pool per frame in flight. The frame's primary command buffer and any other
+		 * buffers its passes need are allocated linearly from it and the pool is reset in bulk
+		 * once the frame's fence has signaled.
 		*/
-		std::vector<VkCommandBuffer> commandBuffers;
+		std::vector<Scope<VulkanCommandPool>> framePools;
+
+		//frame - worker. Command pools are externally synchronized so every worker records into its own pool.
+		std::vector<std::vector<Scope<VulkanCommandPool>>> workerPools;
+
+		/**
+		 * One pool per frame in flight on the dedicated compute family. Empty when the device has none, async compute
+		 * then allocates from framePools and is submitted to the graphics queue.
+		*/
+		std::vector<Scope<VulkanCommandPool>> computePools;
+		//signaled by the frame's async compute submission and waited on by its graphics submission
+		std::vector<VkSemaphore> computeFinishedSemaphores;
+
+		Scope<VulkanGPUProfiler> gpuProfiler{ nullptr };
+
+		VkCommandBuffer currentCommandBuffer{ VK_NULL_HANDLE };
+		VkRenderPass currentRenderPass{ VK_NULL_HANDLE };
+		VkSubpassContents currentSubpassContents{ VK_SUBPASS_CONTENTS_INLINE };
+		VkCommandBuffer currentComputeCommandBuffer{ VK_NULL_HANDLE };
+		//the stages of this frame's graphics work that wait on its async compute, 0 when nothing was submitted
+		VkPipelineStageFlags computeWaitStages{ 0 };
 
 		uint32_t currentImageIndex{};
 		bool isFrameStarted{ false };
@@ -32,18 +68,27 @@ namespace cy3d
 	public:
 		VulkanRenderer(VulkanContext& context);
 		~VulkanRenderer();
-		void cleanup();
 		void beginFrame();
 		void endFrame();
-		void beginRenderPass(VkRenderPass& renderPass);
+		void beginRenderPass(VkRenderPass& renderPass, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 		void endRenderPass();
+		void recordParallel(uint32_t itemCount, const secondary_record_fn& record, const std::string& scopeName = "Draws");
+		VkCommandBuffer allocateFrameCommandBuffer(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+		void dispatch(VulkanComputePipeline& pipeline, const std::vector<VkDescriptorSet>& sets, uint32_t x, uint32_t y = 1, uint32_t z = 1,
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE);
+		bool hasAsyncCompute() { return !computePools.empty(); }
+		VkCommandBuffer beginAsyncCompute();
+		void submitAsyncCompute(VkPipelineStageFlags waitStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+		uint32_t workerCount() { return static_cast<uint32_t>(workerPools.empty() ? 0 : workerPools[0].size()); }
+
+		VulkanGPUProfiler* getGPUProfiler() { return gpuProfiler.get(); }
 
 		void resetNeedsResize() { _needsResize = false; }
 		bool needsResize() { return _needsResize; }
 		VkCommandBuffer& getCurrentCommandBuffer()
 		{
 			CY_ASSERT(isFrameStarted == true);
-			return commandBuffers[cyContext.getCurrentFrameIndex()];
+			return currentCommandBuffer;
 		}
 		uint32_t getCurrentImageIndex()
 		{
@@ -53,7 +98,11 @@ namespace cy3d
 
 	private:
 		void init();
-		void createCommandBuffers();
+		void createCommandPools();
+		void createComputeSemaphores();
+		void resetFrameCommandPools();
+		VkCommandBuffer beginSecondaryCommandBuffer(VulkanCommandPool& pool);
+		void setViewportAndScissor(VkCommandBuffer commandBuffer);
 
 
 		void recreateSwapChain();
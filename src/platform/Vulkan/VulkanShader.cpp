@@ -1,36 +1,186 @@
 #include "pch.h"
 #include "VulkanShader.h"
 #include "VulkanDevice.h"
+#include "VulkanShaderArchive.h"
+#include "VulkanShaderOptimizer.h"
+#include "../../core/Profiler.h"
+#include "../../core/Hash.h"
 //
 namespace cy3d
 {
-	VulkanShader::VulkanShader(VulkanContext& context, const std::string& shaderDirectory, const std::string& name) : _context(context), _name(name)
+	//has to describe every option createCompileOptions sets, it is part of the archive key
+	constexpr auto COMPILE_OPTIONS_KEY = "vulkan1.2;warnings-as-errors;debug-info";
+	constexpr auto REFLECTION_KEY = "reflection";
+
+	/**
+	 * @brief Resolves #include "file" relative to the including file and #include <file> relative to
+	 * SHADER_INCLUDE_DIRECTORY.
+	*/
+	class ShaderIncluder : public shaderc::CompileOptions::IncluderInterface
+	{
+	private:
+		struct Include
+		{
+			std::string name;
+			std::string content;
+			shaderc_include_result result;
+		};
+
+	public:
+		shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type type, const char* requestingSource, size_t includeDepth) override
+		{
+			std::filesystem::path path = type == shaderc_include_type_relative
+				? std::filesystem::path(requestingSource).parent_path() / requestedSource
+				: std::filesystem::path(SHADER_INCLUDE_DIRECTORY) / requestedSource;
+
+			Include* include = new Include();
+			std::ifstream fin(path, std::ios::in | std::ios::binary);
+			if (fin)
+			{
+				include->name = path.lexically_normal().generic_string();
+				include->content.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+			}
+			else
+			{
+				//an empty name tells shaderc the include failed, the content is the error message
+				include->content = "Failed to open include " + path.generic_string();
+			}
+
+			include->result.source_name = include->name.data();
+			include->result.source_name_length = include->name.size();
+			include->result.content = include->content.data();
+			include->result.content_length = include->content.size();
+			include->result.user_data = include;
+			return &include->result;
+		}
+
+		void ReleaseInclude(shaderc_include_result* data) override
+		{
+			delete static_cast<Include*>(data->user_data);
+		}
+	};
+
+	/**
+	 * @brief The defines do not have to be part of the archive key, they are expanded into the preprocessed source the
+	 * key is hashed from.
+	*/
+	static shaderc::CompileOptions createCompileOptions(const ShaderDefines& defines)
+	{
+		shaderc::CompileOptions options;
+		for (const auto& [name, value] : defines)
+		{
+			options.AddMacroDefinition(name, value);
+		}
+		options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+		options.SetWarningsAsErrors();
+		options.SetGenerateDebugInfo();
+		options.SetIncluder(std::make_unique<ShaderIncluder>());
+		return options;
+	}
+
+	VulkanShader::VulkanShader(VulkanContext& context, const std::string& shaderDirectory, const std::string& name)
+		: _context(context), _name(name), _baseName(name)
 	{
 		init(shaderDirectory);
 	}
 
+	VulkanShader::VulkanShader(VulkanContext& context, const std::string& name, std::unordered_map<VkShaderStageFlagBits, ShaderData> sources,
+		CompiledShaderStages stages, const ShaderDefines& defines)
+		: _context(context), _name(name), _source(std::move(sources)), _baseName(name), _defines(defines)
+	{
+		CY_ASSERT(_source.size() == stages.size());
+		createFromStages(stages);
+	}
+
+	VulkanShader::~VulkanShader()
+	{
+		for (auto& shaderStage : _pipelineCreateInfo)
+		{
+			vkDestroyShaderModule(_context.getDevice()->device(), shaderStage.module, nullptr);
+		}
+		//the layouts are released with the last shader or pipeline using them
+	}
+
 	void VulkanShader::init(const std::string& directory)
 	{
-		std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>> binary{};
+		CompiledShaderStages stages{};
 
-		if (needsRecompiled(directory))
+		//the sources are always read, they are what the archived binaries are looked up by
+		if (!readSourceDirectory(directory, _source))
 		{
-			readSourceDirectory(directory);
-			compile(directory, binary);
+			CY_BASE_LOG_ERROR("Failed to read the shader sources in {0}.", directory);
 		}
-		else
+		for (const auto& [stage, shaderData] : _source)
+		{
+			compileStage(_context, stage, shaderData, stages[stage]);
+		}
+		createFromStages(stages);
+	}
+
+	Ref<VulkanShader> VulkanShader::getVariant(const ShaderDefines& defines)
+	{
+		if (defines.empty())
+		{
+			return shared_from_this();
+		}
+		CY_ASSERT(!isVariant()); //variants are requested from the base shader with the full set of defines
+
+		uint64_t key = hashDefines(defines);
+		auto found = _variants.find(key);
+		if (found != _variants.end())
+		{
+			CY_ASSERT(found->second->getDefines() == defines); //hash collision
+			return found->second;
+		}
+
+		CY_PROFILE_FUNCTION();
+		CompiledShaderStages stages;
+		for (const auto& [stage, shaderData] : _source)
 		{
-			readBinaryDirectory(directory, binary);
-		}	
-		reflect(binary);
-		createShaderModules(binary);
+			if (!compileStage(_context, stage, shaderData, stages[stage], defines))
+			{
+				CY_BASE_LOG_ERROR("Variant {0} failed to compile.", variantName(_name, defines));
+				CY_ASSERT(false);
+			}
+		}
+		return addVariant(defines, std::move(stages));
+	}
+
+	Ref<VulkanShader> VulkanShader::addVariant(const ShaderDefines& defines, CompiledShaderStages stages)
+	{
+		CY_ASSERT(!isVariant() && !defines.empty());
+		Ref<VulkanShader> variant = std::make_shared<VulkanShader>(_context, variantName(_name, defines), _source, std::move(stages), defines);
+		variant->_baseName = _name;
+		_variants[hashDefines(defines)] = variant;
+		return variant;
+	}
+
+	void VulkanShader::createFromStages(CompiledShaderStages& stages)
+	{
+		reflect(stages);
+		createShaderModules(stages);
 		createDescriptorSetLayouts();
 	}
 
 	bool VulkanShader::createDescriptorSetLayouts()
 	{
-		_descriptorSetLayouts.resize(_descriptorSetsInfo.size());
-		for (const auto [setId, setMap] : _descriptorSetsInfo)
+		uint32_t setCount = 0;
+		for (const auto& [setId, setMap] : _descriptorSetsInfo)
+		{
+			setCount = std::max(setCount, setId + 1);
+		}
+
+		//set ids the shader skips get an empty layout so the rest keep their index
+		_sharedSetLayouts.assign(setCount, nullptr);
+		for (uint32_t setId = 0; setId < setCount; setId++)
+		{
+			if (_descriptorSetsInfo.count(setId) == 0)
+			{
+				_sharedSetLayouts[setId] = _context.getLayoutCache()->getDescriptorSetLayout({});
+			}
+		}
+
+		for (const auto& [setId, setMap] : _descriptorSetsInfo)
 		{
 			std::vector<VkDescriptorSetLayoutBinding> bindings{};
 
@@ -39,7 +189,7 @@ namespace cy3d
 				VkDescriptorSetLayoutBinding bindingInfo{};
 				bindingInfo.binding = uboInfo.binding;
 				bindingInfo.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-				bindingInfo.descriptorCount = setMap.ubosInfo.size();
+				bindingInfo.descriptorCount = 1;
 				bindingInfo.stageFlags = uboInfo.stage;
 				bindingInfo.pImmutableSamplers = nullptr; // Optional
 				//CY_ASSERT(_bindings.count(uboInfo.binding) == 0);
@@ -53,7 +203,7 @@ namespace cy3d
 				VkDescriptorSetLayoutBinding bindingInfo{};
 				bindingInfo.binding = samplerInfo.binding;
 				bindingInfo.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				bindingInfo.descriptorCount = setMap.imageSamplersInfo.size();
+				bindingInfo.descriptorCount = 1;
 				bindingInfo.stageFlags = samplerInfo.stage;
 				bindingInfo.pImmutableSamplers = nullptr; // Optional
 				//CY_ASSERT(_bindings.count(samplerInfo.binding) == 0);
@@ -61,25 +211,60 @@ namespace cy3d
 				bindings.push_back(bindingInfo);
 			}
 
-			VkDescriptorSetLayoutCreateInfo layoutInfo{};
-			layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-			layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-			layoutInfo.pBindings = bindings.data();
-			VK_CHECK(vkCreateDescriptorSetLayout(_context.getDevice()->device(), &layoutInfo, nullptr, &_descriptorSetLayouts[setId]));
+			for (const auto [bufferName, bufferInfo] : setMap.storageBuffersInfo)
+			{
+				VkDescriptorSetLayoutBinding bindingInfo{};
+				bindingInfo.binding = bufferInfo.binding;
+				bindingInfo.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				bindingInfo.descriptorCount = 1;
+				bindingInfo.stageFlags = bufferInfo.stage;
+				bindingInfo.pImmutableSamplers = nullptr; // Optional
+				bindings.push_back(bindingInfo);
+			}
+
+			for (const auto [imageName, imageInfo] : setMap.storageImagesInfo)
+			{
+				VkDescriptorSetLayoutBinding bindingInfo{};
+				bindingInfo.binding = imageInfo.binding;
+				bindingInfo.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+				bindingInfo.descriptorCount = 1;
+				bindingInfo.stageFlags = imageInfo.stage;
+				bindingInfo.pImmutableSamplers = nullptr;
+				bindings.push_back(bindingInfo);
+			}
+
+			for (const auto [attachmentName, attachmentInfo] : setMap.inputAttachmentsInfo)
+			{
+				VkDescriptorSetLayoutBinding bindingInfo{};
+				bindingInfo.binding = attachmentInfo.binding;
+				bindingInfo.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+				bindingInfo.descriptorCount = 1;
+				bindingInfo.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT; //input attachments can only be read by fragment shaders
+				bindingInfo.pImmutableSamplers = nullptr;
+				bindings.push_back(bindingInfo);
+			}
+
+			_sharedSetLayouts[setId] = _context.getLayoutCache()->getDescriptorSetLayout(std::move(bindings));
 		}
 
+		_descriptorSetLayouts.clear();
+		for (const auto& setLayout : _sharedSetLayouts)
+		{
+			_descriptorSetLayouts.push_back(setLayout->getLayout());
+		}
+		_pipelineLayout = _context.getLayoutCache()->getPipelineLayout(_sharedSetLayouts, _pushConstantRanges);
 		return true;
 	}
 
-	bool VulkanShader::createShaderModules(std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& binary)
+	bool VulkanShader::createShaderModules(CompiledShaderStages& stages)
 	{
-		for (auto [stage, bin] : binary)
+		for (auto& [stage, compiled] : stages)
 		{
-			CY_ASSERT(bin.size() != 0);
+			CY_ASSERT(compiled.binary.size() != 0);
 			VkShaderModuleCreateInfo moduleCreateInfo{};
 			moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-			moduleCreateInfo.codeSize = bin.size() * sizeof(uint32_t);
-			moduleCreateInfo.pCode = bin.data();
+			moduleCreateInfo.codeSize = compiled.binary.size() * sizeof(uint32_t);
+			moduleCreateInfo.pCode = compiled.binary.data();
 
 			VkShaderModule shaderModule;
 			VK_CHECK(vkCreateShaderModule(_context.getDevice()->device(), &moduleCreateInfo, NULL, &shaderModule));
@@ -96,161 +281,185 @@ namespace cy3d
 		return true;
 	}
 
-	void VulkanShader::reflect(std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& binary)
+	/**
+	 * @brief Merges the reflection of every stage. No stage is parsed here, compileStage has already reflected it or
+	 * loaded its reflection from the shader archive.
+	*/
+	void VulkanShader::reflect(const CompiledShaderStages& stages)
 	{
-
-		for (auto [stage, bin] : binary)
+		for (const auto& [stage, compiled] : stages)
 		{
-			spirv_cross::Compiler compiler(bin);
-			auto resources = compiler.get_shader_resources();
-
-			for (const auto& resource : resources.uniform_buffers)
-			{
-				const auto& name = resource.name;
-				auto& bufferType = compiler.get_type(resource.base_type_id);
-				int memberCount = static_cast<uint32_t>(bufferType.member_types.size());
-				uint32_t binding = compiler.get_decoration(resource.id, spv::DecorationBinding);
-				uint32_t descriptorSet = compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
-				uint32_t size = static_cast<uint32_t>(compiler.get_declared_struct_size(bufferType));
-				CY_BASE_LOG_INFO("UBO -> name: {0} binding {1} desc set {2} size: {3}", name, binding, descriptorSet, size);
-				//CY_ASSERT(_descriptorSetsInfo.count(descriptorSet) == 0); //shouldn't have multiple ubos bound at the same descriptor set
-				if (_descriptorSetsInfo.count(descriptorSet) == 0)
-				{
-					_descriptorSetsInfo[descriptorSet] = ShaderDescriptorSetInfo();
-				}
-				ShaderUBOSetInfo uboInfo{};
-				uboInfo.binding = binding;
-				uboInfo.descriptorSet = descriptorSet;
-				uboInfo.stage = stage;
-				uboInfo.createInfo = BufferCreateInfo::createUBOInfo(size);
-				_descriptorSetsInfo[descriptorSet].ubosInfo[name] = (uboInfo);
-			}
-
-			for (const auto& resource : resources.sampled_images)
+			const ShaderStageReflection& reflection = compiled.reflection;
+			for (const auto& resource : reflection.resources)
 			{
-				//TODO what if UBO is in both the vertex and fragment shader.
-				//Its stage should be VK_SHADER_STAGE_ALL but as of now if its both the vertex
-				//and fragment shader it will be marked as VK_SHADER_STAGE_FRAGMENT.
-				const auto& name = resource.name;
-				auto& baseType = compiler.get_type(resource.base_type_id);
-				auto& type = compiler.get_type(resource.type_id);
-				uint32_t binding = compiler.get_decoration(resource.id, spv::DecorationBinding);
-				uint32_t descriptorSet = compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
-				uint32_t dimension = baseType.image.dim;
-				uint32_t arraySize = type.array[0];
-				
-				if (_descriptorSetsInfo.count(descriptorSet) == 0)
+				//TODO what if a resource is in both the vertex and fragment shader.
+				//Its stage should be VK_SHADER_STAGE_ALL but as of now the last stage that declares it wins.
+				ShaderDescriptorSetInfo& setInfo = _descriptorSetsInfo[resource.set];
+				switch (resource.type)
 				{
-					_descriptorSetsInfo[descriptorSet] = ShaderDescriptorSetInfo();
+					case ShaderResourceType::UniformBuffer:
+					{
+						ShaderUBOSetInfo uboInfo{};
+						uboInfo.binding = resource.binding;
+						uboInfo.descriptorSet = resource.set;
+						uboInfo.stage = stage;
+						uboInfo.createInfo = BufferCreateInfo::createUBOInfo(resource.size);
+						setInfo.ubosInfo[resource.name] = uboInfo;
+						CY_BASE_LOG_INFO("UBO -> name: {0} binding {1} desc set {2} size: {3}", resource.name, resource.binding, resource.set, resource.size);
+						break;
+					}
+					case ShaderResourceType::StorageBuffer:
+					{
+						ShaderStorageBufferSetInfo storageInfo{};
+						storageInfo.binding = resource.binding;
+						storageInfo.descriptorSet = resource.set;
+						storageInfo.size = resource.size;
+						storageInfo.stage = stage;
+						setInfo.storageBuffersInfo[resource.name] = storageInfo;
+						CY_BASE_LOG_INFO("Storage Buffer -> name: {0} binding {1} desc set {2} size: {3}", resource.name, resource.binding, resource.set, resource.size);
+						break;
+					}
+					case ShaderResourceType::CombinedImageSampler:
+					{
+						ShaderImageSamplerSetInfo imageSamplerInfo{};
+						imageSamplerInfo.binding = resource.binding;
+						imageSamplerInfo.descriptorSet = resource.set;
+						imageSamplerInfo.stage = stage;
+						setInfo.imageSamplersInfo[resource.name] = imageSamplerInfo;
+						CY_BASE_LOG_INFO("Sampler -> name: {0} binding {1} desc set {2}", resource.name, resource.binding, resource.set);
+						break;
+					}
+					case ShaderResourceType::StorageImage:
+					{
+						ShaderStorageImageSetInfo storageImageInfo{};
+						storageImageInfo.binding = resource.binding;
+						storageImageInfo.descriptorSet = resource.set;
+						storageImageInfo.stage = stage;
+						setInfo.storageImagesInfo[resource.name] = storageImageInfo;
+						CY_BASE_LOG_INFO("Storage Image -> name: {0} binding {1} desc set {2}", resource.name, resource.binding, resource.set);
+						break;
+					}
+					case ShaderResourceType::InputAttachment:
+					{
+						ShaderInputAttachmentSetInfo inputInfo{};
+						inputInfo.binding = resource.binding;
+						inputInfo.descriptorSet = resource.set;
+						inputInfo.attachmentIndex = resource.attachmentIndex;
+						inputInfo.stage = stage;
+						setInfo.inputAttachmentsInfo[resource.name] = inputInfo;
+						CY_BASE_LOG_INFO("Input Attachment -> name: {0} binding {1} desc set {2} index {3}", resource.name, resource.binding, resource.set, resource.attachmentIndex);
+						break;
+					}
 				}
-				ShaderImageSamplerSetInfo imageSamplerInfo{};
-				imageSamplerInfo.binding = binding;
-				imageSamplerInfo.descriptorSet = descriptorSet;
-				imageSamplerInfo.stage = stage;
-				_descriptorSetsInfo[descriptorSet].imageSamplersInfo[name] = imageSamplerInfo;
-				CY_BASE_LOG_INFO("Sampler -> name: {0} binding {1} desc set {2}", name, binding, descriptorSet);
 			}
-		}
-		
-	}
 
-	bool VulkanShader::compile(const std::string& directory, std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& outShaderBinary)
-	{
-		shaderc::Compiler compiler;
-		shaderc::CompileOptions options;
-		options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
-		options.SetWarningsAsErrors();
-		options.SetGenerateDebugInfo();
-
-		for (auto [stage, shaderData] : _source)
-		{
-			shaderc::SpvCompilationResult spirvBinary = compiler.CompileGlslToSpv(shaderData.source, vkShaderStageToShaderCStage(stage), shaderData.filepath.string().c_str(), options);
-
-			if (spirvBinary.GetCompilationStatus() != shaderc_compilation_status_success)
+			//a constant used by several stages has the same id in all of them
+			for (const auto& constant : reflection.specializationConstants)
 			{
-				CY_BASE_LOG_ERROR(spirvBinary.GetErrorMessage());
-				CY_ASSERT(false);
+				_specializationConstants[constant.name] = constant.id;
+				CY_BASE_LOG_INFO("Specialization Constant -> name: {0} id {1}", constant.name, constant.id);
 			}
-			const std::byte* begin = reinterpret_cast<const std::byte*>(spirvBinary.cbegin());
-			const std::byte* end = reinterpret_cast<const std::byte*>(spirvBinary.cend());
-			const ptrdiff_t size = end - begin;
-
-			outShaderBinary[stage] = std::vector<uint32_t>(spirvBinary.cbegin(), spirvBinary.cend());
-		}
 
-		auto shaderCacheDir = directory + "/" + SHADER_BIN_FOLDER;
-		if (!(std::filesystem::exists(shaderCacheDir)))
-		{
-			std::filesystem::create_directory(shaderCacheDir);
-			CY_BASE_LOG_INFO("Created shader cache directory: {0}", shaderCacheDir);
-		}
-
-		for (auto& [stage, binary] : outShaderBinary)
-		{
 			if (stage == VK_SHADER_STAGE_VERTEX_BIT)
 			{
-				cacheBinary(shaderCacheDir + "/" + _name + ".vert.spv", binary);
+				_vertexInputs = reflection.vertexInputs;
 			}
-			else if (stage == VK_SHADER_STAGE_FRAGMENT_BIT)
+
+			if (stage == VK_SHADER_STAGE_COMPUTE_BIT)
 			{
-				cacheBinary(shaderCacheDir + "/" + _name + ".frag.spv", binary);
+				_workgroupSize = reflection.workgroupSize;
 			}
-			else
+
+			if (reflection.pushConstantSize != 0)
 			{
-				CY_BASE_LOG_INFO("Cannot cache shader binary of unknown shader stage: {0}", stage);
+				_pushConstantRanges.push_back(VkPushConstantRange{ static_cast<VkShaderStageFlags>(stage), reflection.pushConstantOffset, reflection.pushConstantSize });
 			}
 		}
-		return true;
 	}
 
-	bool VulkanShader::cacheBinary(const std::string& path, std::vector<uint32_t> binary)
+	/**
+	 * @brief The stage is preprocessed first, which resolves its includes, and looked up in the shader archive by the
+	 * hash of the result. It is only compiled and optimized if the archive does not have it yet, from the same
+	 * preprocessed source so the archived binary always matches its key. Debug info is stripped once before the binary
+	 * is archived, so modules are created straight from it.
+	 *
+	 * Safe to call from several threads at once, each thread compiles with its own shaderc::Compiler.
+	*/
+	bool VulkanShader::compileStage(VulkanContext& context, VkShaderStageFlagBits stage, const ShaderData& shaderData, CompiledShaderStage& outStage,
+		const ShaderDefines& defines)
 	{
-		std::ofstream fout(path, std::ios::out | std::ios::binary);
-		fout.write(reinterpret_cast<const char*>(binary.data()), binary.size() * sizeof(uint32_t));
-		fout.close();
-		CY_BASE_LOG_INFO("Cached shader to {0}", path);
-		return true;
-	}
+		//a compiler must not be used by two threads at the same time, one per thread avoids locking around it
+		thread_local shaderc::Compiler compiler;
 
-	bool VulkanShader::needsRecompiled(const std::string& directory)
-	{
-		auto shaderCacheDir = directory + "/" + SHADER_BIN_FOLDER;
-		if (!(std::filesystem::exists(shaderCacheDir)))
+		shaderc::CompileOptions options = createCompileOptions(defines);
+		std::string filename = shaderData.filepath.generic_string();
+		shaderc::PreprocessedSourceCompilationResult preprocessed = compiler.PreprocessGlsl(shaderData.source, vkShaderStageToShaderCStage(stage), filename.c_str(), options);
+		if (preprocessed.GetCompilationStatus() != shaderc_compilation_status_success)
+		{
+			CY_BASE_LOG_ERROR(preprocessed.GetErrorMessage());
+			return false;
+		}
+
+		std::string source(preprocessed.cbegin(), preprocessed.cend());
+		uint64_t optionsKey = hashString(COMPILE_OPTIONS_KEY, hashCombine(VulkanShaderArchive::compilerVersionHash(), context.getShaderOptimizer()->getSettings().hash()));
+		uint64_t key = hashString(source, hashValue(stage, optionsKey));
+		//the reflection of a binary is archived under its own key, derived from the binary's
+		uint64_t reflectionKey = hashCombine(key, hashValue(ShaderStageReflection::REFLECTION_VERSION, hashString(REFLECTION_KEY)));
+		std::vector<uint32_t> reflectionData;
+		//the archived binary may be stripped of the names reflection needs, without its reflection it is compiled again
+		if (context.getShaderArchive()->find(key, outStage.binary) && context.getShaderArchive()->find(reflectionKey, reflectionData)
+			&& outStage.reflection.deserialize(reflectionData))
 		{
-			CY_BASE_LOG_INFO("Shader cache directory does not exist so: {0} will be recompiled.", _name);
+			CY_BASE_LOG_INFO("Loaded {0} from the shader archive.", filename);
 			return true;
 		}
 
-		std::chrono::time_point<std::filesystem::_File_time_clock>::clock::duration maxShaderSourceModifiedTime{};
-		bool first{ true };
-		for (const auto& file : std::filesystem::directory_iterator(directory))
+		CY_PROFILE_SCOPE("VulkanShader::compile");
+		shaderc::SpvCompilationResult spirvBinary = compiler.CompileGlslToSpv(source, vkShaderStageToShaderCStage(stage), filename.c_str(), options);
+		if (spirvBinary.GetCompilationStatus() != shaderc_compilation_status_success)
 		{
-			auto modTime = file.last_write_time().time_since_epoch();
-			if (first)
-			{
-				maxShaderSourceModifiedTime = modTime;
-				first = false;
-			}
+			CY_BASE_LOG_ERROR(spirvBinary.GetErrorMessage());
+			return false;
+		}
 
-			if (modTime > maxShaderSourceModifiedTime)
-			{
-				maxShaderSourceModifiedTime = modTime;
-			}
+		//archived optimized, a binary loaded from the archive is never optimized twice
+		std::vector<uint32_t> optimized;
+		context.getShaderOptimizer()->optimize(filename, std::vector<uint32_t>(spirvBinary.cbegin(), spirvBinary.cend()), optimized);
+		//reflected while the names are still there, the archived binary is already stripped for the driver
+		outStage.reflection = ShaderStageReflection::reflect(stage, optimized);
+		outStage.binary = context.getShaderOptimizer()->stripDebugInfo(optimized);
+		context.getShaderArchive()->add(key, outStage.binary);
+
+		reflectionData.clear();
+		outStage.reflection.serialize(reflectionData);
+		context.getShaderArchive()->add(reflectionKey, reflectionData);
+		CY_BASE_LOG_INFO("Compiled {0} and added it to the shader archive.", filename);
+		return true;
+	}
+
+	uint64_t VulkanShader::hashDefines(const ShaderDefines& defines)
+	{
+		uint64_t seed = FNV_OFFSET_BASIS;
+		for (const auto& [name, value] : defines)
+		{
+			seed = hashCombine(seed, hashString(name));
+			seed = hashCombine(seed, hashString(value));
 		}
+		return seed;
+	}
 
-		for (const auto& file : std::filesystem::directory_iterator(shaderCacheDir))
+	std::string VulkanShader::variantName(const std::string& name, const ShaderDefines& defines)
+	{
+		std::string result = name + "[";
+		for (auto it = defines.begin(); it != defines.end(); ++it)
 		{
-			auto modTime = file.last_write_time().time_since_epoch();
-			if (modTime < maxShaderSourceModifiedTime)
-			{
-				CY_BASE_LOG_INFO("Shader {0} will be recompiled.", _name);
-				return true;
-			}
+			if (it != defines.begin()) result += ",";
+			result += it->second.empty() ? it->first : it->first + "=" + it->second;
 		}
-		return false;
+		return result + "]";
 	}
 
-	bool VulkanShader::readSourceDirectory(const std::string& directory)
+	bool VulkanShader::readSourceDirectory(const std::string& directory, std::unordered_map<VkShaderStageFlagBits, ShaderData>& outSources)
 	{
 		CY_ASSERT(std::filesystem::exists(directory));
 		CY_ASSERT(std::filesystem::is_directory(directory));
@@ -258,68 +467,32 @@ namespace cy3d
 		for (const auto& file : std::filesystem::directory_iterator(directory))
 		{
 			const auto& path = file.path();
-			//set name to be the filename it will be strimmed later
-			//_name = path.filename().string();
-			CY_BASE_LOG_INFO("Filename: {0}", path.filename().string());
-			if (file.is_directory())
+			std::string filename = path.filename().string();
+			//editors leave hidden swap files and backups ending in ~ next to the sources
+			if (file.is_directory() || filename.empty() || filename.front() == '.' || filename.back() == '~')
 			{
 				continue;
 			}
-			if (isFileType(path, VERT_EXTENSION))
-			{
-				CY_ASSERT(_source.count(VK_SHADER_STAGE_VERTEX_BIT) == 0); //multiple vert shaders cant be in the same directory
-				ShaderData{ std::string(), path };
-				_source[VK_SHADER_STAGE_VERTEX_BIT] = ShaderData{ std::string(), path };
-				readSource(_source[VK_SHADER_STAGE_VERTEX_BIT]);
-			}
-			else if (isFileType(path, FRAG_EXTENSION))
-			{
-				CY_ASSERT(_source.count(VK_SHADER_STAGE_FRAGMENT_BIT) == 0); //multiple frag shaders cant be in the same directory
-				_source[VK_SHADER_STAGE_FRAGMENT_BIT] = ShaderData{ std::string(), path };
-				readSource(_source[VK_SHADER_STAGE_FRAGMENT_BIT]);
-			}
-			else
-			{
-				CY_BASE_LOG_ERROR("Extension not found: {0}", path.string());
-				CY_ASSERT(false);
-			}
-		}
-		//remove extension from shader name
-		//stripFilenameExtension();
-		return true;
-	}
-
-	bool VulkanShader::readBinaryDirectory(const std::string& directory, std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& binary)
-	{
-		auto shaderCacheDir = directory + "/" + SHADER_BIN_FOLDER;
-		CY_ASSERT(std::filesystem::exists(shaderCacheDir));
-		CY_ASSERT(std::filesystem::is_directory(shaderCacheDir));
 
-		for (const auto& file : std::filesystem::directory_iterator(shaderCacheDir))
-		{
-			const auto& path = file.path();
-			CY_BASE_LOG_INFO("Filename: {0}", path.filename().string());
-			if (file.is_directory())
+			VkShaderStageFlagBits stage;
+			if (isFileType(path, VERT_EXTENSION)) stage = VK_SHADER_STAGE_VERTEX_BIT;
+			else if (isFileType(path, FRAG_EXTENSION)) stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+			else if (isFileType(path, COMP_EXTENSION)) stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			else
 			{
+				CY_BASE_LOG_INFO("Skipping {0}, it is not a shader stage.", path.string());
 				continue;
 			}
-			if (isFileType(path, VERT_EXTENSION))
-			{
-				CY_ASSERT(binary.count(VK_SHADER_STAGE_VERTEX_BIT) == 0); //multiple vert shaders cant be in the same directory
-				ShaderData{ std::string(), path };
-				binary[VK_SHADER_STAGE_VERTEX_BIT] = std::vector<uint32_t>();
-				readBinary(path.string(), binary[VK_SHADER_STAGE_VERTEX_BIT]);
-			}
-			else if (isFileType(path, FRAG_EXTENSION))
+
+			if (outSources.count(stage) != 0)
 			{
-				CY_ASSERT(binary.count(VK_SHADER_STAGE_FRAGMENT_BIT) == 0); //multiple frag shaders cant be in the same directory
-				binary[VK_SHADER_STAGE_FRAGMENT_BIT] = std::vector<uint32_t>();
-				readBinary(path.string(), binary[VK_SHADER_STAGE_FRAGMENT_BIT]);
+				CY_BASE_LOG_ERROR("{0} holds more than one {1} shader.", directory, path.extension().string());
+				return false;
 			}
-			else
+			outSources[stage] = ShaderData{ std::string(), path };
+			if (!readSource(outSources[stage]))
 			{
-				CY_BASE_LOG_ERROR("Extension not found: {0}", path.string());
-				CY_ASSERT(false);
+				return false;
 			}
 		}
 		return true;
@@ -340,37 +513,15 @@ namespace cy3d
 		else
 		{
 			CY_BASE_LOG_ERROR("Failed to open file: {0}", data.filepath.string());
+			return false;
 		}
 		file.close();
 		return true;
 	}
 
-	bool VulkanShader::readBinary(const std::string& filepath, std::vector<uint32_t>& outBinary)
-	{
-		FILE* file;
-		errno_t err = fopen_s(&file, filepath.c_str(), "rb");
-		if (!err)
-		{
-			fseek(file, 0, SEEK_END);
-			uint64_t size = ftell(file);
-			fseek(file, 0, SEEK_SET);
-			outBinary.resize(size / sizeof(uint32_t));
-			fread(outBinary.data(), sizeof(uint32_t), outBinary.size(), file);
-			fclose(file);
-			return true;
-		}
-		CY_BASE_LOG_ERROR("Failed to open file: {0}", filepath);
-		return false;
-	}
-
 	bool VulkanShader::isFileType(const std::filesystem::path& filepath, const std::string& type)
 	{
-		//auto ext = filepath.string();
-		if (filepath.string().find(type) != std::string::npos)
-		{
-			return true;
-		}
-		return false;
+		return filepath.extension() == type;
 	}
 
 	//bool VulkanShader::stripFilenameExtension()
@@ -4,13 +4,22 @@
 #include "../../core/core.h"
 #include "VulkanContext.h"
 #include "VulkanBufferTypes.h"
+#include "VulkanLayoutCache.h"
+#include "VulkanShaderReflection.h"
 
 namespace cy3d
 {
 	constexpr auto VERT_EXTENSION = ".vert";
 	constexpr auto FRAG_EXTENSION = ".frag";
-	constexpr auto SHADER_BIN_FOLDER = "cache";
-	constexpr auto SHADER_COMPILED_EXTENSION = ".spv";
+	constexpr auto COMP_EXTENSION = ".comp";
+	//where #include <file> is looked up, #include "file" is relative to the including file
+	constexpr auto SHADER_INCLUDE_DIRECTORY = "resources/shaders/include";
+
+	/**
+	 * @brief The macros a shader variant is compiled with, name -> value. An empty value defines the macro without one.
+	 * Ordered so the same set of macros always gives the same variant key and name.
+	*/
+	using ShaderDefines = std::map<std::string, std::string>;
 
 	struct ShaderData
 	{
@@ -33,14 +42,51 @@ namespace cy3d
 		VkShaderStageFlagBits stage{ VK_SHADER_STAGE_ALL };
 	};
 
+	struct ShaderStorageBufferSetInfo
+	{
+		uint32_t binding;
+		uint32_t descriptorSet;
+		//size of the fixed part of the buffer. A runtime array as the last member is not included.
+		uint32_t size;
+		VkShaderStageFlagBits stage{ VK_SHADER_STAGE_ALL };
+	};
+
+	struct ShaderStorageImageSetInfo
+	{
+		uint32_t binding;
+		uint32_t descriptorSet;
+		VkShaderStageFlagBits stage{ VK_SHADER_STAGE_ALL };
+	};
+
+	struct ShaderInputAttachmentSetInfo
+	{
+		uint32_t binding;
+		uint32_t descriptorSet;
+		//the input_attachment_index the shader reads, i.e. the index into the subpass' input attachments
+		uint32_t attachmentIndex;
+		VkShaderStageFlagBits stage{ VK_SHADER_STAGE_FRAGMENT_BIT };
+	};
+
 	struct ShaderDescriptorSetInfo
 	{
-		//std::string is the name of the sampler or ubo
+		//std::string is the name of the sampler, ubo, storage buffer, storage image or input attachment
 		std::unordered_map<std::string, ShaderUBOSetInfo> ubosInfo;
 		std::unordered_map<std::string, ShaderImageSamplerSetInfo> imageSamplersInfo;
+		std::unordered_map<std::string, ShaderStorageBufferSetInfo> storageBuffersInfo;
+		std::unordered_map<std::string, ShaderStorageImageSetInfo> storageImagesInfo;
+		std::unordered_map<std::string, ShaderInputAttachmentSetInfo> inputAttachmentsInfo;
 	};
-	//TODO need to cache a the binaries so the shaders are compiled only when they've been changed
-	class VulkanShader
+	/**
+	 * @brief Owns the shader modules of a shader directory. Pipelines only borrow them so any number of pipeline variants
+	 * can be built from the same shader. The descriptor set and pipeline layouts come from the context's layout cache and
+	 * are shared with every other shader that declares the same resources.
+	 *
+	 * A shader can be specialized in two ways. getVariant() compiles the same sources with a set of macros into a new
+	 * shader, which removes disabled features from the binary entirely. Specialization constants declared with
+	 * layout(constant_id = N) are reflected by name and given a value per pipeline through PipelineState::specialize, which
+	 * only costs a pipeline compile and no shader compile.
+	*/
+	class VulkanShader : public std::enable_shared_from_this<VulkanShader>
 	{
 		//VK_SHADER_STAGE_VERTEX_BIT,
 		//VK_SHADER_STAGE_FRAGMENT_BIT
@@ -52,15 +98,38 @@ namespace cy3d
 		std::unordered_map<VkShaderStageFlagBits, ShaderData> _source;
 		std::vector<VkPipelineShaderStageCreateInfo> _pipelineCreateInfo;
 		//index is the set id
+		std::vector<Ref<VulkanDescriptorSetLayout>> _sharedSetLayouts;
+		//the handles of _sharedSetLayouts
 		std::vector<VkDescriptorSetLayout> _descriptorSetLayouts;
+		Ref<VulkanPipelineLayout> _pipelineLayout{ nullptr };
 		//std::unordered_map<uint32_t, std::unordered_map<uint32_t, VkDescriptorSet>> _descriptorSets;
+		//name -> constant_id
+		std::unordered_map<std::string, uint32_t> _specializationConstants;
+		//sorted by location
+		std::vector<ShaderVertexInputReflection> _vertexInputs;
+		std::vector<VkPushConstantRange> _pushConstantRanges;
+		//1, 1, 1 unless the shader has a compute stage
+		std::array<uint32_t, 3> _workgroupSize{ 1, 1, 1 };
+		//name of the shader the variant was compiled from, _name for the base shader
+		std::string _baseName;
+		//empty unless this shader is a variant
+		ShaderDefines _defines;
+		//hashDefines -> variant, only the base shader has variants
+		std::unordered_map<uint64_t, Ref<VulkanShader>> _variants;
 
 	public:
 		VulkanShader(VulkanContext& context, const std::string& shaderDirectory, const std::string& name);
+		/**
+		 * @brief Creates the shader from sources that have already been compiled, see ShaderManager::addBatch.
+		*/
+		VulkanShader(VulkanContext& context, const std::string& name, std::unordered_map<VkShaderStageFlagBits, ShaderData> sources,
+			CompiledShaderStages stages, const ShaderDefines& defines = {});
+		~VulkanShader();
 
 		CY_NOCOPY(VulkanShader);
 
-		std::string getName() { return _name; }
+		const std::string& getName() const { return _name; }
+		const std::string& getBaseName() const { return _baseName; }
 
 		ShaderUBOSetInfo getDescriptorSetUBOInfo(uint32_t setId, const std::string& name)
 		{ 
@@ -84,21 +153,62 @@ namespace cy3d
 		std::vector<VkDescriptorSetLayout>& getDescriptorSetLayouts() { return _descriptorSetLayouts; }
 		const std::vector<VkDescriptorSetLayout>& getDescriptorSetLayouts() const { return _descriptorSetLayouts; }
 
+		const std::vector<Ref<VulkanDescriptorSetLayout>>& getSharedSetLayouts() const { return _sharedSetLayouts; }
+		const Ref<VulkanPipelineLayout>& getPipelineLayout() const { return _pipelineLayout; }
+
+		/**
+		 * @brief Returns the variant of this shader compiled with defines, compiling it on the calling thread the first time
+		 * it is requested. Every variant is its own shader named by variantName, so its pipelines are separate library
+		 * entries. An empty set of defines returns this shader.
+		*/
+		Ref<VulkanShader> getVariant(const ShaderDefines& defines);
+		/**
+		 * @brief Adds the variant for defines from stages that have already been compiled with them, replacing the variant
+		 * if there already is one.
+		*/
+		Ref<VulkanShader> addVariant(const ShaderDefines& defines, CompiledShaderStages stages);
+		const std::unordered_map<uint64_t, Ref<VulkanShader>>& getVariants() const { return _variants; }
+		const ShaderDefines& getDefines() const { return _defines; }
+		bool isVariant() const { return !_defines.empty(); }
+
+		const std::vector<ShaderVertexInputReflection>& getVertexInputs() const { return _vertexInputs; }
+		const std::vector<VkPushConstantRange>& getPushConstantRanges() const { return _pushConstantRanges; }
+		bool isCompute() const { return _source.count(VK_SHADER_STAGE_COMPUTE_BIT) != 0; }
+		const std::array<uint32_t, 3>& getWorkgroupSize() const { return _workgroupSize; }
+
+		bool hasSpecializationConstant(const std::string& name) const { return _specializationConstants.count(name) != 0; }
+		uint32_t getSpecializationConstantId(const std::string& name) const
+		{
+			CY_ASSERT(hasSpecializationConstant(name)); //the shader declares no specialization constant by that name
+			return _specializationConstants.at(name);
+		}
+
+		/**
+		 * @brief Reads the source of every stage in directory. Hidden files and files without a stage extension are skipped.
+		 * Returns false when a file cannot be read or a stage appears more than once.
+		*/
+		static bool readSourceDirectory(const std::string& directory, std::unordered_map<VkShaderStageFlagBits, ShaderData>& outSources);
+		/**
+		 * @brief Compiles and reflects the stage, or loads both from the shader archive.
+		*/
+		static bool compileStage(VulkanContext& context, VkShaderStageFlagBits stage, const ShaderData& shaderData, CompiledShaderStage& outStage,
+			const ShaderDefines& defines = {});
+		static uint64_t hashDefines(const ShaderDefines& defines);
+		/**
+		 * @brief name[A,B=1] for the defines A and B=1.
+		*/
+		static std::string variantName(const std::string& name, const ShaderDefines& defines);
+
 	private:
 		void init(const std::string& directory);
+		void createFromStages(CompiledShaderStages& stages);
 		bool createDescriptorSetLayouts();
-		bool createShaderModules(std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& binary);
-		void reflect(std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& binary);
-		bool compile(const std::string& directory, std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& outBinary);
-		bool cacheBinary(const std::string& path, std::vector<uint32_t> binary);
-		bool needsRecompiled(const std::string& directory);
-		bool readSourceDirectory(const std::string& directory);
-		bool readBinaryDirectory(const std::string& directory, std::unordered_map<VkShaderStageFlagBits, std::vector<uint32_t>>& binary);
-		bool readSource(ShaderData& data);
-		bool readBinary(const std::string& filepath, std::vector<uint32_t>& outBinary);
-		bool isFileType(const std::filesystem::path& filepath, const std::string& type);
+		bool createShaderModules(CompiledShaderStages& stages);
+		void reflect(const CompiledShaderStages& stages);
+		static bool readSource(ShaderData& data);
+		static bool isFileType(const std::filesystem::path& filepath, const std::string& type);
 		//bool stripFilenameExtension();
-		shaderc_shader_kind vkShaderStageToShaderCStage(VkShaderStageFlagBits stage);
+		static shaderc_shader_kind vkShaderStageToShaderCStage(VkShaderStageFlagBits stage);
 	};
 }
 
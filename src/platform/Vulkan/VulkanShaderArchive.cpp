@@ -0,0 +1,206 @@
+#include "pch.h"
+
+#include "VulkanShaderArchive.h"
+#include "../../core/Hash.h"
+
+namespace cy3d
+{
+    VulkanShaderArchive::VulkanShaderArchive(const std::string& path) : _path(path)
+    {
+        if (map())
+        {
+            CY_BASE_LOG_INFO("Mapped {0} archived shader binaries from {1}", _entryCount, _path);
+        }
+    }
+
+    VulkanShaderArchive::~VulkanShaderArchive()
+    {
+        save();
+    }
+
+    bool VulkanShaderArchive::find(uint64_t key, std::vector<uint32_t>& outBinary)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto added = _added.find(key);
+        if (added != _added.end())
+        {
+            outBinary = added->second;
+            return true;
+        }
+
+        const ArchiveEntry* entry = findEntry(key);
+        if (entry == nullptr)
+        {
+            return false;
+        }
+        outBinary.resize(static_cast<std::size_t>(entry->size / sizeof(uint32_t)));
+        std::memcpy(outBinary.data(), _file.data() + entry->offset, static_cast<std::size_t>(entry->size));
+        _used.insert(key);
+        return true;
+    }
+
+    void VulkanShaderArchive::add(uint64_t key, const std::vector<uint32_t>& binary)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _added[key] = binary;
+    }
+
+    /**
+     * @brief Rewrites the whole archive into a temporary file and renames it over the old one, so a crash while saving
+     * never leaves a truncated archive behind. Does nothing if no binary has been added.
+    */
+    bool VulkanShaderArchive::save()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_added.empty())
+        {
+            return true;
+        }
+
+        std::size_t unusedBytes = 0;
+        for (std::size_t i = 0; i < _entryCount; i++)
+        {
+            if (_used.count(_entries[i].key) == 0) unusedBytes += static_cast<std::size_t>(_entries[i].size);
+        }
+        bool dropUnused = unusedBytes > MAX_UNUSED_BYTES;
+
+        //gather everything into memory first, the mapping has to be closed before the file can be replaced
+        std::map<uint64_t, std::vector<uint32_t>> binaries;
+        for (std::size_t i = 0; i < _entryCount; i++)
+        {
+            const ArchiveEntry& entry = _entries[i];
+            if (dropUnused && _used.count(entry.key) == 0)
+            {
+                continue;
+            }
+            std::vector<uint32_t>& binary = binaries[entry.key];
+            binary.resize(static_cast<std::size_t>(entry.size / sizeof(uint32_t)));
+            std::memcpy(binary.data(), _file.data() + entry.offset, static_cast<std::size_t>(entry.size));
+        }
+        for (auto& [key, binary] : _added)
+        {
+            binaries[key] = binary;
+        }
+
+        ArchiveHeader header{ ARCHIVE_MAGIC, ARCHIVE_VERSION, binaries.size() };
+        std::vector<ArchiveEntry> entries;
+        entries.reserve(binaries.size());
+        uint64_t offset = sizeof(ArchiveHeader) + sizeof(ArchiveEntry) * binaries.size();
+        for (const auto& [key, binary] : binaries)
+        {
+            uint64_t size = binary.size() * sizeof(uint32_t);
+            entries.push_back(ArchiveEntry{ key, offset, size });
+            offset += size;
+        }
+
+        std::filesystem::path path(_path);
+        std::error_code error;
+        if (path.has_parent_path())
+        {
+            std::filesystem::create_directories(path.parent_path(), error);
+        }
+
+        std::filesystem::path tempPath = path;
+        tempPath += ".tmp";
+        std::ofstream fout(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!fout.is_open())
+        {
+            CY_BASE_LOG_ERROR("Failed to open {0} to save the shader archive.", tempPath.string());
+            return false;
+        }
+        fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        fout.write(reinterpret_cast<const char*>(entries.data()), sizeof(ArchiveEntry) * entries.size());
+        for (const auto& [key, binary] : binaries)
+        {
+            fout.write(reinterpret_cast<const char*>(binary.data()), binary.size() * sizeof(uint32_t));
+        }
+        fout.close();
+
+        _file.close();
+        _entries = nullptr;
+        _entryCount = 0;
+        std::filesystem::rename(tempPath, path, error);
+        if (error)
+        {
+            CY_BASE_LOG_ERROR("Failed to save the shader archive to {0}: {1}", _path, error.message());
+            map();
+            return false;
+        }
+        CY_BASE_LOG_INFO("Saved {0} shader binaries ({1} new) to {2}", binaries.size(), _added.size(), _path);
+
+        _added.clear();
+        map();
+        //everything now in the archive was either used or just compiled
+        for (const auto& [key, binary] : binaries)
+        {
+            _used.insert(key);
+        }
+        return true;
+    }
+
+    /**
+     * @brief shaderc has no version query of its own. It ships with the Vulkan SDK, so the SDK's header version stands in
+     * for it together with the SPIR-V version it targets.
+    */
+    uint64_t VulkanShaderArchive::compilerVersionHash()
+    {
+        unsigned int spvVersion = 0;
+        unsigned int spvRevision = 0;
+        shaderc_get_spv_version(&spvVersion, &spvRevision);
+
+        uint64_t seed = hashValue(static_cast<uint32_t>(VK_HEADER_VERSION));
+        seed = hashCombine(seed, hashValue(static_cast<uint32_t>(spvVersion)));
+        return hashCombine(seed, hashValue(static_cast<uint32_t>(spvRevision)));
+    }
+
+    /**
+     * @brief Maps the archive and checks that its header and entry table are intact. A damaged or outdated archive is
+     * ignored and replaced on the next save.
+    */
+    bool VulkanShaderArchive::map()
+    {
+        if (!_file.open(_path))
+        {
+            return false;
+        }
+
+        ArchiveHeader header{};
+        bool valid = _file.size() >= sizeof(ArchiveHeader);
+        if (valid)
+        {
+            std::memcpy(&header, _file.data(), sizeof(header));
+            valid = header.magic == ARCHIVE_MAGIC && header.version == ARCHIVE_VERSION
+                && header.entryCount <= (_file.size() - sizeof(ArchiveHeader)) / sizeof(ArchiveEntry);
+        }
+
+        const ArchiveEntry* entries = reinterpret_cast<const ArchiveEntry*>(_file.data() + sizeof(ArchiveHeader));
+        for (uint64_t i = 0; valid && i < header.entryCount; i++)
+        {
+            const ArchiveEntry& entry = entries[i];
+            valid = entry.offset % sizeof(uint32_t) == 0 && entry.size % sizeof(uint32_t) == 0
+                && entry.offset <= _file.size() && entry.size <= _file.size() - entry.offset
+                && (i == 0 || entries[i - 1].key < entry.key);
+        }
+
+        if (!valid)
+        {
+            CY_BASE_LOG_INFO("Shader archive {0} is damaged or outdated and will be rebuilt.", _path);
+            _file.close();
+            return false;
+        }
+
+        _entries = entries;
+        _entryCount = static_cast<std::size_t>(header.entryCount);
+        return true;
+    }
+
+    const VulkanShaderArchive::ArchiveEntry* VulkanShaderArchive::findEntry(uint64_t key) const
+    {
+        const ArchiveEntry* end = _entries + _entryCount;
+        const ArchiveEntry* found = std::lower_bound(_entries, end, key, [](const ArchiveEntry& entry, uint64_t value)
+        {
+            return entry.key < value;
+        });
+        return found != end && found->key == key ? found : nullptr;
+    }
+}
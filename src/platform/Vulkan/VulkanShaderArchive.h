@@ -0,0 +1,77 @@
+#pragma once
+#include "pch.h"
+
+#include "../../core/core.h"
+#include "../../core/MappedFile.h"
+#include "Fwd.hpp"
+
+namespace cy3d
+{
+	constexpr auto SHADER_ARCHIVE_PATH = "resources/cache/shaders.bin";
+
+	/**
+	 * @brief Every compiled SPIR-V binary in one file, keyed by a hash of everything that determines the binary: the
+	 * preprocessed source with its includes resolved, the stage, the compile options and the compiler version. A binary is
+	 * only ever looked up by what it was compiled from, so modification times and which machine the archive was built on do
+	 * not matter.
+	 *
+	 * The archive is memory mapped on creation and binaries are copied out of the mapping on lookup. Newly compiled
+	 * binaries are kept in memory and written out together with the mapped ones by save(), which the destructor calls.
+	 * Binaries that were not used during the run are dropped on save once the archive has grown past MAX_UNUSED_BYTES.
+	 *
+	 * Safe to use from any thread.
+	 *
+	 * File layout: ArchiveHeader, entryCount ArchiveEntry sorted by key, then the binaries.
+	*/
+	class VulkanShaderArchive
+	{
+	public:
+		static constexpr uint32_t ARCHIVE_MAGIC = 0x41535943; //"CYSA"
+		static constexpr uint32_t ARCHIVE_VERSION = 1;
+		static constexpr std::size_t MAX_UNUSED_BYTES = 32 * 1024 * 1024;
+
+	private:
+		struct ArchiveHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t entryCount;
+		};
+
+		struct ArchiveEntry
+		{
+			uint64_t key;
+			//from the start of the file, in bytes
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		std::string _path;
+		std::mutex _mutex;
+		MappedFile _file;
+		//points into _file
+		const ArchiveEntry* _entries{ nullptr };
+		std::size_t _entryCount{ 0 };
+		std::unordered_map<uint64_t, std::vector<uint32_t>> _added;
+		std::unordered_set<uint64_t> _used;
+
+	public:
+		VulkanShaderArchive(const std::string& path = SHADER_ARCHIVE_PATH);
+		~VulkanShaderArchive();
+
+		CY_NOCOPY(VulkanShaderArchive);
+
+		bool find(uint64_t key, std::vector<uint32_t>& outBinary);
+		void add(uint64_t key, const std::vector<uint32_t>& binary);
+		bool save();
+
+		/**
+		 * @brief Identifies the compiler binaries in the archive were built with. Part of every key.
+		*/
+		static uint64_t compilerVersionHash();
+
+	private:
+		bool map();
+		const ArchiveEntry* findEntry(uint64_t key) const;
+	};
+}
@@ -0,0 +1,124 @@
+#include "pch.h"
+
+#include "VulkanShaderOptimizer.h"
+#include "../../core/Hash.h"
+#include "../../core/Profiler.h"
+
+#include <spirv-tools/optimizer.hpp>
+
+namespace cy3d
+{
+    //the words before the first instruction
+    constexpr std::size_t SPIRV_HEADER_WORDS = 5;
+
+    uint64_t ShaderOptimizerSettings::hash() const
+    {
+        uint32_t values[] = { static_cast<uint32_t>(preset), static_cast<uint32_t>(stripDebugInfo) };
+        return hashValue(values);
+    }
+
+    ShaderOptimizerSettings ShaderOptimizerSettings::createDefault()
+    {
+        ShaderOptimizerSettings settings{};
+#ifdef NDEBUG
+        settings.preset = ShaderOptimizationPreset::Performance;
+        settings.stripDebugInfo = true;
+#else
+        settings.preset = ShaderOptimizationPreset::Basic;
+        settings.stripDebugInfo = false;
+#endif
+        return settings;
+    }
+
+    VulkanShaderOptimizer::VulkanShaderOptimizer(const ShaderOptimizerSettings& settings) : _settings(settings)
+    {
+
+    }
+
+    bool VulkanShaderOptimizer::optimize(const std::string& name, const std::vector<uint32_t>& binary, std::vector<uint32_t>& outBinary) const
+    {
+        outBinary = binary;
+        if (_settings.preset == ShaderOptimizationPreset::None)
+        {
+            return true;
+        }
+        CY_PROFILE_FUNCTION();
+
+        //optimizers are cheap to create and not safe to share between threads
+        spvtools::Optimizer optimizer(SPV_ENV_VULKAN_1_2);
+        optimizer.SetMessageConsumer([&name](spv_message_level_t level, const char*, const spv_position_t& position, const char* message)
+        {
+            if (level <= SPV_MSG_ERROR)
+            {
+                CY_BASE_LOG_ERROR("Optimizing {0} failed at word {1}: {2}", name, position.index, message);
+            }
+        });
+
+        switch (_settings.preset)
+        {
+            case ShaderOptimizationPreset::Basic:
+                optimizer.RegisterPass(spvtools::CreateFoldSpecConstantOpAndCompositePass())
+                    .RegisterPass(spvtools::CreateCCPPass())
+                    .RegisterPass(spvtools::CreateEliminateDeadFunctionsPass())
+                    .RegisterPass(spvtools::CreateAggressiveDCEPass())
+                    .RegisterPass(spvtools::CreateEliminateDeadConstantPass());
+                break;
+            case ShaderOptimizationPreset::Performance: optimizer.RegisterPerformancePasses(); break;
+            case ShaderOptimizationPreset::Size:        optimizer.RegisterSizePasses(); break;
+            default: break;
+        }
+
+        spvtools::OptimizerOptions options;
+        //shaderc already validated the module
+        options.set_run_validator(false);
+        options.set_preserve_bindings(true);
+        options.set_preserve_spec_constants(true);
+
+        std::vector<uint32_t> optimized;
+        if (!optimizer.Run(binary.data(), binary.size(), &optimized, options))
+        {
+            CY_BASE_LOG_ERROR("Failed to optimize {0}, it is archived unoptimized.", name);
+            return false;
+        }
+
+        CY_BASE_LOG_INFO("Optimized {0}: {1} -> {2} instructions, {3} -> {4} bytes.", name, countInstructions(binary), countInstructions(optimized),
+            binary.size() * sizeof(uint32_t), optimized.size() * sizeof(uint32_t));
+        outBinary = std::move(optimized);
+        return true;
+    }
+
+    std::vector<uint32_t> VulkanShaderOptimizer::stripDebugInfo(const std::vector<uint32_t>& binary) const
+    {
+        if (!_settings.stripDebugInfo)
+        {
+            return binary;
+        }
+
+        spvtools::Optimizer optimizer(SPV_ENV_VULKAN_1_2);
+        optimizer.RegisterPass(spvtools::CreateStripDebugInfoPass());
+        std::vector<uint32_t> stripped;
+        if (!optimizer.Run(binary.data(), binary.size(), &stripped))
+        {
+            return binary;
+        }
+        return stripped;
+    }
+
+    /**
+     * @brief The high 16 bits of an instruction's first word are its length in words.
+    */
+    std::size_t VulkanShaderOptimizer::countInstructions(const std::vector<uint32_t>& binary)
+    {
+        std::size_t count = 0;
+        for (std::size_t word = SPIRV_HEADER_WORDS; word < binary.size(); count++)
+        {
+            uint32_t length = binary[word] >> 16;
+            if (length == 0)
+            {
+                break; //malformed, would never advance
+            }
+            word += length;
+        }
+        return count;
+    }
+}
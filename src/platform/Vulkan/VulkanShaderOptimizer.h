@@ -0,0 +1,71 @@
+#pragma once
+#include "pch.h"
+
+#include "../../core/core.h"
+#include "Fwd.hpp"
+
+namespace cy3d
+{
+	enum class ShaderOptimizationPreset : uint32_t
+	{
+		//the binary is archived as shaderc emitted it
+		None = 0,
+		//constant folding and dead code elimination only, cheap enough to run on every hot reload
+		Basic,
+		//spirv-opt -O
+		Performance,
+		//spirv-opt -Os
+		Size
+	};
+
+	struct ShaderOptimizerSettings
+	{
+		ShaderOptimizationPreset preset{ ShaderOptimizationPreset::Performance };
+		/**
+		 * @brief Strips names, source and line info from the archived binary that is handed to the driver. Reflection
+		 * looks resources and specialization constants up by name, so it is taken and archived before the strip.
+		*/
+		bool stripDebugInfo{ true };
+
+		uint64_t hash() const;
+
+		/**
+		 * @brief Basic with debug info in debug builds so shaders stay debuggable and reload quickly, Performance without
+		 * debug info otherwise.
+		*/
+		static ShaderOptimizerSettings createDefault();
+	};
+
+	/**
+	 * @brief Runs spirv-tools over every compiled stage before it is archived. Bindings and specialization constants are
+	 * always preserved, so an optimized stage has the same descriptor set layouts as the unoptimized one even if it no
+	 * longer reads some of its resources.
+	 *
+	 * The settings are part of every shader archive key, changing them recompiles every shader once. Safe to use from
+	 * any thread.
+	*/
+	class VulkanShaderOptimizer
+	{
+	private:
+		ShaderOptimizerSettings _settings;
+
+	public:
+		VulkanShaderOptimizer(const ShaderOptimizerSettings& settings = ShaderOptimizerSettings::createDefault());
+
+		CY_NOCOPY(VulkanShaderOptimizer);
+
+		/**
+		 * @brief Leaves outBinary as a copy of binary and returns false if the optimizer fails. name is only used for logging.
+		*/
+		bool optimize(const std::string& name, const std::vector<uint32_t>& binary, std::vector<uint32_t>& outBinary) const;
+
+		/**
+		 * @brief Returns binary without debug info if the settings ask for it, otherwise binary unchanged.
+		*/
+		std::vector<uint32_t> stripDebugInfo(const std::vector<uint32_t>& binary) const;
+
+		const ShaderOptimizerSettings& getSettings() const { return _settings; }
+
+		static std::size_t countInstructions(const std::vector<uint32_t>& binary);
+	};
+}
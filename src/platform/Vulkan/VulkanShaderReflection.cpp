@@ -0,0 +1,261 @@
+#include "pch.h"
+
+#include "VulkanShaderReflection.h"
+#include "../../core/Profiler.h"
+
+namespace cy3d
+{
+    namespace
+    {
+        /**
+         * @brief Appends words to a serialized reflection. Strings are stored as their length followed by their
+         * characters padded to whole words.
+        */
+        class ReflectionWriter
+        {
+        private:
+            std::vector<uint32_t>& _data;
+
+        public:
+            ReflectionWriter(std::vector<uint32_t>& data) : _data(data) {}
+
+            void write(uint32_t value) { _data.push_back(value); }
+
+            void write(const std::string& value)
+            {
+                write(static_cast<uint32_t>(value.size()));
+                std::size_t first = _data.size();
+                _data.resize(first + (value.size() + sizeof(uint32_t) - 1) / sizeof(uint32_t), 0);
+                std::memcpy(_data.data() + first, value.data(), value.size());
+            }
+        };
+
+        /**
+         * @brief Reads what ReflectionWriter wrote. Every read past the end fails and leaves the reader failed.
+        */
+        class ReflectionReader
+        {
+        private:
+            const std::vector<uint32_t>& _data;
+            std::size_t _word{ 0 };
+            bool _failed{ false };
+
+        public:
+            ReflectionReader(const std::vector<uint32_t>& data) : _data(data) {}
+
+            bool failed() const { return _failed; }
+            bool atEnd() const { return _word == _data.size(); }
+
+            uint32_t read()
+            {
+                if (_failed || _word >= _data.size())
+                {
+                    _failed = true;
+                    return 0;
+                }
+                return _data[_word++];
+            }
+
+            std::string readString()
+            {
+                std::size_t length = read();
+                std::size_t words = (length + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+                if (_failed || words > _data.size() - _word)
+                {
+                    _failed = true;
+                    return std::string();
+                }
+                std::string value(length, '\0');
+                std::memcpy(value.data(), _data.data() + _word, length);
+                _word += words;
+                return value;
+            }
+        };
+
+        VkFormat vertexInputFormat(const spirv_cross::SPIRType& type)
+        {
+            static const VkFormat floatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+            static const VkFormat intFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+            static const VkFormat uintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+            //matrices take one location per column and are not a single format
+            if (type.vecsize < 1 || type.vecsize > 4 || type.columns != 1)
+            {
+                return VK_FORMAT_UNDEFINED;
+            }
+            switch (type.basetype)
+            {
+                case spirv_cross::SPIRType::Float:  return floatFormats[type.vecsize - 1];
+                case spirv_cross::SPIRType::Int:    return intFormats[type.vecsize - 1];
+                case spirv_cross::SPIRType::UInt:   return uintFormats[type.vecsize - 1];
+                default:                            return VK_FORMAT_UNDEFINED;
+            }
+        }
+    }
+
+    void ShaderStageReflection::serialize(std::vector<uint32_t>& outData) const
+    {
+        ReflectionWriter writer(outData);
+        writer.write(REFLECTION_VERSION);
+
+        writer.write(static_cast<uint32_t>(resources.size()));
+        for (const auto& resource : resources)
+        {
+            writer.write(static_cast<uint32_t>(resource.type));
+            writer.write(resource.set);
+            writer.write(resource.binding);
+            writer.write(resource.size);
+            writer.write(resource.attachmentIndex);
+            writer.write(resource.name);
+        }
+
+        writer.write(static_cast<uint32_t>(vertexInputs.size()));
+        for (const auto& input : vertexInputs)
+        {
+            writer.write(input.location);
+            writer.write(static_cast<uint32_t>(input.format));
+            writer.write(input.name);
+        }
+
+        writer.write(static_cast<uint32_t>(specializationConstants.size()));
+        for (const auto& constant : specializationConstants)
+        {
+            writer.write(constant.id);
+            writer.write(constant.name);
+        }
+
+        writer.write(pushConstantOffset);
+        writer.write(pushConstantSize);
+
+        for (uint32_t size : workgroupSize)
+        {
+            writer.write(size);
+        }
+    }
+
+    bool ShaderStageReflection::deserialize(const std::vector<uint32_t>& data)
+    {
+        *this = ShaderStageReflection{};
+        ReflectionReader reader(data);
+        if (reader.read() != REFLECTION_VERSION)
+        {
+            return false;
+        }
+
+        //the counts are checked against what is left so a damaged count can not allocate unbounded memory
+        uint32_t resourceCount = reader.read();
+        for (uint32_t i = 0; i < resourceCount && !reader.failed(); i++)
+        {
+            ShaderResourceReflection resource{};
+            resource.type = static_cast<ShaderResourceType>(reader.read());
+            resource.set = reader.read();
+            resource.binding = reader.read();
+            resource.size = reader.read();
+            resource.attachmentIndex = reader.read();
+            resource.name = reader.readString();
+            resources.push_back(std::move(resource));
+        }
+
+        uint32_t inputCount = reader.read();
+        for (uint32_t i = 0; i < inputCount && !reader.failed(); i++)
+        {
+            ShaderVertexInputReflection input{};
+            input.location = reader.read();
+            input.format = static_cast<VkFormat>(reader.read());
+            input.name = reader.readString();
+            vertexInputs.push_back(std::move(input));
+        }
+
+        uint32_t constantCount = reader.read();
+        for (uint32_t i = 0; i < constantCount && !reader.failed(); i++)
+        {
+            ShaderSpecializationConstantReflection constant{};
+            constant.id = reader.read();
+            constant.name = reader.readString();
+            specializationConstants.push_back(std::move(constant));
+        }
+
+        pushConstantOffset = reader.read();
+        pushConstantSize = reader.read();
+
+        for (uint32_t& size : workgroupSize)
+        {
+            size = reader.read();
+        }
+
+        if (reader.failed() || !reader.atEnd())
+        {
+            *this = ShaderStageReflection{};
+            return false;
+        }
+        return true;
+    }
+
+    ShaderStageReflection ShaderStageReflection::reflect(VkShaderStageFlagBits stage, const std::vector<uint32_t>& binary)
+    {
+        CY_PROFILE_FUNCTION();
+        ShaderStageReflection reflection{};
+        spirv_cross::Compiler compiler(binary);
+        auto shaderResources = compiler.get_shader_resources();
+
+        auto addResource = [&](ShaderResourceType type, const spirv_cross::Resource& resource, bool isBuffer)
+        {
+            ShaderResourceReflection reflected{};
+            reflected.type = type;
+            reflected.set = compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
+            reflected.binding = compiler.get_decoration(resource.id, spv::DecorationBinding);
+            reflected.size = isBuffer ? static_cast<uint32_t>(compiler.get_declared_struct_size(compiler.get_type(resource.base_type_id))) : 0;
+            reflected.attachmentIndex = type == ShaderResourceType::InputAttachment
+                ? compiler.get_decoration(resource.id, spv::DecorationInputAttachmentIndex) : 0;
+            reflected.name = resource.name;
+            reflection.resources.push_back(std::move(reflected));
+        };
+
+        for (const auto& resource : shaderResources.uniform_buffers) addResource(ShaderResourceType::UniformBuffer, resource, true);
+        for (const auto& resource : shaderResources.storage_buffers) addResource(ShaderResourceType::StorageBuffer, resource, true);
+        for (const auto& resource : shaderResources.sampled_images) addResource(ShaderResourceType::CombinedImageSampler, resource, false);
+        for (const auto& resource : shaderResources.storage_images) addResource(ShaderResourceType::StorageImage, resource, false);
+        for (const auto& resource : shaderResources.subpass_inputs) addResource(ShaderResourceType::InputAttachment, resource, false);
+
+        if (stage == VK_SHADER_STAGE_VERTEX_BIT)
+        {
+            for (const auto& resource : shaderResources.stage_inputs)
+            {
+                if (compiler.has_decoration(resource.id, spv::DecorationBuiltIn))
+                {
+                    continue;
+                }
+                ShaderVertexInputReflection input{};
+                input.location = compiler.get_decoration(resource.id, spv::DecorationLocation);
+                input.format = vertexInputFormat(compiler.get_type(resource.type_id));
+                input.name = resource.name;
+                reflection.vertexInputs.push_back(std::move(input));
+            }
+            std::sort(reflection.vertexInputs.begin(), reflection.vertexInputs.end(), [](const auto& a, const auto& b) { return a.location < b.location; });
+        }
+
+        for (const auto& constant : compiler.get_specialization_constants())
+        {
+            reflection.specializationConstants.push_back(ShaderSpecializationConstantReflection{ constant.constant_id, compiler.get_name(constant.id) });
+        }
+
+        if (stage == VK_SHADER_STAGE_COMPUTE_BIT)
+        {
+            for (uint32_t axis = 0; axis < 3; axis++)
+            {
+                reflection.workgroupSize[axis] = std::max(compiler.get_execution_mode_argument(spv::ExecutionModeLocalSize, axis), 1u);
+            }
+        }
+
+        //GLSL allows one push constant block per stage
+        for (const auto& resource : shaderResources.push_constant_buffers)
+        {
+            const auto& type = compiler.get_type(resource.base_type_id);
+            uint32_t offset = type.member_types.empty() ? 0 : compiler.type_struct_member_offset(type, 0);
+            uint32_t size = static_cast<uint32_t>(compiler.get_declared_struct_size(type));
+            reflection.pushConstantOffset = offset;
+            reflection.pushConstantSize = size > offset ? size - offset : 0;
+        }
+        return reflection;
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "pch.h"
+
+#include "Vulkan.h"
+#include "../../core/core.h"
+
+namespace cy3d
+{
+	enum class ShaderResourceType : uint32_t
+	{
+		UniformBuffer = 0,
+		StorageBuffer,
+		CombinedImageSampler,
+		StorageImage,
+		InputAttachment
+	};
+
+	struct ShaderResourceReflection
+	{
+		ShaderResourceType type{ ShaderResourceType::UniformBuffer };
+		uint32_t set{ 0 };
+		uint32_t binding{ 0 };
+		//declared size of buffers, 0 for images
+		uint32_t size{ 0 };
+		//input attachments only
+		uint32_t attachmentIndex{ 0 };
+		std::string name;
+	};
+
+	struct ShaderVertexInputReflection
+	{
+		uint32_t location{ 0 };
+		//VK_FORMAT_UNDEFINED for types a vertex attribute can not be fetched as
+		VkFormat format{ VK_FORMAT_UNDEFINED };
+		std::string name;
+	};
+
+	struct ShaderSpecializationConstantReflection
+	{
+		uint32_t id{ 0 };
+		std::string name;
+	};
+
+	/**
+	 * @brief Everything VulkanShader needs to know about one compiled stage. Reflecting a stage means parsing it with
+	 * spirv_cross, so the reflection is serialized into the shader archive next to the binary and a stage loaded from
+	 * the archive is never parsed again.
+	*/
+	struct ShaderStageReflection
+	{
+		//bump whenever the serialized layout or what is reflected changes, it is part of the archive key
+		static constexpr uint32_t REFLECTION_VERSION = 2;
+
+		std::vector<ShaderResourceReflection> resources;
+		//vertex stage only, builtins are skipped
+		std::vector<ShaderVertexInputReflection> vertexInputs;
+		std::vector<ShaderSpecializationConstantReflection> specializationConstants;
+		//a size of 0 means the stage declares no push constant block
+		uint32_t pushConstantOffset{ 0 };
+		uint32_t pushConstantSize{ 0 };
+		//compute stage only, the local_size_x/y/z the stage was compiled with
+		std::array<uint32_t, 3> workgroupSize{ 1, 1, 1 };
+
+		void serialize(std::vector<uint32_t>& outData) const;
+		/**
+		 * @brief Returns false and leaves the reflection empty if data was written by a different REFLECTION_VERSION or
+		 * is truncated.
+		*/
+		bool deserialize(const std::vector<uint32_t>& data);
+
+		static ShaderStageReflection reflect(VkShaderStageFlagBits stage, const std::vector<uint32_t>& binary);
+	};
+
+	struct CompiledShaderStage
+	{
+		std::vector<uint32_t> binary;
+		ShaderStageReflection reflection;
+	};
+
+	using CompiledShaderStages = std::unordered_map<VkShaderStageFlagBits, CompiledShaderStage>;
+}
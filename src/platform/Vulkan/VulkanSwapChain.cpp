@@ -3,6 +3,8 @@
 #include "VulkanSwapChain.h"
 #include "VulkanContext.h"
 #include "VulkanDescriptors.h"
+#include "VulkanDeletionQueue.h"
+#include "../../core/Profiler.h"
 
 #include <Logi/Logi.h>
 
@@ -19,6 +21,19 @@ namespace cy3d {
         createSyncObjects();
     }
 
+    /**
+     * @brief Creates a headless swap chain that renders into offscreen images of the given extent instead of presenting to a surface.
+    */
+    VulkanSwapChain::VulkanSwapChain(VulkanContext& context, VkExtent2D extent) : _headless(true), offscreenExtent(extent), cyContext(context)
+    {
+        createSwapChain();
+        createImageViews();
+        createDepthResources();
+        createRenderPass();
+        createFramebuffers();
+        createSyncObjects();
+    }
+
     VulkanSwapChain::~VulkanSwapChain()
     {
         cleanup();
@@ -46,7 +61,8 @@ namespace cy3d {
         {
             vkDestroyFramebuffer(cyContext.getDevice()->device(), swapChainFramebuffers[i], nullptr);
         }
-        for (size_t i = 0; i < swapChainImageViews.size(); i++)
+        //offscreen image views are owned by their VulkanImage
+        for (size_t i = 0; i < swapChainImageViews.size() && !_headless; i++)
         {
             vkDestroyImageView(cyContext.getDevice()->device(), swapChainImageViews[i], nullptr);
         }
@@ -59,31 +75,83 @@ namespace cy3d {
     }
 
     /**
-     * @brief Recreates the swap chain. Will first block until the window is not minimized, then will block until the device is idle
-     * and, then begin cleaning up and recreating the swap chain with the new window extent.
+     * @brief Recreates the swap chain with the new window extent without waiting for the device to go idle. The old swap chain
+     * is handed to the new one as oldSwapchain and everything that frames still in flight may be using is retired through
+     * the deletion queue. The render pass only depends on the attachment formats so it is kept, along with every pipeline
+     * built against it, unless the surface format changed.
     */
     void VulkanSwapChain::reCreate()
     {
-        cleanup();
+        VkFormat oldImageFormat = swapChainImageFormat;
+        retireImageResources();
 
         createSwapChain();
         createImageViews();
-        createRenderPass();
+        if (swapChainImageFormat != oldImageFormat)
+        {
+            VkDevice device = cyContext.getDevice()->device();
+            VkRenderPass oldRenderPass = _renderPass;
+            cyContext.getDeletionQueue()->push([device, oldRenderPass]() { vkDestroyRenderPass(device, oldRenderPass, nullptr); });
+            createRenderPass();
+        }
         createDepthResources();
         createFramebuffers();
 
-        //because sync objects are being reused the imagesInFlight need to be reset here.
-        imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+        //the new images have never been submitted so no fence guards them
+        imagesInFlight.assign(imageCount(), VK_NULL_HANDLE);
+    }
+
+    /**
+     * @brief Hands the framebuffers, image views and depth images of the current swap chain images to the deletion queue.
+    */
+    void VulkanSwapChain::retireImageResources()
+    {
+        VkDevice device = cyContext.getDevice()->device();
+        std::vector<VkFramebuffer> framebuffers = std::move(swapChainFramebuffers);
+        std::vector<VkImageView> imageViews = std::move(swapChainImageViews);
+        auto depth = std::make_shared<std::vector<std::unique_ptr<VulkanImage>>>(std::move(depthImages));
+        auto offscreen = std::make_shared<std::vector<std::unique_ptr<VulkanImage>>>(std::move(offscreenImages));
+        swapChainFramebuffers.clear();
+        swapChainImageViews.clear();
+        depthImages.clear();
+        offscreenImages.clear();
+        if (_headless)
+        {
+            imageViews.clear();
+        }
+
+        cyContext.getDeletionQueue()->push([device, framebuffers, imageViews, depth, offscreen]()
+        {
+            for (auto framebuffer : framebuffers)
+            {
+                vkDestroyFramebuffer(device, framebuffer, nullptr);
+            }
+            for (auto imageView : imageViews)
+            {
+                vkDestroyImageView(device, imageView, nullptr);
+            }
+            depth->clear();
+            offscreen->clear();
+        });
     }
 
     VkResult VulkanSwapChain::acquireNextImage(uint32_t* imageIndex)
     {
+        CY_PROFILE_SCOPE("VulkanSwapChain::acquireNextImage");
         /**
          * The vkWaitForFences function takes an array of fences and waits for either any or all of them to be signaled before returning. 
          * The VK_TRUE we pass here indicates that we want to wait for all fences
         */
         vkWaitForFences(cyContext.getDevice()->device(), 1, &inFlightFences[cyContext.getCurrentFrameIndex()], VK_TRUE, UINT64_MAX);
 
+        //offscreen images are handed out round robin, submitCommandBuffers waits on the fence of the frame that last used one
+        if (_headless)
+        {
+            *imageIndex = nextOffscreenImage;
+            nextOffscreenImage = (nextOffscreenImage + 1) % static_cast<uint32_t>(imageCount());
+            return VK_SUCCESS;
+        }
+
         /**
          * Acquire an image from the swap chain.
          * The first two parameters of vkAcquireNextImageKHR are the logical device and the swap chain from which we 
@@ -108,8 +176,10 @@ namespace cy3d {
         vkResetFences(cyContext.getDevice()->device(), 1, &inFlightFences[cyContext.getCurrentFrameIndex()]);
     }
 
-    VkResult VulkanSwapChain::submitCommandBuffers(const VkCommandBuffer* cmdBuffer, uint32_t* imageIndex)
+    VkResult VulkanSwapChain::submitCommandBuffers(const VkCommandBuffer* cmdBuffer, uint32_t* imageIndex, VkSemaphore computeFinished,
+        VkPipelineStageFlags computeWaitStages)
     {
+        CY_PROFILE_SCOPE("VulkanSwapChain::submitCommandBuffers");
         //Check if a previous frame is using this image (i.e. there is its fence to wait on)
         if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE)
         {
@@ -126,12 +196,24 @@ namespace cy3d {
         VkSubmitInfo submitInfo = {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-        VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[cyContext.getCurrentFrameIndex()] };
-        VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+        std::array<VkSemaphore, 2> waitSemaphores{};
+        std::array<VkPipelineStageFlags, 2> waitStages{};
+        uint32_t waitCount = 0;
         //These three parameters specify which semaphores to wait on before execution begins and in which stage(s) of the pipeline to wait. 
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
+        //Nothing signals the semaphores of a headless swap chain since no image is acquired from the presentation engine.
+        if (!_headless)
+        {
+            waitSemaphores[waitCount] = imageAvailableSemaphores[cyContext.getCurrentFrameIndex()];
+            waitStages[waitCount++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        }
+        if (computeFinished != VK_NULL_HANDLE)
+        {
+            waitSemaphores[waitCount] = computeFinished;
+            waitStages[waitCount++] = computeWaitStages;
+        }
+        submitInfo.waitSemaphoreCount = waitCount;
+        submitInfo.pWaitSemaphores = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = waitStages.data();
 
         //These two parameters specify which command buffers to actually submit for execution
         submitInfo.commandBufferCount = 1;
@@ -139,7 +221,7 @@ namespace cy3d {
 
         //The signalSemaphoreCount and pSignalSemaphores parameters specify which semaphores to signal once the command buffer(s) have finished execution
         VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[cyContext.getCurrentFrameIndex()] };
-        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.signalSemaphoreCount = _headless ? 0 : 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
         resetFences(cyContext.getCurrentFrameIndex());
@@ -153,6 +235,12 @@ namespace cy3d {
         */
         VK_CHECK(vkQueueSubmit(cyContext.getDevice()->graphicsQueue(), 1, &submitInfo, inFlightFences[cyContext.getCurrentFrameIndex()]));
 
+        if (_headless)
+        {
+            lastSubmittedImage = *imageIndex;
+            return VK_SUCCESS;
+        }
+
 
         /**
          * The last step of drawing a frame is submitting the result back to 
@@ -176,8 +264,38 @@ namespace cy3d {
         return vkQueuePresentKHR(cyContext.getDevice()->presentQueue(), &presentInfo);
     }
 
+    /**
+     * @brief Copies the last submitted offscreen image into outPixels as tightly packed OFFSCREEN_IMAGE_FORMAT texels,
+     * width * height * 4 bytes with the first row at the top. Blocks until the frame has finished rendering.
+    */
+    void VulkanSwapChain::readPixels(std::vector<uint8_t>& outPixels)
+    {
+        CY_ASSERT(_headless == true);
+
+        VulkanImage& image = *offscreenImages[lastSubmittedImage];
+        VkDeviceSize size = static_cast<VkDeviceSize>(getWidth()) * getHeight() * 4;
+
+        VulkanAllocator::buffer_type readbackBuffer;
+        VulkanAllocator::buffer_memory_type readbackMemory;
+        BufferCreateInfo readbackInfo = BufferCreateInfo::createReadbackBufferInfo(size);
+        cyContext.getAllocator()->createBuffer(readbackInfo, readbackBuffer, readbackMemory);
+
+        //submitted after the frame on the same queue and waited on, so the frame has finished once this returns
+        cyContext.getAllocator()->copyImageToBuffer(image.getImage(), readbackBuffer, image.getImageInfo());
+
+        outPixels.resize(static_cast<std::size_t>(size));
+        cyContext.getAllocator()->readBuffer(readbackInfo.allocInfo, readbackMemory, size, outPixels.data());
+        cyContext.getAllocator()->destroyBuffer(readbackBuffer, readbackMemory);
+    }
+
     void VulkanSwapChain::createSwapChain()
     {
+        if (_headless)
+        {
+            createOffscreenImages();
+            return;
+        }
+
         SwapChainSupportDetails swapChainSupport = cyContext.getDevice()->getSwapChainSupport();
 
         VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
@@ -265,11 +383,19 @@ namespace cy3d {
          * for example because the window was resized. In that case the swap chain actually needs to be recreated from scratch and a 
          * reference to the old one must be specified in this field.
         */
-        createInfo.oldSwapchain = VK_NULL_HANDLE;
+        VkSwapchainKHR oldSwapChain = swapChain;
+        createInfo.oldSwapchain = oldSwapChain;
 
 
         VK_CHECK(vkCreateSwapchainKHR(cyContext.getDevice()->device(), &createInfo, nullptr, &swapChain));
 
+        //the old swap chain is retired by the call above but its images may still be in use by frames in flight
+        if (oldSwapChain != VK_NULL_HANDLE)
+        {
+            VkDevice device = cyContext.getDevice()->device();
+            cyContext.getDeletionQueue()->push([device, oldSwapChain]() { vkDestroySwapchainKHR(device, oldSwapChain, nullptr); });
+        }
+
         /**
          * We only specified a minimum number of images in the swap chain, so the implementation is
          * allowed to create a swap chain with more. That's why we'll first query the final number of
@@ -289,8 +415,46 @@ namespace cy3d {
      * image and which part of the image to access, for example if it should be treated as a 2D 
      * texture depth texture without any mipmapping levels.
     */
+    void VulkanSwapChain::createOffscreenImages()
+    {
+        swapChainImageFormat = OFFSCREEN_IMAGE_FORMAT;
+        swapChainExtent = offscreenExtent;
+
+        ImageInfo info
+        {
+            swapChainImageFormat,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            swapChainExtent.width,
+            swapChainExtent.height,
+            static_cast<VkDeviceSize>(swapChainExtent.width) * swapChainExtent.height * 4
+        };
+
+        //one image per frame in flight is enough since nothing holds on to them after the frame's fence signals
+        offscreenImages.resize(MAX_FRAMES_IN_FLIGHT);
+        swapChainImages.resize(MAX_FRAMES_IN_FLIGHT);
+        for (std::size_t i = 0; i < offscreenImages.size(); i++)
+        {
+            ImageCreateInfo imageInfo = ImageCreateInfo::createDefaultImageInfo(info);
+            offscreenImages[i] = std::make_unique<VulkanImage>(cyContext, imageInfo);
+            swapChainImages[i] = offscreenImages[i]->getImage();
+        }
+        nextOffscreenImage = 0;
+    }
+
     void VulkanSwapChain::createImageViews() 
     {
+        if (_headless)
+        {
+            swapChainImageViews.resize(offscreenImages.size());
+            for (std::size_t i = 0; i < offscreenImages.size(); i++)
+            {
+                swapChainImageViews[i] = offscreenImages[i]->getImageView();
+            }
+            return;
+        }
+
         swapChainImageViews.resize(swapChainImages.size());
         for (size_t i = 0; i < swapChainImages.size(); i++)
         {
@@ -421,7 +585,7 @@ namespace cy3d {
          * VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL: Images to be used as destination for a memory copy operation
         */
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        colorAttachment.finalLayout = _headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 
         /**
@@ -472,6 +636,23 @@ namespace cy3d {
         dependency.srcAccessMask = 0;
         dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
+        /**
+         * Offscreen images are copied out by readPixels after the render pass. The color writes and the transition to
+         * the final layout have to be finished before that copy reads the image.
+        */
+        VkSubpassDependency readbackDependency{};
+        readbackDependency.srcSubpass = 0;
+        readbackDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+        readbackDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        readbackDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        readbackDependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        readbackDependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        std::vector<VkSubpassDependency> dependencies{ dependency };
+        if (_headless)
+        {
+            dependencies.push_back(readbackDependency);
+        }
 
         /**
          * The render pass object can then be created by filling in the VkRenderPassCreateInfo structure with an array of
@@ -484,8 +665,8 @@ namespace cy3d {
         renderPassInfo.pAttachments = attachments.data();
         renderPassInfo.subpassCount = 1;
         renderPassInfo.pSubpasses = &subpass;
-        renderPassInfo.dependencyCount = 1;
-        renderPassInfo.pDependencies = &dependency;
+        renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+        renderPassInfo.pDependencies = dependencies.data();
 
         VK_CHECK(vkCreateRenderPass(cyContext.getDevice()->device(), &renderPassInfo, nullptr, &_renderPass));
     }
@@ -47,6 +47,7 @@ namespace cy3d {
 
     public:
         static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+        static constexpr VkFormat OFFSCREEN_IMAGE_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
 
     private:
         VkFormat swapChainImageFormat;
@@ -58,7 +59,7 @@ namespace cy3d {
          * how many samples to use for each of them and how their contents should be handled throughout the rendering
          * operations. All of this information is wrapped in a render pass object.
         */
-        VkRenderPass _renderPass;
+        VkRenderPass _renderPass{ VK_NULL_HANDLE };
 
         /**
          * A framebuffer object references all of the VkImageView objects that represent the attachments. 
@@ -74,6 +75,16 @@ namespace cy3d {
         std::vector<VkImage> swapChainImages;
         std::vector<VkImageView> swapChainImageViews;
 
+        /**
+         * Headless swap chains own their images instead of getting them from a VkSwapchainKHR. They are handed out
+         * round robin and left in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL at the end of the render pass so they can be read back.
+        */
+        bool _headless{ false };
+        VkExtent2D offscreenExtent{};
+        std::vector<std::unique_ptr<VulkanImage>> offscreenImages;
+        uint32_t nextOffscreenImage{ 0 };
+        uint32_t lastSubmittedImage{ 0 };
+
         VulkanContext& cyContext;
 
         /**
@@ -86,7 +97,7 @@ namespace cy3d {
         */
         //VkExtent2D windowExtent;
 
-        VkSwapchainKHR swapChain;
+        VkSwapchainKHR swapChain{ VK_NULL_HANDLE };
 
         std::vector<VkSemaphore> imageAvailableSemaphores; //signals that an image has been acquired and is ready for rendering
         std::vector<VkSemaphore> renderFinishedSemaphores; //signals that rendering has finished and presentation can happen
@@ -108,6 +119,7 @@ namespace cy3d {
 
         //VulkanSwapChain(VulkanDevice& d, VulkanWindow& w);
         VulkanSwapChain(VulkanContext& context);
+        VulkanSwapChain(VulkanContext& context, VkExtent2D extent);
         ~VulkanSwapChain();
 
         void reCreate();
@@ -130,16 +142,25 @@ namespace cy3d {
         uint32_t getWidth() { return swapChainExtent.width; }
         uint32_t getHeight() { return swapChainExtent.height; }
         VkRenderPass& getRenderPass() { return _renderPass; }
+        bool isHeadless() { return _headless; }
 
         float extentAspectRatio() { return static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height); }
         void resetFences(std::size_t frameNumber);
         VkResult acquireNextImage(uint32_t* imageIndex);
-        VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
+        /**
+         * @brief Submits the frame's command buffer to the graphics queue. When computeFinished is not VK_NULL_HANDLE the
+         * submission also waits on it at computeWaitStages, see VulkanRenderer::submitAsyncCompute.
+        */
+        VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex, VkSemaphore computeFinished = VK_NULL_HANDLE,
+            VkPipelineStageFlags computeWaitStages = 0);
+        void readPixels(std::vector<uint8_t>& outPixels);
 
     private:
         void cleanup();  
+        void retireImageResources();
 
         void createSwapChain();
+        void createOffscreenImages();
         void createImageViews();
         void createDepthResources();
         void createRenderPass();
@@ -3,6 +3,8 @@
 #include <stb_image/stb_image.h>
 
 #include "VulkanTexture.h"
+#include "VulkanDescriptorSetCache.h"
+#include "../../core/Profiler.h"
 
 
 namespace cy3d
@@ -31,6 +33,10 @@ namespace cy3d
     {
         if (_sampler != nullptr)
         {
+            if (cyContext.hasDescriptorSetCache())
+            {
+                cyContext.getDescriptorSetCache()->invalidate(_sampler);
+            }
             vkDestroySampler(cyContext.getDevice()->device(), _sampler, nullptr);
         }   
     }
@@ -46,6 +52,7 @@ namespace cy3d
     */
 	VulkanTexture::VulkanTexture(VulkanContext& context, std::string path) : cyContext(context), _path(path)
 	{
+        CY_PROFILE_SCOPE("VulkanTexture::upload");
         int texWidth, texHeight, texChannels;
         //load texture
         stbi_uc* pixels = stbi_load(_path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
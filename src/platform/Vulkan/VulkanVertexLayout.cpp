@@ -0,0 +1,152 @@
+#include "pch.h"
+
+#include "VulkanVertexLayout.h"
+#include "VulkanShader.h"
+#include "VulkanBuffer.h"
+#include "../../VertexLayout.h"
+
+namespace cy3d
+{
+    VertexInputLayout& VertexInputLayout::addBinding(uint32_t binding, uint32_t stride, VkVertexInputRate inputRate)
+    {
+        CY_ASSERT(binding < MAX_VERTEX_BINDINGS);
+        CY_ASSERT(findBinding(binding) == nullptr); //every binding is described once
+        _bindings.push_back(VertexBindingLayout{ binding, stride, inputRate });
+        return *this;
+    }
+
+    VertexInputLayout& VertexInputLayout::addAttribute(const std::string& name, uint32_t location, uint32_t binding, VkFormat format, uint32_t offset, uint32_t columns)
+    {
+        CY_ASSERT(format != VK_FORMAT_UNDEFINED);
+        CY_ASSERT(columns >= 1 && columns <= 4);
+        _attributes.push_back(VertexAttributeLayout{ name, location, binding, format, offset, columns });
+        return *this;
+    }
+
+    const VertexBindingLayout* VertexInputLayout::findBinding(uint32_t binding) const
+    {
+        auto found = std::find_if(_bindings.begin(), _bindings.end(), [binding](const VertexBindingLayout& layout) { return layout.binding == binding; });
+        return found == _bindings.end() ? nullptr : &*found;
+    }
+
+    bool VertexInputLayout::resolve(const VulkanShader& shader, std::vector<VkVertexInputBindingDescription>& outBindings,
+        std::vector<VkVertexInputAttributeDescription>& outAttributes) const
+    {
+        outBindings.clear();
+        outAttributes.clear();
+
+        bool resolved = true;
+        for (const auto& input : shader.getVertexInputs())
+        {
+            auto found = std::find_if(_attributes.begin(), _attributes.end(), [&input](const VertexAttributeLayout& attribute) { return attribute.name == input.name; });
+            if (found == _attributes.end())
+            {
+                found = std::find_if(_attributes.begin(), _attributes.end(), [&input](const VertexAttributeLayout& attribute) { return attribute.location == input.location; });
+            }
+            if (found == _attributes.end())
+            {
+                CY_BASE_LOG_ERROR("Vertex input {0} at location {1} of {2} is not part of the vertex layout.", input.name, input.location, shader.getName());
+                resolved = false;
+                continue;
+            }
+
+            const VertexAttributeLayout& attribute = *found;
+            const VertexBindingLayout* binding = findBinding(attribute.binding);
+            if (binding == nullptr)
+            {
+                CY_BASE_LOG_ERROR("Vertex attribute {0} reads binding {1} which the vertex layout does not describe.", attribute.name, attribute.binding);
+                resolved = false;
+                continue;
+            }
+
+            //catches an attribute whose format is wider than the member it was declared for
+            uint32_t columnSize = formatSize(attribute.format);
+            if (columnSize != 0 && attribute.offset + columnSize * attribute.columns > binding->stride)
+            {
+                CY_BASE_LOG_ERROR("Vertex attribute {0} reads past the stride of binding {1}.", attribute.name, attribute.binding);
+                resolved = false;
+                continue;
+            }
+            CY_ASSERT(attribute.columns == 1 || columnSize != 0);
+
+            for (uint32_t column = 0; column < attribute.columns; column++)
+            {
+                VkVertexInputAttributeDescription description{};
+                description.location = input.location + column;
+                description.binding = attribute.binding;
+                description.format = attribute.format;
+                description.offset = attribute.offset + column * columnSize;
+                outAttributes.push_back(description);
+            }
+
+            auto bound = std::find_if(outBindings.begin(), outBindings.end(), [binding](const auto& description) { return description.binding == binding->binding; });
+            if (bound == outBindings.end())
+            {
+                outBindings.push_back(VkVertexInputBindingDescription{ binding->binding, binding->stride, binding->inputRate });
+            }
+        }
+
+        //sorted so the same layout resolved for the same inputs always gives the same pipeline state
+        std::sort(outBindings.begin(), outBindings.end(), [](const auto& a, const auto& b) { return a.binding < b.binding; });
+        return resolved;
+    }
+
+    uint32_t VertexInputLayout::formatSize(VkFormat format)
+    {
+        switch (format)
+        {
+            case VK_FORMAT_R8G8B8A8_UNORM:
+            case VK_FORMAT_R8G8B8A8_SNORM:
+            case VK_FORMAT_R8G8B8A8_UINT:
+            case VK_FORMAT_R8G8B8A8_SINT:
+            case VK_FORMAT_R16G16_SNORM:
+            case VK_FORMAT_R16G16_UNORM:
+            case VK_FORMAT_R16G16_SFLOAT:
+            case VK_FORMAT_A2B10G10R10_SNORM_PACK32:
+            case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+            case VK_FORMAT_R32_SFLOAT:
+            case VK_FORMAT_R32_SINT:
+            case VK_FORMAT_R32_UINT:                return 4;
+            case VK_FORMAT_R16G16B16A16_SNORM:
+            case VK_FORMAT_R16G16B16A16_UNORM:
+            case VK_FORMAT_R16G16B16A16_SFLOAT:
+            case VK_FORMAT_R32G32_SFLOAT:
+            case VK_FORMAT_R32G32_SINT:
+            case VK_FORMAT_R32G32_UINT:             return 8;
+            case VK_FORMAT_R32G32B32_SFLOAT:
+            case VK_FORMAT_R32G32B32_SINT:
+            case VK_FORMAT_R32G32B32_UINT:          return 12;
+            case VK_FORMAT_R32G32B32A32_SFLOAT:
+            case VK_FORMAT_R32G32B32A32_SINT:
+            case VK_FORMAT_R32G32B32A32_UINT:       return 16;
+            default:                                return 0;
+        }
+    }
+
+    VulkanVertexLayoutRegistry::VulkanVertexLayoutRegistry()
+    {
+        add("Vertex", SimpleVertexLayout::toInputLayout());
+        add("SplitVertex", Vertex::getSplitLayout());
+        add("PositionVertex", PositionVertexLayout::toInputLayout());
+        add("StaticMeshVertex", StaticMeshVertexLayout::toInputLayout());
+    }
+
+    void VulkanVertexLayoutRegistry::add(const std::string& name, const VertexInputLayout& layout)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _layouts[name] = layout;
+    }
+
+    bool VulkanVertexLayoutRegistry::has(const std::string& name) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _layouts.count(name) != 0;
+    }
+
+    VertexInputLayout VulkanVertexLayoutRegistry::get(const std::string& name) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        CY_ASSERT(_layouts.count(name) != 0); //no vertex layout was registered under name
+        return _layouts.at(name);
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "pch.h"
+
+#include "Vulkan.h"
+#include "../../core/core.h"
+#include "Fwd.hpp"
+
+namespace cy3d
+{
+	//the most vertex buffers a draw binds at once, see DrawItem::vertexBuffers
+	constexpr uint32_t MAX_VERTEX_BINDINGS = 4;
+
+	struct VertexBindingLayout
+	{
+		uint32_t binding{ 0 };
+		uint32_t stride{ 0 };
+		VkVertexInputRate inputRate{ VK_VERTEX_INPUT_RATE_VERTEX };
+	};
+
+	/**
+	 * @brief Where one attribute lives in the vertex buffers. A matrix attribute takes one location per column, columns
+	 * are laid out one after the other starting at offset and each one is fetched as format.
+	*/
+	struct VertexAttributeLayout
+	{
+		//the name of the vertex shader input, e.g. inPosition
+		std::string name;
+		//only used to match inputs whose name was stripped from the shader
+		uint32_t location{ 0 };
+		uint32_t binding{ 0 };
+		VkFormat format{ VK_FORMAT_UNDEFINED };
+		uint32_t offset{ 0 };
+		uint32_t columns{ 1 };
+	};
+
+	/**
+	 * @brief Describes how the vertex data in one or more buffers is laid out, independent of any shader. resolve
+	 * builds the vertex input state of a pipeline from the inputs the shader actually declares, so a shader that only
+	 * reads positions only fetches positions even if the layout has more attributes, and bindings none of its inputs
+	 * read are left out.
+	*/
+	class VertexInputLayout
+	{
+	private:
+		std::vector<VertexBindingLayout> _bindings;
+		std::vector<VertexAttributeLayout> _attributes;
+
+	public:
+		VertexInputLayout& addBinding(uint32_t binding, uint32_t stride, VkVertexInputRate inputRate = VK_VERTEX_INPUT_RATE_VERTEX);
+		VertexInputLayout& addAttribute(const std::string& name, uint32_t location, uint32_t binding, VkFormat format, uint32_t offset, uint32_t columns = 1);
+
+		/**
+		 * @brief Matches every vertex input of shader to an attribute by name, or by location if the layout has no
+		 * attribute with the input's name. Returns false and logs the input if one of them is not covered by the layout.
+		*/
+		bool resolve(const VulkanShader& shader, std::vector<VkVertexInputBindingDescription>& outBindings,
+			std::vector<VkVertexInputAttributeDescription>& outAttributes) const;
+
+		const std::vector<VertexBindingLayout>& getBindings() const { return _bindings; }
+		const std::vector<VertexAttributeLayout>& getAttributes() const { return _attributes; }
+		const VertexBindingLayout* findBinding(uint32_t binding) const;
+
+		/**
+		 * @brief The size in bytes of the formats vertex attributes are commonly fetched as, 0 for any other format.
+		*/
+		static uint32_t formatSize(VkFormat format);
+	};
+
+	/**
+	 * @brief The vertex layouts known to the renderer by name. Meshes are uploaded in one of these layouts and
+	 * pipelines look the layout up by the same name. Safe to use from any thread.
+	*/
+	class VulkanVertexLayoutRegistry
+	{
+	private:
+		std::unordered_map<std::string, VertexInputLayout> _layouts;
+		mutable std::mutex _mutex;
+
+	public:
+		/**
+		 * @brief Registers the built in layouts: Vertex and SplitVertex, see Vertex::getLayout and Vertex::getSplitLayout,
+		 * and the packed PositionVertex and StaticMeshVertex layouts of VertexLayout.h.
+		*/
+		VulkanVertexLayoutRegistry();
+
+		CY_NOCOPY(VulkanVertexLayoutRegistry);
+
+		/**
+		 * @brief Adds layout under name, replacing the layout that was registered under it before.
+		*/
+		void add(const std::string& name, const VertexInputLayout& layout);
+		bool has(const std::string& name) const;
+		//returned by value because a later add may replace the layout
+		VertexInputLayout get(const std::string& name) const;
+	};
+}